@@ -0,0 +1,120 @@
+/**
+ * arena.c - Region allocator for the many small objects of a population,
+ * such as the solution edges.
+ *
+ * The memory is taken from large chunks by bumping a pointer, and there is no
+ * way to free a single object: the whole arena is reset at once, keeping its
+ * chunks for the next use, or destroyed.
+ * */
+
+#include <stdlib.h>
+
+#include "include/arena.h"
+#include "include/print.h"
+
+
+struct arena_chunk {
+	struct list_head list;
+	size_t size;
+	/* The objects follow the header, which keeps them aligned */
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+
+/**
+ * arena_init - Initialize an empty arena. No memory is allocated until the
+ * first object is.
+ *
+ * @a: arena to initialize.
+ * @chunk_size: size of the chunks, or 0 for ARENA_CHUNK_SIZE.
+ * */
+void arena_init(struct arena *a, size_t chunk_size)
+{
+	INIT_LIST_HEAD(&a->chunks);
+	a->cur = NULL;
+	a->used = 0;
+	a->chunk_size = chunk_size ? chunk_size : ARENA_CHUNK_SIZE;
+}
+
+
+/**
+ * next_chunk - Move to a chunk with at least size bytes, reusing the chunk
+ * after the current one if it is large enough, and allocating a new one
+ * otherwise.
+ * */
+static struct arena_chunk *next_chunk(struct arena *a, size_t size)
+{
+	struct list_head *next = a->cur ? a->cur->list.next : a->chunks.next;
+	struct arena_chunk *c;
+
+	if(next != &a->chunks) {
+		c = list_entry(next, struct arena_chunk, list);
+		if(c->size >= size)
+			goto found;
+	}
+
+	if(size < a->chunk_size)
+		size = a->chunk_size;
+	if(!(c = malloc(sizeof(*c) + size)))
+		return NULL;
+	c->size = size;
+
+	/* The new chunk goes right after the current one, before the chunks
+	 * not in use. */
+	__list_add(&c->list, a->cur ? &a->cur->list : &a->chunks, next);
+	pr_debug("New arena chunk of %zu bytes.\n", size);
+found:
+	a->cur = c;
+	a->used = 0;
+	return c;
+}
+
+
+/**
+ * arena_alloc - Allocate an object aligned to ARENA_ALIGN, returning NULL if
+ * there is no memory left.
+ *
+ * @a: arena to take the object from.
+ * @size: size of the object.
+ * */
+void *arena_alloc(struct arena *a, size_t size)
+{
+	void *obj;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if(!a->cur || a->cur->size - a->used < size) {
+		if(!next_chunk(a, size))
+			return NULL;
+	}
+
+	obj = a->cur->data + a->used;
+	a->used += size;
+	return obj;
+}
+
+
+/**
+ * arena_reset - Release every object of the arena at once. The chunks are
+ * kept, so the next objects take no new memory from the system.
+ *
+ * @a: arena to reset.
+ * */
+void arena_reset(struct arena *a)
+{
+	a->cur = NULL;
+	a->used = 0;
+}
+
+
+/**
+ * arena_destroy - Free every chunk of the arena.
+ *
+ * @a: arena to destroy.
+ * */
+void arena_destroy(struct arena *a)
+{
+	struct arena_chunk *c;
+
+	free_list_entry(&a->chunks, c, list);
+	arena_init(a, a->chunk_size);
+}
@@ -0,0 +1,257 @@
+/**
+ * bin_file.c
+ *
+ * Binary instance format. The file is a header followed by the adjacency
+ * matrix cells, exactly as they are kept in memory, and the terminals array,
+ * so a whole instance is loaded with a single mmap.
+ *
+ * */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "include/errno.h"
+#include "include/print.h"
+#include "include/bin_file.h"
+
+
+/**
+ * is_stein_bin - Check whether a mapped file starts with the binary format
+ * magic.
+ *
+ * @map: mapped file.
+ * @size: size of the mapping.
+ * */
+int is_stein_bin(const void *map, size_t size)
+{
+	return size >= sizeof(struct stein_bin_header) &&
+		memcmp(map, STEIN_BIN_MAGIC, sizeof(STEIN_BIN_MAGIC) - 1) == 0;
+}
+
+
+/**
+ * check_header - Return 0 if the header describes a valid instance that fits
+ * in the file.
+ * */
+static int check_header(const struct stein_bin_header *h, size_t size)
+{
+	struct stein tmp;
+
+	if(h->version != STEIN_BIN_VERSION ||
+			h->byte_order != STEIN_BIN_BYTE_ORDER) {
+		pr_warn("Unsupported binary file version %u.\n", h->version);
+		return EINVALID_FILE_FORMAT;
+	}
+
+	/* adj_cells() only needs the layout and the counts */
+	tmp.n_nodes = h->n_nodes;
+	tmp.n_edges = h->n_edges;
+	tmp.layout = h->layout;
+	if(h->n_nodes == 0 || h->n_terminals > h->n_nodes ||
+			h->layout > ADJ_CSR ||
+			(h->layout == ADJ_CSR &&
+			 h->w_size != sizeof(unsigned int)) ||
+			(h->w_size != sizeof(unsigned int) &&
+			 h->w_size != sizeof(uint16_t)) ||
+			h->adj_offset % STEIN_BIN_ALIGN != 0 ||
+			h->adj_bytes != adj_cells(&tmp) * h->w_size ||
+			h->adj_offset + h->adj_bytes > h->terminals_offset ||
+			h->terminals_offset + (uint64_t)h->n_terminals *
+			sizeof(uint32_t) > size)
+		return EINVALID_FILE_FORMAT;
+
+	return 0;
+}
+
+
+/**
+ * check_csr - Return 0 if the ADJ_CSR arrays are consistent, so no lookup may
+ * go beyond them.
+ * */
+static int check_csr(const struct stein *stein)
+{
+	const unsigned int *off = csr_off(stein), *adj = csr_adj(stein);
+	unsigned int v;
+	size_t i;
+
+	if(off[0] != 0 || off[stein->n_nodes] != 2 * (size_t)stein->n_edges)
+		return EINVALID_FILE_FORMAT;
+	for(v = 0; v < stein->n_nodes; v++) {
+		if(off[v] > off[v + 1])
+			return EINVALID_FILE_FORMAT;
+	}
+	for(i = 0; i < 2 * (size_t)stein->n_edges; i++) {
+		if(adj[i] >= stein->n_nodes)
+			return EINVALID_FILE_FORMAT;
+	}
+	return 0;
+}
+
+
+/**
+ * get_stein_from_bin - Set the stein structure from a mapped binary file. The
+ * mapping is kept as the matrix memory, thus it is owned by the stein structure
+ * on success and unmapped otherwise.
+ *
+ * @map: file mapped with MAP_PRIVATE.
+ * @size: size of the mapping.
+ * @src: status of the text file the binary must have been created from, or
+ * NULL to accept the binary whatever its source is.
+ * */
+struct stein *get_stein_from_bin(void *map, size_t size, const struct stat *src)
+{
+	const struct stein_bin_header *h = map;
+	const char *terminals;
+	uint32_t t;
+	struct stein *stein_data;
+	unsigned int i;
+
+	if(!is_stein_bin(map, size) || check_header(h, size) != 0) {
+		ERRNO = EINVALID_FILE_FORMAT;
+		pr_fatal("Invalid binary file.\n");
+		goto unmap;
+	}
+
+	if(src != NULL && (h->src_mtime != src->st_mtim.tv_sec ||
+			h->src_mtime_nsec != src->st_mtim.tv_nsec ||
+			h->src_size != (uint64_t)src->st_size)) {
+		pr_debug("The binary file is older than its source.\n", 0);
+		goto unmap;
+	}
+
+	/* The matrix is private to the process, as if it was allocated */
+	if(mprotect(map, size, PROT_READ | PROT_WRITE) != 0) {
+		ERRNO = ENOMEM;
+		goto unmap;
+	}
+
+	stein_data = get_stein();
+	stein_data->n_nodes = h->n_nodes;
+	stein_data->n_edges = h->n_edges;
+	stein_data->n_terminals = h->n_terminals;
+	stein_data->not_t = h->n_nodes - h->n_terminals;
+	stein_data->layout = h->layout;
+	stein_data->w_size = h->w_size;
+	stein_data->adj_m = (char *)map + h->adj_offset;
+	stein_data->adj_map = map;
+	stein_data->adj_size = size;
+
+	stein_data->terminals = NULL;
+	if(stein_data->layout == ADJ_CSR && check_csr(stein_data) != 0) {
+		ERRNO = EINVALID_FILE_FORMAT;
+		pr_fatal("Invalid sparse graph in the binary file.\n");
+		free_stein();
+		return NULL;
+	}
+
+	/* The terminals follow the cells, so they may not be aligned */
+	alloc_terminals();
+	terminals = (const char *)map + h->terminals_offset;
+	for(i = 0; i < stein_data->n_terminals; i++) {
+		memcpy(&t, terminals + (size_t)i * sizeof(t), sizeof(t));
+		if(t >= stein_data->n_nodes) {
+			ERRNO = EINVALID_FILE_FORMAT;
+			pr_fatal("Invalid terminal %u.\n", t + 1u);
+			free_stein();
+			return NULL;
+		}
+		stein_data->terminals[i] = t;
+	}
+
+	pr_debug("Binary instance loaded: n_nodes=%u; n_edges=%u; n_terminals=%u.\n",
+			stein_data->n_nodes, stein_data->n_edges,
+			stein_data->n_terminals);
+	return stein_data;
+unmap:
+	munmap(map, size);
+	return NULL;
+}
+
+
+/**
+ * write_all - Write the whole buffer, returning an error number (!= 0) if it
+ * could not be written.
+ * */
+static int write_all(FILE *file, const void *buf, size_t size)
+{
+	return fwrite(buf, 1, size, file) == size ? 0 : EUNEXPECTED_ERROR;
+}
+
+
+/**
+ * put_stein_to_bin - Write the current stein structure to a binary file. The
+ * file is written under a temporary name and renamed, thus a concurrent
+ * reader never sees it half written.
+ *
+ * @filename: path of the binary file.
+ * @src: status of the text file the stein structure was read from, or NULL.
+ * */
+int put_stein_to_bin(const char *filename, const struct stat *src)
+{
+	struct stein *stein = get_stein();
+	struct stein_bin_header h;
+	static const char pad[STEIN_BIN_ALIGN];
+	char *tmp_name;
+	FILE *file;
+	int fd;
+	unsigned int i;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, STEIN_BIN_MAGIC, sizeof(h.magic));
+	h.version = STEIN_BIN_VERSION;
+	h.byte_order = STEIN_BIN_BYTE_ORDER;
+	h.n_nodes = stein->n_nodes;
+	h.n_edges = stein->n_edges;
+	h.n_terminals = stein->n_terminals;
+	h.layout = stein->layout;
+	h.w_size = stein->w_size;
+	if(src != NULL) {
+		h.src_mtime = src->st_mtim.tv_sec;
+		h.src_mtime_nsec = src->st_mtim.tv_nsec;
+		h.src_size = src->st_size;
+	}
+	h.adj_offset = STEIN_BIN_ALIGN;
+	h.adj_bytes = adj_cells(stein) * stein->w_size;
+	h.terminals_offset = h.adj_offset + h.adj_bytes;
+
+	if(!(tmp_name = malloc(strlen(filename) + 8)))
+		return ENOMEM;
+	sprintf(tmp_name, "%s.XXXXXX", filename);
+	if((fd = mkstemp(tmp_name)) < 0 || !(file = fdopen(fd, "w"))) {
+		pr_warn("Could not create %s.\n", tmp_name);
+		if(fd >= 0) {
+			close(fd);
+			unlink(tmp_name);
+		}
+		free(tmp_name);
+		return EFILE_NOT_FOUND;
+	}
+
+	if(write_all(file, &h, sizeof(h)) != 0 ||
+			write_all(file, pad, STEIN_BIN_ALIGN - sizeof(h)) != 0 ||
+			write_all(file, stein->adj_m, h.adj_bytes) != 0)
+		goto fail_write;
+
+	for(i = 0; i < stein->n_terminals; i++) {
+		uint32_t t = stein->terminals[i];
+		if(write_all(file, &t, sizeof(t)) != 0)
+			goto fail_write;
+	}
+
+	if(fclose(file) != 0 || rename(tmp_name, filename) != 0) {
+		unlink(tmp_name);
+		free(tmp_name);
+		return EUNEXPECTED_ERROR;
+	}
+	pr_debug("Binary instance written to %s.\n", filename);
+	free(tmp_name);
+	return 0;
+fail_write:
+	pr_warn("Could not write %s.\n", tmp_name);
+	fclose(file);
+	unlink(tmp_name);
+	free(tmp_name);
+	return EUNEXPECTED_ERROR;
+}
@@ -0,0 +1,427 @@
+/**
+ * bound.c - Lower bound on the weight of the Steiner trees, by the dual ascent
+ * of Wong over the bidirected cut formulation.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "include/bound.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/**
+ * dual_ascent_init - Build the arcs of the instance for the dual ascent.
+ * Returns an error number (!= 0) if there is no memory.
+ *
+ * @da: dual ascent to initialize.
+ * @stein: stein structure with the graph representation.
+ * */
+int dual_ascent_init(struct dual_ascent *da, const struct stein *stein)
+{
+	const unsigned int *off = NULL, *adj = NULL, *wts = NULL;
+	unsigned int n = stein->n_nodes, u, v, e, w, a, b, *pos = NULL;
+	size_t n_arcs = 2 * (size_t)stein->n_edges;
+
+	memset(da, 0, sizeof(*da));
+	da->n = n;
+	if(!(da->off = calloc((size_t)n + 1, sizeof(*da->off))) ||
+			!(da->tail = malloc(sizeof(*da->tail) * (n_arcs + 1))) ||
+			!(da->rev = malloc(sizeof(*da->rev) * (n_arcs + 1))) ||
+			!(da->w = malloc(sizeof(*da->w) * (n_arcs + 1))) ||
+			!(da->rc = malloc(sizeof(*da->rc) * (n_arcs + 1))) ||
+			!(da->dist = malloc(sizeof(*da->dist) * n)) ||
+			!(da->dist_t = malloc(sizeof(*da->dist_t) * n)) ||
+			!(da->cut = malloc(sizeof(*da->cut) * n)) ||
+			!(da->in_cut = calloc(n, 1)) ||
+			heap_init(&da->heap, n, da->dist) != 0 ||
+			!(pos = malloc(sizeof(*pos) * n)))
+		goto fail_init;
+	memset(da->dist, 0xff, sizeof(*da->dist) * n);
+
+	if(stein->layout == ADJ_CSR) {
+		off = csr_off(stein);
+		adj = csr_adj(stein);
+		wts = csr_wts(stein);
+	}
+
+	/* An instance without edges has no matrix to read */
+	for(u = 0; u < n && n_arcs > 0; u++) {
+		for(e = off ? off[u] : u + 1; e < (off ? off[u + 1] : n); e++) {
+			v = off ? adj[e] : e;
+			w = off ? wts[e] : stein_w(stein, u, v);
+			if(u < v && w != W_INF) {
+				da->off[u + 1]++;
+				da->off[v + 1]++;
+			}
+		}
+	}
+	for(u = 0; u < n; u++) {
+		da->off[u + 1] += da->off[u];
+		pos[u] = da->off[u];
+	}
+
+	/* The arc (u, v) goes in the list of v, and (v, u) in the one of u */
+	for(u = 0; u < n && n_arcs > 0; u++) {
+		for(e = off ? off[u] : u + 1; e < (off ? off[u + 1] : n); e++) {
+			v = off ? adj[e] : e;
+			w = off ? wts[e] : stein_w(stein, u, v);
+			if(u >= v || w == W_INF)
+				continue;
+			a = pos[v]++;
+			b = pos[u]++;
+			da->tail[a] = u;
+			da->tail[b] = v;
+			da->rev[a] = b;
+			da->rev[b] = a;
+			da->w[a] = da->w[b] = w;
+		}
+	}
+
+	free(pos);
+	return 0;
+
+fail_init:
+	free(pos);
+	dual_ascent_free(da);
+	ERRNO = ENOMEM;
+	return ERRNO;
+}
+
+
+/**
+ * grow_cut - Gather in da->cut the vertexes which reach the terminal t by arcs
+ * of reduced cost 0. Returns 1 if the cut is still active, 0 if it holds the
+ * root or another active terminal: t is then joined to the root, at once or
+ * once that terminal is.
+ * */
+static int grow_cut(struct dual_ascent *da, unsigned int t,
+		unsigned int *n_cut)
+{
+	unsigned int n = 0u, i, a, u, v;
+	int active = 1;
+
+	da->in_cut[t] = 1;
+	da->cut[n++] = t;
+	for(i = 0; i < n && active; i++) {
+		v = da->cut[i];
+		for(a = da->off[v]; a < da->off[v + 1]; a++) {
+			u = da->tail[a];
+			if(da->rc[a] != 0 || da->in_cut[u])
+				continue;
+			da->in_cut[u] = 1;
+			da->cut[n++] = u;
+			if(u == da->root || da->heap.pos[u] != HEAP_NONE) {
+				active = 0;
+				break;
+			}
+		}
+	}
+	*n_cut = n;
+	return active;
+}
+
+
+/**
+ * saturate_cut - Raise the dual variable of the cut in da->cut by the lowest
+ * reduced cost of the arcs entering it, and lower their reduced costs by as
+ * much. Returns the amount, or W_INF if no arc enters the cut.
+ * */
+static unsigned int saturate_cut(struct dual_ascent *da, unsigned int n_cut)
+{
+	unsigned int delta = W_INF, i, a, v;
+
+	for(i = 0; i < n_cut; i++) {
+		v = da->cut[i];
+		for(a = da->off[v]; a < da->off[v + 1]; a++) {
+			if(!da->in_cut[da->tail[a]] && da->rc[a] < delta)
+				delta = da->rc[a];
+		}
+	}
+	for(i = 0; i < n_cut && delta != W_INF; i++) {
+		v = da->cut[i];
+		for(a = da->off[v]; a < da->off[v + 1]; a++) {
+			if(!da->in_cut[da->tail[a]])
+				da->rc[a] -= delta;
+		}
+	}
+	return delta;
+}
+
+
+/**
+ * dual_ascent - Compute the lower bound and the reduced costs of the arcs from
+ * the root, in da->lb and da->rc. If *stop becomes set, the ascent stops with
+ * the bound of the cuts raised so far, which is still valid. Returns an error
+ * number (!= 0) if a terminal can not be reached from the root.
+ *
+ * @da: dual ascent.
+ * @stein: stein structure with the graph representation.
+ * @root: terminal the arborescences grow from.
+ * @stop: flag set by another thread to stop the ascent, or NULL.
+ * */
+int dual_ascent(struct dual_ascent *da, const struct stein *stein,
+		unsigned int root, const int *stop)
+{
+	unsigned int i, t, n_cut, delta;
+	int active, err = 0;
+
+	memcpy(da->rc, da->w, sizeof(*da->rc) * da->off[da->n]);
+	da->root = root;
+	da->lb = 0ul;
+
+	/* The active terminals wait in the heap, the smallest cut first */
+	for(i = 0; i < stein->n_terminals; i++) {
+		if((t = stein->terminals[i]) == root)
+			continue;
+		da->dist[t] = 1u;
+		heap_push(&da->heap, t);
+	}
+
+	while(da->heap.size > 0) {
+		if(stop && __atomic_load_n(stop, __ATOMIC_RELAXED))
+			break;
+		t = heap_pop(&da->heap);
+		active = grow_cut(da, t, &n_cut);
+		delta = active ? saturate_cut(da, n_cut) : 0u;
+		for(i = 0; i < n_cut; i++)
+			da->in_cut[da->cut[i]] = 0;
+		if(!active)
+			continue;
+		if(delta == W_INF) {
+			ERRNO = EDISCONNECTED;
+			err = ERRNO;
+			break;
+		}
+		da->lb += delta;
+		da->dist[t] = n_cut;
+		heap_push(&da->heap, t);
+	}
+
+	while(da->heap.size > 0)
+		heap_pop(&da->heap);
+	memset(da->dist, 0xff, sizeof(*da->dist) * da->n);
+	return err;
+}
+
+
+/**
+ * reduced_distances - Write in dist the distances with the reduced costs from
+ * the root, and in dist_t the ones to the closest terminal other than the
+ * root.
+ * */
+static void reduced_distances(struct dual_ascent *da,
+		const struct stein *stein)
+{
+	unsigned int i, u, v, a;
+	unsigned long d;
+
+	/* Towards the terminals, along the arcs entering each vertex */
+	for(i = 0; i < stein->n_terminals; i++) {
+		if((v = stein->terminals[i]) == da->root)
+			continue;
+		da->dist[v] = 0u;
+		heap_push(&da->heap, v);
+	}
+	while(da->heap.size > 0) {
+		v = heap_pop(&da->heap);
+		for(a = da->off[v]; a < da->off[v + 1]; a++) {
+			u = da->tail[a];
+			d = (unsigned long)da->dist[v] + da->rc[a];
+			if(d < da->dist[u]) {
+				da->dist[u] = d;
+				heap_push(&da->heap, u);
+			}
+		}
+	}
+	memcpy(da->dist_t, da->dist, sizeof(*da->dist) * da->n);
+	memset(da->dist, 0xff, sizeof(*da->dist) * da->n);
+
+	/* From the root, along the reverse of the arcs entering each vertex */
+	da->dist[da->root] = 0u;
+	heap_push(&da->heap, da->root);
+	while(da->heap.size > 0) {
+		u = heap_pop(&da->heap);
+		for(a = da->off[u]; a < da->off[u + 1]; a++) {
+			v = da->tail[a];
+			d = (unsigned long)da->dist[u] + da->rc[da->rev[a]];
+			if(d < da->dist[v]) {
+				da->dist[v] = d;
+				heap_push(&da->heap, v);
+			}
+		}
+	}
+}
+
+
+/**
+ * dual_ascent_test - Mark the arcs of the edges in no tree of weight ub or
+ * less, after dual_ascent(): a tree holding the arc (u, v) weighs at least the
+ * bound, plus the reduced cost of the arc and of the paths from the root to u
+ * and from v to a terminal. An edge is marked when both of its arcs are. The
+ * marks are added to cut, so that the tests from several roots add up.
+ * Returns the number of edges newly marked.
+ *
+ * @da: dual ascent.
+ * @stein: stein structure with the graph representation.
+ * @ub: weight of a known tree.
+ * @cut: one flag per arc, set for the arcs of the edges to remove.
+ * */
+unsigned int dual_ascent_test(struct dual_ascent *da,
+		const struct stein *stein, unsigned long ub, unsigned char *cut)
+{
+	unsigned int v, u, a, n_cut = 0u;
+	unsigned long uv, vu;
+
+	reduced_distances(da, stein);
+	for(v = 0; v < da->n; v++) {
+		for(a = da->off[v]; a < da->off[v + 1]; a++) {
+			if((u = da->tail[a]) > v || cut[a])
+				continue;
+
+			/* No arborescence has an arc entering the root, and the
+			 * unreached vertexes are W_INF away */
+			uv = v == da->root ? ULONG_MAX : da->lb + da->dist[u] +
+				da->rc[a] + da->dist_t[v];
+			vu = u == da->root ? ULONG_MAX : da->lb + da->dist[v] +
+				da->rc[da->rev[a]] + da->dist_t[u];
+			if(uv > ub && vu > ub) {
+				cut[a] = cut[da->rev[a]] = 1;
+				n_cut++;
+			}
+		}
+	}
+	memset(da->dist, 0xff, sizeof(*da->dist) * da->n);
+	return n_cut;
+}
+
+
+/**
+ * dual_ascent_free - Release the memory of the dual ascent.
+ *
+ * @da: dual ascent.
+ * */
+void dual_ascent_free(struct dual_ascent *da)
+{
+	free(da->off);
+	free(da->tail);
+	free(da->rev);
+	free(da->w);
+	free(da->rc);
+	free(da->dist);
+	free(da->dist_t);
+	free(da->cut);
+	free(da->in_cut);
+	if(da->heap.v)
+		heap_free(&da->heap);
+	memset(da, 0, sizeof(*da));
+}
+
+
+/**
+ * ascend_roots - Body of the thread of the lower bound: dual ascents from
+ * roots spread evenly over the terminals, keeping the best bound, until they
+ * are all done or the thread is stopped.
+ * */
+static void *ascend_roots(void *arg)
+{
+	struct lower_bound *b = arg;
+	struct stein *stein = b->stein;
+	struct dual_ascent da;
+	unsigned int i, n_roots = BOUND_ROOTS, root;
+
+	if(n_roots > stein->n_terminals)
+		n_roots = stein->n_terminals;
+	if(dual_ascent_init(&da, stein) != 0) {
+		pr_error("Could not allocate the dual ascent.\n\n");
+		return NULL;
+	}
+
+	/* The first ascent is not stopped, so that there is a bound */
+	for(i = 0; i < n_roots; i++) {
+		if(i > 0 && __atomic_load_n(&b->stop, __ATOMIC_RELAXED))
+			break;
+		root = stein->terminals[(size_t)i * stein->n_terminals /
+			n_roots];
+		if(dual_ascent(&da, stein, root, i > 0 ? &b->stop : NULL) != 0)
+			break;
+		if(da.lb <= b->lb)
+			continue;
+		__atomic_store_n(&b->lb, da.lb, __ATOMIC_RELAXED);
+		pr_debug("Lower bound %lu from the root %u.\n",
+				da.lb + b->offset, root);
+	}
+
+	dual_ascent_free(&da);
+	return NULL;
+}
+
+
+/**
+ * lower_bound_start - Start the thread computing the lower bound of the
+ * instance by dual ascents from up to BOUND_ROOTS roots. Returns an error
+ * number (!= 0) if the thread could not be created.
+ *
+ * @b: lower bound.
+ * @stein: stein structure with the graph representation, which must not
+ * change until lower_bound_stop().
+ * @lb: lower bound already known, or 0.
+ * @offset: weight added to the trees of the instance and to the bound.
+ * */
+int lower_bound_start(struct lower_bound *b, struct stein *stein,
+		unsigned long lb, unsigned long offset)
+{
+	b->stein = stein;
+	b->stop = 0;
+	b->lb = lb;
+	b->offset = offset;
+	b->running = 0;
+	if(stein->n_terminals < 2)
+		return 0;
+	if(pthread_create(&b->thread, NULL, ascend_roots, b) != 0) {
+		ERRNO = EUNEXPECTED_ERROR;
+		pr_error("Could not create the thread of the lower bound.\n\n");
+		return ERRNO;
+	}
+	b->running = 1;
+	return 0;
+}
+
+
+/**
+ * lower_bound_stop - Stop the thread and wait for it. The ascent from the
+ * first root is finished first, so that there is a bound to report.
+ *
+ * @b: lower bound.
+ * */
+void lower_bound_stop(struct lower_bound *b)
+{
+	if(!b->running)
+		return;
+	__atomic_store_n(&b->stop, 1, __ATOMIC_RELAXED);
+	pthread_join(b->thread, NULL);
+	b->running = 0;
+}
+
+
+/**
+ * lower_bound_gap - Return how far above the lower bound a tree of the
+ * instance is, in percent of the bound, the offset included: an optimal tree
+ * is at most this much lighter.
+ *
+ * @b: lower bound.
+ * @w: weight of the tree, without the offset.
+ * */
+double lower_bound_gap(const struct lower_bound *b, unsigned long w)
+{
+	unsigned long lb = lower_bound_get(b);
+
+	w += b->offset;
+	if(w <= lb)
+		return 0.0;
+	if(lb == 0)
+		return HUGE_VAL;
+	return 100.0 * (w - lb) / lb;
+}
@@ -0,0 +1,465 @@
+/**
+ * closure.c - Metric closure of the graph: the shortest path distance between
+ * every pair of vertexes, with a predecessor table to expand the paths.
+ *
+ * The Floyd-Warshall runs over square blocks of CLOSURE_BLOCK vertexes, so the
+ * three blocks involved in a relaxation stay in the cache. For each diagonal
+ * block kb, the block itself is closed first, then the blocks of its row and
+ * column, which only depend on it, and then all the others, which only depend
+ * on the row and the column: the blocks of each of the last two phases are
+ * independent and are relaxed in parallel. Each relaxation of a row segment
+ * is a simd_relax().
+ * */
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "include/closure.h"
+#include "include/mst.h"
+#include "include/simd.h"
+#include "include/heap.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/* Arguments of the parallel loops of the closure */
+struct closure_task {
+	struct closure *c;
+	const struct stein *stein;
+
+	/* Diagonal block of the current Floyd-Warshall round */
+	unsigned int kb;
+	unsigned int n_blocks;
+
+	/* Heap of each thread, for the Dijkstra */
+	struct heap *heaps;
+};
+
+
+/**
+ * map_cells - Map memory for n * n cells of unsigned int. Returns NULL if
+ * there is no memory.
+ * */
+static void *map_cells(unsigned int n, size_t *size)
+{
+	void *m;
+
+	*size = (size_t)n * n * sizeof(unsigned int);
+	m = mmap(NULL, *size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return m == MAP_FAILED ? NULL : m;
+}
+
+
+/**
+ * init_row - Set the distances from u to the weights of the edges of u, and
+ * the predecessors to u where there is an edge. The rows are filled in
+ * parallel, which spreads the first touch of their pages over the threads.
+ * */
+static void init_row(void *arg, unsigned int u, unsigned int thread)
+{
+	struct closure_task *task = arg;
+	struct closure *c = task->c;
+	unsigned int v, n = c->n, *dist = c->dist + (size_t)u * n;
+	unsigned int *pred = (unsigned int *)c->pred + (size_t)u * n;
+
+	for(v = 0; v < n; v++) {
+		dist[v] = stein_w(task->stein, u, v);
+		pred[v] = dist[v] == W_INF ? CLOSURE_NONE : u;
+	}
+	dist[u] = 0u;
+	pred[u] = u;
+}
+
+
+/**
+ * relax_block - Relax the paths of the block (ib, jb) through the vertexes of
+ * the block kb.
+ * */
+static void relax_block(struct closure *c, unsigned int ib, unsigned int jb,
+		unsigned int kb)
+{
+	unsigned int n = c->n, i, k, *pred = c->pred;
+	unsigned int i0 = ib * CLOSURE_BLOCK, i1 = i0 + CLOSURE_BLOCK;
+	unsigned int j0 = jb * CLOSURE_BLOCK, j1 = j0 + CLOSURE_BLOCK;
+	unsigned int k0 = kb * CLOSURE_BLOCK, k1 = k0 + CLOSURE_BLOCK;
+
+	i1 = i1 < n ? i1 : n;
+	j1 = j1 < n ? j1 : n;
+	k1 = k1 < n ? k1 : n;
+
+	/* k goes first: the diagonal, row and column blocks depend on the
+	 * vertexes of kb relaxed before. */
+	for(k = k0; k < k1; k++) {
+		const unsigned int *via = c->dist + (size_t)k * n + j0;
+		const unsigned int *via_pred = pred + (size_t)k * n + j0;
+
+		for(i = i0; i < i1; i++) {
+			unsigned int d = c->dist[(size_t)i * n + k];
+
+			if(d == W_INF)
+				continue;
+			simd_relax(c->dist + (size_t)i * n + j0,
+					pred + (size_t)i * n + j0, via, via_pred,
+					d, j1 - j0);
+		}
+	}
+}
+
+
+/**
+ * relax_cross - Relax the block t of the row of kb when t < n_blocks, and the
+ * block t - n_blocks of its column otherwise.
+ * */
+static void relax_cross(void *arg, unsigned int t, unsigned int thread)
+{
+	struct closure_task *task = arg;
+	unsigned int kb = task->kb, nb = task->n_blocks;
+
+	if(t < nb && t != kb)
+		relax_block(task->c, kb, t, kb);
+	else if(t >= nb && t - nb != kb)
+		relax_block(task->c, t - nb, kb, kb);
+}
+
+
+/**
+ * relax_rest - Relax the block t, in row-major order, unless it is in the row
+ * or the column of kb.
+ * */
+static void relax_rest(void *arg, unsigned int t, unsigned int thread)
+{
+	struct closure_task *task = arg;
+	unsigned int ib = t / task->n_blocks, jb = t % task->n_blocks;
+
+	if(ib != task->kb && jb != task->kb)
+		relax_block(task->c, ib, jb, task->kb);
+}
+
+
+/**
+ * floyd_warshall - Close the matrix filled by init_row() with the blocked
+ * Floyd-Warshall. It takes O(V^3).
+ * */
+static void floyd_warshall(struct closure_task *task, struct pool *pool)
+{
+	unsigned int nb = (task->c->n + CLOSURE_BLOCK - 1) / CLOSURE_BLOCK;
+
+	task->n_blocks = nb;
+	for(task->kb = 0; task->kb < nb; task->kb++) {
+		relax_block(task->c, task->kb, task->kb, task->kb);
+		pool_run(pool, relax_cross, task, 2 * nb);
+		pool_run(pool, relax_rest, task, nb * nb);
+	}
+}
+
+
+/**
+ * dijkstra_source - Fill the row of the source s with a Dijkstra over the
+ * ADJ_CSR graph, whose keys are the row itself. It takes O(E log V).
+ * */
+static void dijkstra_source(void *arg, unsigned int s, unsigned int thread)
+{
+	struct closure_task *task = arg;
+	struct closure *c = task->c;
+	struct heap *heap = &task->heaps[thread];
+	const unsigned int *off = csr_off(task->stein);
+	const unsigned int *adj = csr_adj(task->stein);
+	const unsigned int *wts = csr_wts(task->stein);
+	unsigned int n = c->n, u, v, e, d, *dist = c->dist + (size_t)s * n;
+	unsigned int *pred = (unsigned int *)c->pred + (size_t)s * n;
+
+	memset(dist, 0xff, sizeof(*dist) * n);
+	memset(pred, 0xff, sizeof(*pred) * n);
+
+	heap->key = dist;
+	dist[s] = 0u;
+	pred[s] = s;
+	heap_push(heap, s);
+	while(heap->size > 0) {
+		u = heap_pop(heap);
+		for(e = off[u]; e < off[u + 1]; e++) {
+			v = adj[e];
+			d = dist[u] + wts[e];
+			if(d < dist[v]) {
+				dist[v] = d;
+				pred[v] = u;
+				heap_push(heap, v);
+			}
+		}
+	}
+}
+
+
+/**
+ * dijkstra - Fill every row with a Dijkstra from its vertex, with a heap per
+ * thread. Returns an error number (!= 0) if there is no memory.
+ * */
+static int dijkstra(struct closure_task *task, struct pool *pool)
+{
+	unsigned int t, n_heaps = pool_threads(pool);
+	int err = 0;
+
+	if(!(task->heaps = calloc(n_heaps, sizeof(*task->heaps)))) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	for(t = 0; t < n_heaps; t++) {
+		if(heap_init(&task->heaps[t], task->c->n, NULL) != 0) {
+			ERRNO = ENOMEM;
+			err = ERRNO;
+			goto free_heaps;
+		}
+	}
+
+	pool_run(pool, dijkstra_source, task, task->c->n);
+
+free_heaps:
+	for(t = 0; t < n_heaps; t++)
+		heap_free(&task->heaps[t]);
+	free(task->heaps);
+	return err;
+}
+
+
+/**
+ * compact_pred - Narrow the predecessor cells to uint16_t when every vertex
+ * fits, releasing the memory left unused at the end of the table, as done by
+ * compact_adj_m() for the weights. It is a no-op when the program is compiled
+ * with -DNO_COMPACT_WEIGHTS.
+ * */
+static void compact_pred(struct closure *c)
+{
+#ifndef NO_COMPACT_WEIGHTS
+	size_t i, cells = (size_t)c->n * c->n, size, page;
+	unsigned char *m = c->pred;
+	unsigned int wide;
+	uint16_t narrow;
+
+	/* UINT16_MAX is reserved for CLOSURE_NONE */
+	if(c->n >= UINT16_MAX)
+		return;
+
+	/* Narrowing in place is safe, through memcpy(), see compact_adj_m() */
+	for(i = 0; i < cells; i++) {
+		memcpy(&wide, m + i * sizeof(wide), sizeof(wide));
+		narrow = wide == CLOSURE_NONE ? UINT16_MAX : (uint16_t)wide;
+		memcpy(m + i * sizeof(narrow), &narrow, sizeof(narrow));
+	}
+	c->pred_w = sizeof(uint16_t);
+
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	size = (cells * sizeof(uint16_t) + page - 1) / page * page;
+	if(size < c->pred_size) {
+		munmap((char *)c->pred + size, c->pred_size - size);
+		c->pred_size = size;
+	}
+#endif
+}
+
+
+/**
+ * closure_init - Compute the metric closure of the graph. Returns an error
+ * number (!= 0) if there is no memory.
+ *
+ * @c: closure to fill.
+ * @stein: stein structure with the graph representation.
+ * @pool: threads to work with, or NULL.
+ * */
+int closure_init(struct closure *c, const struct stein *stein,
+		struct pool *pool)
+{
+	struct closure_task task;
+	int err;
+
+	memset(c, 0, sizeof(*c));
+	c->n = stein->n_nodes;
+	c->pred_w = sizeof(unsigned int);
+	if(!(c->dist = map_cells(c->n, &c->dist_size)) ||
+			!(c->pred = map_cells(c->n, &c->pred_size))) {
+		pr_error("Could not map the %ux%u closure.\n\n", c->n, c->n);
+		ERRNO = ENOMEM;
+		goto fail_closure;
+	}
+
+	task.c = c;
+	task.stein = stein;
+	if(stein->layout == ADJ_CSR) {
+		if((err = dijkstra(&task, pool)) != 0) {
+			ERRNO = err;
+			goto fail_closure;
+		}
+	} else {
+		pool_run(pool, init_row, &task, c->n);
+		floyd_warshall(&task, pool);
+	}
+	compact_pred(c);
+
+	pr_debug("Metric closure of %u vertexes computed.\n", c->n);
+	return 0;
+
+fail_closure:
+	closure_free(c);
+	return ERRNO;
+}
+
+
+/**
+ * closure_path - Write the vertexes of the shortest path from u to v, both
+ * included, from v back to u. Returns their number, or 0 if v can not be
+ * reached. path must have room for the number of vertexes.
+ *
+ * @c: closure.
+ * @u: source vertex.
+ * @v: destination vertex.
+ * @path: vertexes of the path.
+ * */
+unsigned int closure_path(const struct closure *c, unsigned int u,
+		unsigned int v, unsigned int *path)
+{
+	unsigned int k = 0u;
+
+	if(closure_pred(c, u, v) == CLOSURE_NONE)
+		return 0u;
+
+	path[k++] = v;
+	while(v != u) {
+		v = closure_pred(c, u, v);
+		path[k++] = v;
+	}
+	return k;
+}
+
+
+/**
+ * closure_expand - Build the tree given by edges of the closure: each edge is
+ * replaced by its shortest path in the graph, and the MST of the vertexes on
+ * the paths is pruned down to a Steiner tree, see retrieve_mst_set(). Returns
+ * an error number (!= 0) if there is no memory or if the edges do not connect
+ * the terminals.
+ *
+ * @stein: stein structure with the graph representation.
+ * @c: closure of the graph.
+ * @edges: pairs of vertexes, edges of the closure.
+ * @n_edges: number of edges.
+ * @sol: solution where the tree is written.
+ * @arena: arena the edges of the tree are allocated from.
+ * */
+int closure_expand(struct stein *stein, const struct closure *c,
+		const unsigned int (*edges)[2], unsigned int n_edges,
+		struct solution *sol, struct arena *arena)
+{
+	unsigned int i, k, n = 0u, len, *set, *path;
+	unsigned char *mark;
+
+	/* A vertex is unmarked, on a path, or a terminal */
+	enum { V_NONE, V_PATH, V_TERMINAL };
+
+	if(!(set = malloc(sizeof(*set) * 2 * (size_t)c->n)))
+		goto fail_alloc;
+	path = set + c->n;
+	if(!(mark = calloc(c->n, 1))) {
+		free(set);
+		goto fail_alloc;
+	}
+	for(i = 0; i < stein->n_terminals; i++)
+		mark[stein->terminals[i]] = V_TERMINAL;
+
+	for(i = 0; i < n_edges; i++) {
+		if(!(len = closure_path(c, edges[i][0], edges[i][1], path)))
+			goto fail_disconnected;
+		for(k = 0; k < len; k++) {
+			if(mark[path[k]] == V_NONE) {
+				mark[path[k]] = V_PATH;
+				set[n++] = path[k];
+			}
+		}
+	}
+	free(mark);
+
+	/* The terminals go last, so the root is a terminal */
+	memcpy(set + n, stein->terminals, sizeof(*set) * stein->n_terminals);
+	n += stein->n_terminals;
+
+	if(!retrieve_mst_set(stein, set, n, sol, NULL, arena)) {
+		free(set);
+		goto fail_decode;
+	}
+	free(set);
+	return 0;
+
+fail_disconnected:
+	free(mark);
+	free(set);
+fail_decode:
+	ERRNO = EDISCONNECTED;
+	pr_debug("The closure edges do not connect the terminals.\n");
+	return ERRNO;
+fail_alloc:
+	ERRNO = ENOMEM;
+	pr_error("There is no memory left to allocate. ERRNO=%d\n\n", ERRNO);
+	return ERRNO;
+}
+
+
+/**
+ * closure_apply - Make the closure the graph of stein, as a complete graph in
+ * the ADJ_FULL layout whose edges weigh the distances, until
+ * closure_restore(). The distance from a vertex to itself becomes W_INF, as
+ * there is no loop in the graph.
+ *
+ * @c: closure of the graph of stein.
+ * @stein: stein structure with the graph representation.
+ * */
+void closure_apply(struct closure *c, struct stein *stein)
+{
+	unsigned int u, v, n_edges = 0u;
+
+	for(u = 0; u < c->n; u++) {
+		c->dist[(size_t)u * c->n + u] = W_INF;
+		for(v = u + 1; v < c->n; v++)
+			n_edges += closure_dist(c, u, v) != W_INF;
+	}
+
+	c->graph = *stein;
+	c->applied = 1;
+	stein->n_edges = n_edges;
+	stein->adj_m = c->dist;
+	stein->layout = ADJ_FULL;
+	stein->w_size = sizeof(unsigned int);
+	stein->adj_map = c->dist;
+	stein->adj_size = c->dist_size;
+	pr_debug("The search runs on the closure, with %u edges.\n", n_edges);
+}
+
+
+/**
+ * closure_restore - Give stein its own graph back, if the closure was
+ * applied, see closure_apply().
+ *
+ * @c: closure.
+ * @stein: stein structure the closure was applied to.
+ * */
+void closure_restore(struct closure *c, struct stein *stein)
+{
+	if(!c->applied)
+		return;
+	*stein = c->graph;
+	c->applied = 0;
+}
+
+
+/**
+ * closure_free - Release the memory of the closure.
+ *
+ * @c: closure.
+ * */
+void closure_free(struct closure *c)
+{
+	if(c->dist)
+		munmap(c->dist, c->dist_size);
+	if(c->pred)
+		munmap(c->pred, c->pred_size);
+	memset(c, 0, sizeof(*c));
+}
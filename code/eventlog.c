@@ -0,0 +1,289 @@
+/**
+ * eventlog.c - Binary log of the decisions of the genetic algorithm, to tell
+ * whether a run is reproduced exactly.
+ * */
+
+#include <string.h>
+
+#include "include/eventlog.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/**
+ * event_log_create - Create the log file and write its header. Returns an
+ * error number (!= 0) if the file could not be written.
+ *
+ * @log: log to initialize.
+ * @path: file to create.
+ * @h: header, whose magic, version and byte order are filled.
+ * */
+int event_log_create(struct event_log *log, const char *path,
+		struct event_header *h)
+{
+	memset(log, 0, sizeof(*log));
+	memcpy(h->magic, EVENT_LOG_MAGIC, sizeof(h->magic));
+	h->version = EVENT_LOG_VERSION;
+	h->byte_order = EVENT_LOG_BYTE_ORDER;
+
+	if(!(log->file = fopen(path, "wb"))) {
+		ERRNO = EFILE_NOT_FOUND;
+		pr_fatal("Could not create the log %s.\n", path);
+		return ERRNO;
+	}
+	if(fwrite(h, sizeof(*h), 1, log->file) != 1) {
+		fclose(log->file);
+		log->file = NULL;
+		ERRNO = EUNEXPECTED_ERROR;
+		pr_fatal("Could not write the log %s.\n", path);
+		return ERRNO;
+	}
+	pthread_mutex_init(&log->lock, NULL);
+	return 0;
+}
+
+
+/**
+ * read_events - Read the events following the header, grouped by island in
+ * their order. Returns an error number (!= 0) if there is no memory or the
+ * file is cut short.
+ * */
+static int read_events(struct event_log *log, FILE *file)
+{
+	struct event *tmp;
+	size_t i, n;
+	long start = ftell(file);
+
+	if(start < 0 || fseek(file, 0, SEEK_END) != 0)
+		return EUNEXPECTED_ERROR;
+	n = (ftell(file) - start) / sizeof(*tmp);
+	if(fseek(file, start, SEEK_SET) != 0)
+		return EUNEXPECTED_ERROR;
+
+	if(!(tmp = malloc(sizeof(*tmp) * (n ? n : 1))) ||
+			!(log->events = malloc(sizeof(*tmp) * (n ? n : 1)))) {
+		free(tmp);
+		return ENOMEM;
+	}
+	if(fread(tmp, sizeof(*tmp), n, file) != n) {
+		free(tmp);
+		return EINVALID_FILE_FORMAT;
+	}
+
+	/* The events of an island were written in their order, so a counting
+	 * sort on the island keeps it */
+	for(i = 0; i < n; i++) {
+		if(tmp[i].island >= log->n_islands) {
+			free(tmp);
+			return EINVALID_FILE_FORMAT;
+		}
+		log->end[tmp[i].island]++;
+	}
+	for(i = 1; i < log->n_islands; i++)
+		log->end[i] += log->end[i - 1];
+	for(i = 0; i < log->n_islands; i++)
+		log->next[i] = i > 0 ? log->end[i - 1] : 0;
+	for(i = 0; i < n; i++)
+		log->events[log->next[tmp[i].island]++] = tmp[i];
+
+	/* Back to the first event of each island */
+	for(i = 0; i < log->n_islands; i++)
+		log->next[i] = i > 0 ? log->end[i - 1] : 0;
+
+	log->n_events = n;
+	free(tmp);
+	return 0;
+}
+
+
+/**
+ * event_log_replay - Read a log to replay, and its header. Returns an error
+ * number (!= 0) if the file could not be read or is not a log.
+ *
+ * @log: log to initialize.
+ * @path: file to read.
+ * @h: header read.
+ * */
+int event_log_replay(struct event_log *log, const char *path,
+		struct event_header *h)
+{
+	FILE *file;
+	int err;
+
+	memset(log, 0, sizeof(*log));
+	if(!(file = fopen(path, "rb"))) {
+		ERRNO = EFILE_NOT_FOUND;
+		pr_fatal("Could not open the log %s.\n", path);
+		return ERRNO;
+	}
+	if(fread(h, sizeof(*h), 1, file) != 1 ||
+			memcmp(h->magic, EVENT_LOG_MAGIC, sizeof(h->magic)) != 0 ||
+			h->version != EVENT_LOG_VERSION ||
+			h->byte_order != EVENT_LOG_BYTE_ORDER ||
+			h->n_islands == 0) {
+		ERRNO = EINVALID_FILE_FORMAT;
+		goto fail_replay;
+	}
+
+	log->n_islands = h->n_islands;
+	if(!(log->next = calloc(h->n_islands, sizeof(*log->next))) ||
+			!(log->end = calloc(h->n_islands, sizeof(*log->end)))) {
+		ERRNO = ENOMEM;
+		goto fail_replay;
+	}
+	if((err = read_events(log, file)) != 0) {
+		ERRNO = err;
+		goto fail_replay;
+	}
+	fclose(file);
+
+	pthread_mutex_init(&log->lock, NULL);
+	pr_debug("%lu events to replay, from the seed %llu.\n",
+			(unsigned long)log->n_events,
+			(unsigned long long)h->seed);
+	return 0;
+
+fail_replay:
+	pr_fatal("Could not read the log %s.\n", path);
+	fclose(file);
+	free(log->events);
+	free(log->next);
+	free(log->end);
+	memset(log, 0, sizeof(*log));
+	return ERRNO;
+}
+
+
+/**
+ * check_events - Compare the events to the next ones of their island in the
+ * log being replayed. Returns an error number (!= 0) at the first one which
+ * differs.
+ * */
+static int check_events(struct event_log *log, const struct event *events,
+		unsigned int n)
+{
+	const struct event *e;
+	size_t *next;
+	unsigned int i, k;
+
+	for(k = 0; k < n; k++) {
+		i = events[k].island;
+		next = i < log->n_islands ? &log->next[i] : NULL;
+		e = next && *next < log->end[i] ? &log->events[*next] : NULL;
+		if(!e || memcmp(e, &events[k], sizeof(*e)) != 0) {
+			log->diverged = 1;
+			pr_error("Island %u, generation %u, child %u: parents"
+					" %u and %u, weight %u after the"
+					" crossover, %u mutations, weight %u.\n",
+					events[k].island, events[k].generation,
+					events[k].child, events[k].p1,
+					events[k].p2, events[k].cross_w,
+					events[k].n_mutations, events[k].w);
+			if(e)
+				pr_error("The log has: generation %u, child"
+						" %u: parents %u and %u, weight"
+						" %u after the crossover, %u"
+						" mutations, weight %u.\n\n",
+						e->generation, e->child,
+						e->p1, e->p2, e->cross_w,
+						e->n_mutations, e->w);
+			ERRNO = EUNEXPECTED_ERROR;
+			return ERRNO;
+		}
+		(*next)++;
+		log->n_checked++;
+	}
+	return 0;
+}
+
+
+/**
+ * event_log_record - Write the events to the log, or when replaying, check
+ * them against the next events of their island. Returns an error number
+ * (!= 0) if the file could not be written, or the events differ from the
+ * ones replayed.
+ *
+ * @log: log.
+ * @events: events of consecutive children of an island.
+ * @n: number of events.
+ * */
+int event_log_record(struct event_log *log, const struct event *events,
+		unsigned int n)
+{
+	int err = 0;
+
+	if(n == 0)
+		return 0;
+
+	pthread_mutex_lock(&log->lock);
+	if(!log->file)
+		err = check_events(log, events, n);
+	else if(fwrite(events, sizeof(*events), n, log->file) != n)
+		err = EUNEXPECTED_ERROR;
+	pthread_mutex_unlock(&log->lock);
+	return err;
+}
+
+
+/**
+ * event_log_ended - Return 1 if the events of the island were all replayed.
+ *
+ * @log: log, or NULL.
+ * @island: island.
+ * */
+int event_log_ended(struct event_log *log, unsigned int island)
+{
+	int ended;
+
+	if(!log || log->file)
+		return 0;
+	pthread_mutex_lock(&log->lock);
+	ended = log->next[island] == log->end[island];
+	pthread_mutex_unlock(&log->lock);
+	return ended;
+}
+
+
+/**
+ * event_log_close - Close the log and release its memory. Returns an error
+ * number (!= 0) if the file could not be written, or when replaying, if
+ * events of the log were never met.
+ *
+ * @log: log.
+ * */
+int event_log_close(struct event_log *log)
+{
+	unsigned int i;
+	int err = 0;
+
+	if(log->file) {
+		if(fclose(log->file) != 0)
+			err = EUNEXPECTED_ERROR;
+	} else if(log->diverged) {
+		pr_info("Replay: the run diverged from the log after %lu"
+				" events.\n", log->n_checked);
+		err = EUNEXPECTED_ERROR;
+	} else if(log->n_checked != log->n_events) {
+		for(i = 0; i < log->n_islands; i++) {
+			if(log->next[i] < log->end[i])
+				pr_error("Island %u stopped with %lu events"
+						" of the log left.\n\n", i,
+						(unsigned long)(log->end[i] -
+							log->next[i]));
+		}
+		pr_info("Replay: %lu events checked, %lu never met.\n",
+				log->n_checked,
+				(unsigned long)log->n_events - log->n_checked);
+		err = EUNEXPECTED_ERROR;
+	} else {
+		pr_info("Replay: the %lu events of the log were reproduced.\n",
+				log->n_checked);
+	}
+
+	pthread_mutex_destroy(&log->lock);
+	free(log->events);
+	free(log->next);
+	free(log->end);
+	memset(log, 0, sizeof(*log));
+	return err;
+}
@@ -4,26 +4,32 @@
  * Contains only one exported function: get_stein_from_file.
  * All the others are only used internally.
  *
+ * The file is mapped read-only in memory and scanned once, character by
+ * character, without copying the lines to a buffer. Files in the binary
+ * format of bin_file.h are loaded as well, and the text files may be cached
+ * in that format.
  *
  * */
 
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #include "include/errno.h"
 #include "include/print.h"
 #include "include/file_reader.h"
+#include "include/bin_file.h"
 
 
-#define BUFFER_SIZE 128
-
-static char buffer[BUFFER_SIZE];
-
-static char *_str_token = NULL;
-
-/* Field separator in the files */
-static const char _token[2] = " ";
+/* Minimum number of bytes of edge lines parsed by each thread */
+#ifndef PARSE_CHUNK_MIN
+#define PARSE_CHUNK_MIN (1 << 20)
+#endif
 
 static char _nodes[] = "Nodes";
 static char _edges[] = "Edges";
@@ -33,111 +39,410 @@ static char _terminal_prefix[] = "T";
 
 
 /**
- * Internal method to get the file lines and increment the line counter to keep
- * track of the current line number.
+ * Position of the scan in the mapped file. The scan never goes beyond end,
+ * which is where the mapping ends.
+ * */
+struct reader {
+	const char *p;
+	const char *end;
+};
+
+
+/**
+ * Line counter to keep track of the current line number. It is incremented
+ * whenever a line is started by begin_line().
  * */
 static int FILE_LINE = 0;
-static inline char *__fgets(char *buffer, int buff_size, FILE *file)
+
+
+/**
+ * skip_blanks - Move the reader beyond any space or tab.
+ * */
+static inline void skip_blanks(struct reader *r)
+{
+	while(r->p < r->end && (*r->p == ' ' || *r->p == '\t'))
+		r->p++;
+}
+
+
+/**
+ * begin_line - Start a new line, returning an error number (!= 0) if the
+ * file has already ended.
+ * */
+static inline int begin_line(struct reader *r)
 {
 	FILE_LINE++;
-	return fgets(buffer, buff_size, file);
+	return r->p < r->end ? 0 : EINVALID_FILE_FORMAT;
+}
+
+
+/**
+ * end_line - Check that there is nothing but blanks until the end of the
+ * current line, and move the reader to the next one. The last line of the
+ * file may end without the line feed.
+ * */
+static inline int end_line(struct reader *r)
+{
+	skip_blanks(r);
+	if(r->p < r->end && *r->p == '\r')
+		r->p++;
+	if(r->p == r->end)
+		return 0;
+	if(*r->p != '\n')
+		return EINVALID_FILE_FORMAT;
+	r->p++;
+	return 0;
+}
+
+
+/**
+ * read_word - Check that the next word in the line is the given one.
+ *
+ * @r: reader positioned before the word.
+ * @word: expected word.
+ * */
+static inline int read_word(struct reader *r, const char *word)
+{
+	size_t len = strlen(word);
+
+	skip_blanks(r);
+	if((size_t)(r->end - r->p) <= len || memcmp(r->p, word, len) != 0 ||
+			(r->p[len] != ' ' && r->p[len] != '\t'))
+		return EINVALID_FILE_FORMAT;
+	r->p += len;
+	return 0;
 }
 
 
 /**
- * strtous - Converts the nptr string into a unsigned int,
- * using the function strtoul with error verification during the convertion.
+ * read_uint - Read the next decimal number in the line, checking that it is
+ * not greater than UINT_MAX.
  *
- * @nptr: String to convert
- * @endptr: Pointer to a pointer to the address of the first invalid character.
- * @base: Convertion base, e.g, decimal(10), hexadecimal(16), etc.
+ * @r: reader positioned before the number.
+ * @value: set with the number read.
  * */
-static unsigned int strtous(char *nptr, char **endptr, int base)
+static inline int read_uint(struct reader *r, unsigned int *value)
 {
-	unsigned long tmp_value;
-	unsigned int value = UINT_MAX;
+	const char *start;
+	unsigned long v = 0ul;
+
+	skip_blanks(r);
+	for(start = r->p; r->p < r->end; r->p++) {
+		unsigned int d = (unsigned int)(*r->p - '0');
 
-	errno = 0;
-	tmp_value = strtoul(nptr, endptr, base);
-	if(errno == 0 && tmp_value <= UINT_MAX) {
-		value = (unsigned int) tmp_value;
+		if(d > 9u)
+			break;
+		v = v * 10u + d;
+		if(v > UINT_MAX)
+			return EINVALID_FILE_FORMAT;
 	}
-	check_error();
-	return value;
+	if(r->p == start)
+		return EINVALID_FILE_FORMAT;
+
+	*value = (unsigned int)v;
+	return 0;
 }
 
+
 /**
  * set_field - Set the given field with the value retrieved from the file.
  * If the field was not found, the method returns an error number (!= 0).
  *
- * @file: file with the field to retrieve, with stream position in the begining
- * of the line.
+ * @r: reader at the begining of the line with the field to retrieve.
  * @field_name: field to search as the first word in the line.
  * @member_to_set: address to the field which will be set with the retrieved
  * value.
  */
-static int set_field(FILE *file, char *field_name, unsigned int *member_to_set)
+static int set_field(struct reader *r, char *field_name,
+		unsigned int *member_to_set)
+{
+	if(begin_line(r) != 0 || read_word(r, field_name) != 0 ||
+			read_uint(r, member_to_set) != 0)
+		return EINVALID_FILE_FORMAT;
+
+	return end_line(r);
+}
+
+/**
+ * read_edge - Read an edge line, from the prefix to the line feed, checking
+ * that both vertexes exist and are different. The vertexes are returned
+ * starting at 0.
+ *
+ * @r: reader at the begining of the edge line.
+ * @prefix: prefix to be checked as the first character in the line.
+ * @stein: current stein structure.
+ * @e: filled with the vertexes and the weight of the edge.
+ * */
+static inline int read_edge(struct reader *r, const char *prefix,
+		const struct stein *stein, unsigned int *e)
+{
+	if(read_word(r, prefix) != 0 || read_uint(r, &e[0]) != 0 ||
+			read_uint(r, &e[1]) != 0 || read_uint(r, &e[2]) != 0 ||
+			end_line(r) != 0)
+		return EINVALID_FILE_FORMAT;
+
+	 /* The vertex indexes in the files are numbers from 1 to V
+	  * (number of vertexes), therefore the indexes are decreased by 1.
+	 * */
+	e[0]--;
+	e[1]--;
+
+	/* The triangle layout has no cells for the diagonal */
+	if(e[0] >= stein->n_nodes || e[1] >= stein->n_nodes || e[0] == e[1])
+		return EINVALID_FILE_FORMAT;
+
+	return 0;
+}
+
+
+/**
+ * set_edge - Read an edge line and set its weight in the matrix. It does not
+ * touch FILE_LINE, thus it may run in several threads at once.
+ *
+ * @r: reader at the begining of the edge line.
+ * @prefix: prefix to be checked as the first character in the line.
+ * @stein: current stein structure.
+ * @max_w: updated with the edge weight, if it is greater.
+ * */
+static inline int set_edge(struct reader *r, const char *prefix,
+		struct stein *stein, unsigned int *max_w)
 {
+	unsigned int e[3];
 
-	if(__fgets(buffer, BUFFER_SIZE, file) == NULL)
+	if(read_edge(r, prefix, stein, e) != 0)
 		return EINVALID_FILE_FORMAT;
 
-	_str_token = strtok(buffer, _token);
-	if(strcmp(_str_token, field_name) != 0)
+	/**
+	 * As the graph is undirected, the weight of (i, j) is the same
+	 * as the weight of (j, i). And the edges are only once in the
+	 * file, so stein_set_w() stores both or, in the triangle
+	 * layout, the single cell they share.
+	 */
+	stein_set_w(stein, e[0], e[1], e[2]);
+	if(e[2] > *max_w)
+		*max_w = e[2];
+	pr_debug("Edge(%d,%d) weight value: %u.\n", e[0] + 1, e[1] + 1,
+			stein_w(stein, e[0], e[1]));
+	return 0;
+}
+
+
+/**
+ * set_csr_values - Read the next n=stein->n_edges lines of the file into a
+ * list of edges, and build the ADJ_CSR arrays from it once they are all read.
+ *
+ * @r: reader at the begining of the first edge line.
+ * @prefix: prefix to be checked as the first character in the line.
+ * @stein: current stein structure.
+ * */
+static int set_csr_values(struct reader *r, char *prefix, struct stein *stein)
+{
+	unsigned int (*edges)[3], x;
+	int err = 0;
+
+	if(!(edges = malloc(sizeof(*edges) * stein->n_edges)))
+		return ENOMEM;
+
+	for(x = 0; x < stein->n_edges && err == 0; x++) {
+		if(begin_line(r) != 0 ||
+				read_edge(r, prefix, stein, edges[x]) != 0)
+			err = EINVALID_FILE_FORMAT;
+	}
+
+	if(err == 0)
+		err = fill_csr((const unsigned int (*)[3])edges);
+	free(edges);
+	return err;
+}
+
+
+/**
+ * A range of whole edge lines parsed by one thread. The lines are counted, so
+ * the line of an error can be told once the preceding chunks are done.
+ * */
+struct edge_chunk {
+	pthread_t thread;
+	int started;
+	struct reader r;
+	const char *prefix;
+	struct stein *stein;
+	unsigned int lines;
+	unsigned int max_w;
+	int err;
+};
+
+
+/**
+ * set_chunk_values - Thread function parsing every line of an edge_chunk,
+ * stopping at the first invalid one.
+ * */
+static void *set_chunk_values(void *arg)
+{
+	struct edge_chunk *c = arg;
+
+	while(c->r.p < c->r.end) {
+		if((c->err = set_edge(&c->r, c->prefix, c->stein,
+						&c->max_w)) != 0)
+			break;
+		c->lines++;
+	}
+	return NULL;
+}
+
+
+/**
+ * find_blank_line - Return the begining of the first line with nothing but
+ * blanks, or end if there is no such line.
+ * */
+static const char *find_blank_line(const char *p, const char *end)
+{
+	while(p < end) {
+		const char *q = p;
+
+		while(q < end && (*q == ' ' || *q == '\t' || *q == '\r'))
+			q++;
+		if(q == end || *q == '\n')
+			return p;
+
+		if(!(p = memchr(q, '\n', end - q)))
+			return end;
+		p++;
+	}
+	return end;
+}
+
+
+/**
+ * set_matrix_values_parallel - Split the edge lines in byte ranges starting
+ * at line boundaries and parse each range in its own thread. Every edge is only
+ * once in the file, so the threads never write the same matrix cell.
+ *
+ * The error reported is the first one in the file, whatever the thread
+ * finishing first, and FILE_LINE is left as the sequential parsing would.
+ *
+ * @r: reader at the begining of the first edge line.
+ * @end: begining of the blank line after the edges.
+ * @prefix: prefix to be checked as the first character in the line.
+ * @stein: current stein structure.
+ * @n_threads: number of chunks to parse.
+ * @max_w: set with the greatest weight.
+ * */
+static int set_matrix_values_parallel(struct reader *r, const char *end,
+		char *prefix, struct stein *stein, unsigned int n_threads,
+		unsigned int *max_w)
+{
+	struct edge_chunk *chunks;
+	const char *p = r->p;
+	unsigned int t, lines = 0u;
+	int err = 0;
+
+	if(!(chunks = calloc(n_threads, sizeof(*chunks))))
+		return ENOMEM;
+
+	for(t = 0; t < n_threads; t++) {
+		const char *q = r->p + (end - r->p) / n_threads * (t + 1);
+
+		/* Move the boundary to the begining of the next line */
+		if(t == n_threads - 1 || !(q = memchr(q, '\n', end - q)))
+			q = end;
+		else
+			q++;
+
+		chunks[t].r.p = p;
+		chunks[t].r.end = q;
+		chunks[t].prefix = prefix;
+		chunks[t].stein = stein;
+
+		/* The first chunk is left for the current thread */
+		if(t > 0)
+			chunks[t].started = pthread_create(&chunks[t].thread,
+					NULL, set_chunk_values, &chunks[t]) == 0;
+		p = q;
+	}
+
+	/* The chunks without a thread are parsed right here */
+	for(t = 0; t < n_threads; t++) {
+		if(chunks[t].started)
+			continue;
+		set_chunk_values(&chunks[t]);
+	}
+
+	for(t = 0; t < n_threads; t++) {
+		if(chunks[t].started)
+			pthread_join(chunks[t].thread, NULL);
+	}
+
+	for(t = 0; t < n_threads; t++) {
+		lines += chunks[t].lines;
+		if(chunks[t].err != 0 && err == 0) {
+			err = chunks[t].err;
+			FILE_LINE += lines + 1;
+		}
+		if(chunks[t].max_w > *max_w)
+			*max_w = chunks[t].max_w;
+	}
+	free(chunks);
+
+	if(err != 0)
+		return err;
+
+	/* The blank line must come right after the n_edges lines */
+	FILE_LINE += lines < stein->n_edges ? lines + 1 : stein->n_edges;
+	if(lines != stein->n_edges)
 		return EINVALID_FILE_FORMAT;
 
-	_str_token = strtok(NULL, _token);
-	*member_to_set = strtous(_str_token, NULL, 0);
+	r->p = end;
 	return 0;
 }
 
+
 /**
- * set_matrix_values - Read the next n=stein->n_edges lines of 
+ * set_matrix_values - Read the next n=stein->n_edges lines of
  * the file getting the edges weights.
  * Each line with the edge information has the following format:
  * "E V1 V2 W\n" where "E" is a prefix, V1 and V2
  * are the vertex of the edge and W is the edge weight.
  *
- * @file: file with the field to retrieve, with stream position in the begining
- * of the line.
+ * Edge sections of at least PARSE_CHUNK_MIN bytes are parsed by one thread per
+ * PARSE_CHUNK_MIN bytes, up to the number of online processors. Sparse graphs
+ * are handed to set_csr_values().
+ *
+ * @r: reader at the begining of the first edge line.
  * @prefix: prefix to be checked as the first character in the line.
  * @stein: current stein structure.
  * */
-static int set_matrix_values(FILE *file, char *prefix, struct stein *stein)
+static int set_matrix_values(struct reader *r, char *prefix,
+		struct stein *stein)
 {
-	unsigned int i, j, w, x;
-
-	for(x = 0; x < stein->n_edges; x++) {
-		if(__fgets(buffer, BUFFER_SIZE, file) == NULL)
-			return EINVALID_FILE_FORMAT;
+	unsigned int x, max_w = 0u;
+	long n_threads = 1, n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	const char *end = r->p;
+
+	if(stein->layout == ADJ_CSR)
+		return set_csr_values(r, prefix, stein);
+
+	if(n_cpus > 1 && (size_t)(r->end - r->p) >= 2 * PARSE_CHUNK_MIN) {
+		end = find_blank_line(r->p, r->end);
+		n_threads = (end - r->p) / PARSE_CHUNK_MIN;
+		if(n_threads > n_cpus)
+			n_threads = n_cpus;
+	}
 
-		_str_token = strtok(buffer, _token);
-		if(strcmp(_str_token, prefix) != 0)
+	if(n_threads > 1) {
+		if(set_matrix_values_parallel(r, end, prefix, stein, n_threads,
+					&max_w) != 0)
 			return EINVALID_FILE_FORMAT;
-
-		 /* The vertex indexes in the files are numbers from 1 to V 
-		  * (number of vertexes), therefore the indexes are decreased by 1.
-		 * */
-		_str_token = strtok(NULL, _token);
-		i = strtous(_str_token, NULL, 0) - 1u;
-
-		_str_token = strtok(NULL, _token);
-		j = strtous(_str_token, NULL, 0) - 1u;
-
-		_str_token = strtok(NULL, _token);
-		w = strtous(_str_token, NULL, 0);
-
-		/**
-		 * As the graph is complete and undirected, the weight of (i, j)
-		 * is the same as the weight of (j, i). And the edges are only
-		 * once in the file.
-		 */
-		stein->adj_m[i][j] = w;
-		stein->adj_m[j][i] = w;
-		pr_debug("Edge(%d,%d) weight value: %u.\n", i + 1, j + 1,
-				stein->adj_m[i][j]);
+	} else {
+		for(x = 0; x < stein->n_edges; x++) {
+			if(begin_line(r) != 0 ||
+					set_edge(r, prefix, stein, &max_w) != 0)
+				return EINVALID_FILE_FORMAT;
+		}
 	}
 
+	/* Smaller cells keep more of the matrix in the cache */
+	compact_adj_m(max_w);
+
 	return 0;
 }
 
@@ -145,12 +450,11 @@ static int set_matrix_values(FILE *file, char *prefix, struct stein *stein)
 /**
  * set_terminals - Read stein->n_terminals lines to get all the graph terminals.
  *
- * @file: file with the field to retrieve, with stream position in the begining
- * of the line.
+ * @r: reader at the begining of the first terminal line.
  * @prefix: prefix to be checked as the first character in the line.
  * @stein: current stein structure.
  * */
-static int set_terminals(FILE *file, char *prefix, struct stein *stein)
+static int set_terminals(struct reader *r, char *prefix, struct stein *stein)
 {
 	unsigned int i, v;
 
@@ -158,17 +462,14 @@ static int set_terminals(FILE *file, char *prefix, struct stein *stein)
 	alloc_terminals();
 
 	for(i = 0; i < stein->n_terminals; i++) {
-		if(__fgets(buffer, BUFFER_SIZE, file) == NULL)
+		if(begin_line(r) != 0 || read_word(r, prefix) != 0 ||
+				read_uint(r, &v) != 0 || end_line(r) != 0)
 			return EINVALID_FILE_FORMAT;
 
-		_str_token = strtok(buffer, _token);
-		if(strcmp(_str_token, prefix) != 0)
+		if(v == 0 || v > stein->n_nodes)
 			return EINVALID_FILE_FORMAT;
 
-		_str_token = strtok(NULL, _token);
-		v = strtous(_str_token, NULL, 0);
-
-		 /* The vertex indexes in the files are numbers from 1 to V 
+		 /* The vertex indexes in the files are numbers from 1 to V
 		  * (number of vertexes), therefore the indexes are decreased by 1.
 		 * */
 		stein->terminals[i] = v - 1u;
@@ -179,21 +480,20 @@ static int set_terminals(FILE *file, char *prefix, struct stein *stein)
 
 
 /**
- * get_stein_from_file - Retrieve the data from the given file and returns the stein structure
- * associated with the extracted data.
- * @filename: path to the file from where to retrieve the data.
+ * get_stein_from_text - Retrieve the data from the mapped text file and returns
+ * the stein structure associated with the extracted data.
+ *
+ * @map: mapped file.
+ * @size: size of the mapping.
  * */
-struct stein *get_stein_from_file(char *filename)
+static struct stein *get_stein_from_text(const char *map, size_t size)
 {
-	FILE *file;
+	struct reader r;
 	struct stein *stein_data;
-	char *chk_eof;
 
-	if(!(file = fopen(filename, "r+"))) {
-		ERRNO = EFILE_NOT_FOUND;
-		pr_error("\nInvalid file. errno=%d\n\n", ERRNO);
-		return NULL;
-	}
+	r.p = map;
+	r.end = r.p + size;
+	FILE_LINE = 0;
 
 	stein_data = get_stein();
 	pr_debug("Getting stein_data at 0x%p...\n", stein_data);
@@ -201,8 +501,8 @@ struct stein *get_stein_from_file(char *filename)
 	/* Retrieve and check if the nodes and edge totals
 	 * were retrieved correctly.
 	 * */
-	if(set_field(file, _nodes, &(stein_data->n_nodes)) != 0 ||
-		set_field(file, _edges, &(stein_data->n_edges)) != 0) {
+	if(set_field(&r, _nodes, &(stein_data->n_nodes)) != 0 ||
+		set_field(&r, _edges, &(stein_data->n_edges)) != 0) {
 		goto close_file;
 	}
 	pr_debug("Fields changed: n_nodes=%u; n_edges=%u.\n",
@@ -213,6 +513,8 @@ struct stein *get_stein_from_file(char *filename)
 	 * edges.
 	 * */
 	alloc_adj_m();
+	if(!stein_data->adj_m)
+		return NULL;
 	pr_debug("Adjacency matrix created at=0x%p\n", stein_data->adj_m);
 
 
@@ -220,25 +522,25 @@ struct stein *get_stein_from_file(char *filename)
 	 * the following format: "E V1 V2 W\n" where "E" is a prefix, V1 and V2
 	 * are the vertex of the edge and W is the edge weight.
 	 * */
-	if(set_matrix_values(file, _edge_prefix, stein_data) != 0) {
+	if(set_matrix_values(&r, _edge_prefix, stein_data) != 0) {
 		goto close_file;
 	}
 
 	/* There is an empty line afer getting the edges
 	 * */
-	chk_eof = __fgets(buffer, BUFFER_SIZE, file);
-	if(chk_eof == NULL || strcmp(chk_eof, "\n") != 0) {
-		pr_error("\nWrong file format. Missing empty line at line %d. check_eof=%s.\n\n", FILE_LINE, chk_eof);
+	if(begin_line(&r) != 0 || end_line(&r) != 0) {
+		pr_fatal("Wrong file format. Missing empty line at line %d.\n",
+				FILE_LINE);
 		goto close_file;
 	}
 
 
 	/* Retrieve and check the number of terminals given in the file.
 	 * */
-	if(set_field(file, _terminals, &(stein_data->n_terminals)) != 0) {
+	if(set_field(&r, _terminals, &(stein_data->n_terminals)) != 0) {
 		goto close_file;
 	}
-	stein_data->not_t = stein_data->n_edges - stein_data->n_terminals;
+	stein_data->not_t = stein_data->n_nodes - stein_data->n_terminals;
 	pr_debug("Fields changed: n_terminals=%u, not_t=%u.\n",
 			stein_data->n_terminals, stein_data->not_t);
 
@@ -246,17 +548,96 @@ struct stein *get_stein_from_file(char *filename)
 	/* The next stein_data->n_terminals lines contains the edges that are
 	 * terminals in the stein tree.
 	 * */
-	if(set_terminals(file, _terminal_prefix, stein_data) != 0) {
+	if(set_terminals(&r, _terminal_prefix, stein_data) != 0) {
 		goto close_file;
 	}
 
-	fclose(file);
 	return stein_data;
 
 close_file:
 	ERRNO = EINVALID_FILE_FORMAT;
-	pr_error("\nWrong file format at line %d.\n\n", FILE_LINE);
-	fclose(file);
+	pr_fatal("Wrong file format at line %d.\n", FILE_LINE);
 	return NULL;
 }
 
+
+/**
+ * map_file - Map the whole file in memory, with MAP_PRIVATE, returning NULL if
+ * it could not be opened or it is empty.
+ *
+ * @filename: path to the file.
+ * @st: filled with the file status.
+ * */
+static void *map_file(const char *filename, struct stat *st)
+{
+	int fd;
+	void *map;
+
+	if((fd = open(filename, O_RDONLY)) < 0)
+		return NULL;
+
+	if(fstat(fd, st) != 0 || st->st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+
+	/* The mapping stays valid after the descriptor is closed */
+	map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return NULL;
+
+	madvise(map, st->st_size, MADV_SEQUENTIAL);
+	return map;
+}
+
+
+/**
+ * get_stein_from_file - Retrieve the data from the given file and returns the stein structure
+ * associated with the extracted data.
+ * @filename: path to the file from where to retrieve the data.
+ * @use_cache: when set, a text file is loaded from its binary cache
+ * (filename + STEIN_BIN_SUFFIX) if the cache is up to date, and the cache is
+ * written otherwise.
+ * */
+struct stein *get_stein_from_file(char *filename, int use_cache)
+{
+	struct stat st, cache_st;
+	struct stein *stein_data;
+	char *cache_name = NULL;
+	void *map, *cache_map;
+
+	if(!(map = map_file(filename, &st))) {
+		ERRNO = EFILE_NOT_FOUND;
+		pr_fatal("Could not open the instance %s.\n", filename);
+		return NULL;
+	}
+
+	/* The binary files need no parsing, nor caching */
+	if(is_stein_bin(map, st.st_size))
+		return get_stein_from_bin(map, st.st_size, NULL);
+
+	if(use_cache) {
+		if(!(cache_name = malloc(strlen(filename) +
+						sizeof(STEIN_BIN_SUFFIX))))
+			use_cache = 0;
+		else
+			sprintf(cache_name, "%s%s", filename, STEIN_BIN_SUFFIX);
+	}
+
+	if(use_cache && (cache_map = map_file(cache_name, &cache_st)) &&
+			(stein_data = get_stein_from_bin(cache_map,
+				cache_st.st_size, &st))) {
+		pr_debug("Instance loaded from the cache %s.\n", cache_name);
+		goto unmap;
+	}
+
+	if((stein_data = get_stein_from_text(map, st.st_size)) && use_cache &&
+			put_stein_to_bin(cache_name, &st) != 0)
+		pr_warn("The cache %s was not written.\n", cache_name);
+
+unmap:
+	free(cache_name);
+	munmap(map, st.st_size);
+	return stein_data;
+}
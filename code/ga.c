@@ -0,0 +1,726 @@
+/**
+ * ga.c - Generation engine of the genetic algorithm: selection of the parents,
+ * reproduction and replacement, until one of the stopping rules holds.
+ * */
+
+#include <string.h>
+
+#include "include/ga.h"
+#include "include/population.h"
+#include "include/rng.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/**
+ * ga_default_params - Fill the parameters with the compile time defaults.
+ *
+ * @params: parameters to fill.
+ * */
+void ga_default_params(struct ga_params *params)
+{
+	params->pop_size = POP_SIZE;
+	params->mutation_rate = MUTATION_RATE;
+	params->crossover = CROSSOVER_UNIFORM;
+	params->crossover_rate = GA_CROSSOVER_RATE;
+	params->selection = GA_TOURNAMENT;
+	params->tournament_size = GA_TOURNAMENT_SIZE;
+	params->replacement = GA_GENERATIONAL;
+	params->elitism = GA_ELITISM;
+	params->max_generations = GA_GENERATIONS;
+	params->time_limit = 0.0;
+	params->stagnation = 0ul;
+	params->target_w = 0u;
+	params->bound = NULL;
+	params->max_gap = GA_MAX_GAP;
+	params->n_threads = GA_THREADS;
+	params->local_search = LS_FIRST;
+	params->ls_count = GA_LS_COUNT;
+	params->sph_roots = SPH_ROOTS;
+	params->seed = 0u;
+	params->log = NULL;
+	params->island = 0u;
+}
+
+
+/**
+ * elapsed - Seconds since the engine was initialized.
+ * */
+static double elapsed(const struct ga *ga)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - ga->start.tv_sec) +
+		(now.tv_nsec - ga->start.tv_nsec) / 1e9;
+}
+
+
+/**
+ * ga_check_params - Validate the parameters of a run. Returns an error number
+ * (!= 0) if any of them is out of range.
+ *
+ * @p: parameters to check.
+ * */
+int ga_check_params(const struct ga_params *p)
+{
+	if(p->pop_size == 0) {
+		pr_fatal("The population must have at least one individual.\n");
+		goto fail_params;
+	}
+	if(p->mutation_rate == 0) {
+		pr_fatal("The mutation rate must be at least 1.\n");
+		goto fail_params;
+	}
+	if(p->selection > GA_RANK || p->replacement > GA_STEADY_STATE ||
+			p->crossover > CROSSOVER_ONE_POINT ||
+			p->local_search > LS_BEST) {
+		pr_fatal("Unknown selection, replacement, crossover or local"
+				" search scheme.\n");
+		goto fail_params;
+	}
+	if(!(p->crossover_rate >= 0.0 && p->crossover_rate <= 1.0)) {
+		pr_fatal("The crossover rate must be between 0 and 1.\n");
+		goto fail_params;
+	}
+	if(p->tournament_size == 0) {
+		pr_fatal("The tournament size must be at least 1.\n");
+		goto fail_params;
+	}
+	if(p->elitism > p->pop_size) {
+		pr_fatal("The elite (%u) is larger than the population (%u).\n",
+				p->elitism, p->pop_size);
+		goto fail_params;
+	}
+	if(p->time_limit < 0.0) {
+		pr_fatal("The time limit can not be negative.\n");
+		goto fail_params;
+	}
+	if(p->max_gap < 0.0) {
+		pr_fatal("The gap can not be negative.\n");
+		goto fail_params;
+	}
+	return 0;
+
+fail_params:
+	ERRNO = EINVALID_ARGUMENT;
+	return ERRNO;
+}
+
+
+/**
+ * update_best - Keep a copy of the best individual of the current population
+ * if it beats the best one found so far. Returns an error number (!= 0) if
+ * there is no memory.
+ * */
+static int update_best(struct ga *ga)
+{
+	struct solution *best = &ga->best->pop[0], *s = NULL;
+	unsigned int i;
+	int err;
+
+	for(i = 0; i < ga->cur->size; i++) {
+		if(!s || ga->cur->pop[i].w < s->w)
+			s = &ga->cur->pop[i];
+	}
+	if(best->vertex && s->w >= best->w)
+		return 0;
+
+	/* Improvements are rare, so the old copy is simply dropped */
+	reset_generation(ga->best);
+	if((err = copy_solution(best, s, &ga->best->arena[0])) != 0)
+		return err;
+	ga->last_improvement = ga->generation;
+	pr_debug("Generation %lu: new best weight %u.\n", ga->generation,
+			best->w);
+	return 0;
+}
+
+
+/**
+ * worst_individual - Position of the heaviest individual of a generation.
+ * */
+static unsigned int worst_individual(const struct generation *g)
+{
+	unsigned int i, worst = 0u;
+
+	for(i = 1; i < g->size; i++) {
+		if(g->pop[i].w > g->pop[worst].w)
+			worst = i;
+	}
+	return worst;
+}
+
+
+/**
+ * cmp_rank - Order the individuals by weight, and then by position, so the
+ * ranking does not depend on the qsort implementation.
+ * */
+static int cmp_rank(const void *a, const void *b)
+{
+	const struct ga_rank *ra = a, *rb = b;
+
+	if(ra->w != rb->w)
+		return ra->w < rb->w ? -1 : 1;
+	return ra->i < rb->i ? -1 : ra->i > rb->i;
+}
+
+
+/**
+ * build_alias - Build the alias table of Vose's method from the weights in
+ * prob, which must average 1. Afterwards, drawing i uniformly and keeping it
+ * with probability prob[i], or taking alias[i] otherwise, draws each index
+ * with a probability proportional to its weight, in O(1).
+ *
+ * @prob: weights, replaced by the probabilities of the table.
+ * @alias: alias of each index.
+ * @work: room for n indexes.
+ * @n: number of indexes.
+ * */
+static void build_alias(double *prob, unsigned int *alias, unsigned int *work,
+		unsigned int n)
+{
+	/* The indexes below the average are stacked from the start of work,
+	 * and the others from its end. */
+	unsigned int i, n_small = 0u, n_large = n;
+
+	for(i = 0; i < n; i++) {
+		if(prob[i] < 1.0)
+			work[n_small++] = i;
+		else
+			work[--n_large] = i;
+	}
+
+	while(n_small > 0 && n_large < n) {
+		unsigned int s = work[--n_small], l = work[n_large];
+
+		alias[s] = l;
+		prob[l] -= 1.0 - prob[s];
+		if(prob[l] < 1.0) {
+			n_large++;
+			work[n_small++] = l;
+		}
+	}
+
+	/* Whatever is left is 1 but for rounding errors */
+	while(n_small > 0) {
+		i = work[--n_small];
+		prob[i] = 1.0;
+		alias[i] = i;
+	}
+	for(; n_large < n; n_large++) {
+		i = work[n_large];
+		prob[i] = 1.0;
+		alias[i] = i;
+	}
+}
+
+
+/**
+ * prepare_selection - Rank the current population and, for the roulette and
+ * rank selections, build the alias table the parents are drawn from.
+ * */
+static void prepare_selection(struct ga *ga)
+{
+	struct generation *g = ga->cur;
+	unsigned int i, n = g->size;
+	double sum = 0.0;
+
+	for(i = 0; i < n; i++) {
+		ga->rank[i].w = g->pop[i].w;
+		ga->rank[i].i = i;
+	}
+	qsort(ga->rank, n, sizeof(*ga->rank), cmp_rank);
+
+	switch(ga->params.selection) {
+	case GA_ROULETTE:
+		for(i = 0; i < n; i++) {
+			ga->prob[i] = 1.0 / (1.0 + g->pop[i].w);
+			sum += ga->prob[i];
+		}
+		for(i = 0; i < n; i++)
+			ga->prob[i] *= n / sum;
+		break;
+	case GA_RANK:
+		/* The best one weighs n and the worst one 1 */
+		for(i = 0; i < n; i++)
+			ga->prob[ga->rank[i].i] = 2.0 * (n - i) / (n + 1.0);
+		break;
+	default:
+		return;
+	}
+	build_alias(ga->prob, ga->alias, ga->alias + n, n);
+}
+
+
+/**
+ * select_parent - Draw the position of a parent in the current population.
+ * */
+static unsigned int select_parent(struct ga *ga, struct rng *rng)
+{
+	struct generation *g = ga->cur;
+	unsigned int i, k, p;
+
+	if(ga->params.selection != GA_TOURNAMENT) {
+		i = rng_bound(rng, g->size);
+		return rng_unit(rng) < ga->prob[i] ? i : ga->alias[i];
+	}
+
+	p = rng_bound(rng, g->size);
+	for(k = 1; k < ga->params.tournament_size; k++) {
+		i = rng_bound(rng, g->size);
+		if(g->pop[i].w < g->pop[p].w)
+			p = i;
+	}
+	return p;
+}
+
+
+/**
+ * reproduce - Write the child i of two selected parents, by the crossover or
+ * as a copy of the first one, and mutate and repair it. The draws come from
+ * the stream i of the generation, whatever the thread, and the decisions are
+ * written to the event of the child. Returns an error number (!= 0) if there
+ * is no memory.
+ * */
+static int reproduce(struct ga *ga, unsigned int i, struct solution *child,
+		unsigned int thread, struct arena *arena)
+{
+	struct rng *rng = get_rng();
+	struct event *e = &ga->events[i];
+	unsigned int *scratch = ga->scratch +
+		thread * population_scratch(ga->stein);
+	unsigned int p1, p2, n_cross;
+	int err;
+
+	rng_split(rng, ga->gen_seed, i);
+	p1 = select_parent(ga, rng);
+	p2 = select_parent(ga, rng);
+
+	/* Nothing is drawn at the default rate, which always crosses */
+	if(ga->params.crossover_rate >= 1.0 ||
+			rng_unit(rng) < ga->params.crossover_rate)
+		err = crossover(child, &ga->cur->pop[p1], &ga->cur->pop[p2],
+				ga->stein, ga->params.crossover, scratch,
+				arena);
+	else
+		err = copy_solution(child, &ga->cur->pop[p1], arena);
+	if(err != 0)
+		return err;
+
+	e->island = ga->params.island;
+	e->generation = ga->generation;
+	e->child = i;
+	e->p1 = p1;
+	e->p2 = p2;
+	e->cross_w = child->w;
+	n_cross = child->n_vertexes;
+	e->n_mutations = mutate_solution(child, ga->stein,
+			ga->params.mutation_rate, scratch, arena);
+	if(e->n_mutations > 0 &&
+			(err = repair_solution(child, ga->stein, n_cross,
+					scratch, arena)) != 0)
+		return err;
+	e->w = child->w;
+	return 0;
+}
+
+
+/* Arguments of the parallel loop improving the best individuals */
+struct improve_task {
+	struct ga *ga;
+	struct generation *g;
+
+	/* Set by an iteration which ran out of memory */
+	int failed;
+};
+
+
+/**
+ * improve_individual - Apply the local search to the i-th individual chosen
+ * by improve_best().
+ * */
+static void improve_individual(void *arg, unsigned int i, unsigned int thread)
+{
+	struct improve_task *task = arg;
+	struct ga *ga = task->ga;
+
+	if(local_search(ga->stein, &task->g->pop[ga->improve[i]],
+				ga->params.local_search, &ga->ls[thread],
+				&task->g->arena[thread]) != 0)
+		__atomic_store_n(&task->failed, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * improve_best - Apply the local search, in parallel, to the ls_count best
+ * individuals of g from the position first on. Returns an error number
+ * (!= 0) if there is no memory.
+ * */
+static int improve_best(struct ga *ga, struct generation *g,
+		unsigned int first)
+{
+	struct improve_task task = {ga, g, 0};
+	unsigned int *best = ga->improve, i, k, n = 0u;
+	unsigned int n_best = ga->params.ls_count;
+
+	if(ga->params.local_search == LS_NONE || n_best == 0)
+		return 0;
+
+	/* Insertion into the short sorted list of the best ones so far */
+	for(i = first; i < g->size; i++) {
+		if(n == n_best && g->pop[i].w >= g->pop[best[n - 1]].w)
+			continue;
+		k = n < n_best ? n++ : n - 1;
+		for(; k > 0 && g->pop[best[k - 1]].w > g->pop[i].w; k--)
+			best[k] = best[k - 1];
+		best[k] = i;
+	}
+
+	pool_run(&ga->pool, improve_individual, &task, n);
+	if(task.failed) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	return 0;
+}
+
+
+/* Arguments of the parallel loop breeding the children */
+struct breed_task {
+	struct ga *ga;
+
+	/* Individuals which are copied from the elite instead of bred */
+	unsigned int elitism;
+
+	/* Set by an iteration which ran out of memory */
+	int failed;
+};
+
+
+/**
+ * breed_child - Write the individual i of the next generation: a copy of the
+ * i-th best individual for the elite, a new child otherwise.
+ * */
+static void breed_child(void *arg, unsigned int i, unsigned int thread)
+{
+	struct breed_task *task = arg;
+	struct ga *ga = task->ga;
+	struct generation *next = ga->next;
+	int err;
+
+	if(i < task->elitism)
+		err = copy_solution(&next->pop[i], &ga->cur->pop[ga->rank[i].i],
+				&next->arena[thread]);
+	else
+		err = reproduce(ga, i, &next->pop[i], thread,
+				&next->arena[thread]);
+	if(err != 0)
+		__atomic_store_n(&task->failed, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * breed - Fill the next generation in parallel, the elite first, record the
+ * decisions which bred the children, and improve the best ones. Returns an
+ * error number (!= 0) if there is no memory, or the log could not be written
+ * or differs from the run replaying it.
+ * */
+static int breed(struct ga *ga, unsigned int elitism)
+{
+	struct breed_task task = {ga, elitism, 0};
+	int err;
+
+	reset_generation(ga->next);
+	ga->gen_seed = rng_next(&ga->rng);
+	pool_run(&ga->pool, breed_child, &task, ga->next->size);
+	if(task.failed) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	if(ga->params.log && (err = event_log_record(ga->params.log,
+					ga->events + elitism,
+					ga->next->size - elitism)) != 0)
+		return err;
+	return improve_best(ga, ga->next, elitism);
+}
+
+
+/**
+ * generational_step - Replace the whole population by children of its
+ * individuals, but the elite, which is copied unchanged.
+ * */
+static int generational_step(struct ga *ga)
+{
+	struct generation *next = ga->next;
+	int err;
+
+	if((err = breed(ga, ga->params.elitism)) != 0)
+		return err;
+
+	ga->next = ga->cur;
+	ga->cur = next;
+	return 0;
+}
+
+
+/**
+ * steady_state_step - Breed as many children as there are individuals, each
+ * replacing the worst individual if it is better. The children are bred in
+ * parallel from the population at the start of the step, in the next
+ * generation, which is only scratch memory here, and then inserted one at a
+ * time, the memory of the worst individual being reused.
+ * */
+static int steady_state_step(struct ga *ga)
+{
+	struct generation *g = ga->cur;
+	struct solution *child;
+	unsigned int k, worst;
+	int err;
+
+	if((err = breed(ga, 0u)) != 0)
+		return err;
+
+	for(k = 0; k < ga->next->size; k++) {
+		child = &ga->next->pop[k];
+		worst = worst_individual(g);
+		if(child->w < g->pop[worst].w && (err = copy_solution(
+						&g->pop[worst], child, &g->arena[0])) != 0)
+			return err;
+	}
+	return 0;
+}
+
+
+/**
+ * ga_init - Validate the parameters and create the initial population.
+ * Returns an error number (!= 0) on failure.
+ *
+ * @ga: engine to initialize.
+ * @stein: stein structure with the graph representation.
+ * @params: parameters of the run.
+ * */
+int ga_init(struct ga *ga, struct stein *stein, const struct ga_params *params)
+{
+	unsigned int n = params->pop_size, t;
+	int err;
+
+	memset(ga, 0, sizeof(*ga));
+	if((err = ga_check_params(params)) != 0)
+		return err;
+	if((err = pool_init(&ga->pool, params->n_threads)) != 0)
+		return err;
+
+	ga->stein = stein;
+	ga->params = *params;
+	rng_seed(&ga->rng, params->seed);
+	clock_gettime(CLOCK_MONOTONIC, &ga->start);
+
+	if(!(ga->cur = create_initial_population(stein, n,
+					params->mutation_rate, params->sph_roots,
+					rng_next(&ga->rng), &ga->pool))) {
+		ERRNO = EUNEXPECTED_ERROR;
+		goto fail_init;
+	}
+
+	if(!(ga->next = alloc_generation(n,
+					pool_threads(&ga->pool))) ||
+			!(ga->best = alloc_generation(1u, 1u)) ||
+			!(ga->rank = malloc(sizeof(*ga->rank) * n)) ||
+			!(ga->prob = malloc(sizeof(*ga->prob) * n)) ||
+			!(ga->alias = malloc(sizeof(*ga->alias) * 2 * n)) ||
+			!(ga->improve = malloc(sizeof(*ga->improve) * n)) ||
+			!(ga->events = malloc(sizeof(*ga->events) * n)) ||
+			!(ga->scratch = malloc(sizeof(*ga->scratch) *
+					pool_threads(&ga->pool) *
+					population_scratch(stein)))) {
+		ERRNO = ENOMEM;
+		goto fail_init;
+	}
+
+	if(params->local_search != LS_NONE) {
+		if(!(ga->ls = calloc(pool_threads(&ga->pool),
+						sizeof(*ga->ls)))) {
+			ERRNO = ENOMEM;
+			goto fail_init;
+		}
+		for(t = 0; t < pool_threads(&ga->pool); t++) {
+			if((err = ls_init(&ga->ls[t], stein)) != 0) {
+				ERRNO = err;
+				goto fail_init;
+			}
+		}
+	}
+
+	if((err = improve_best(ga, ga->cur, 0u)) != 0) {
+		ERRNO = err;
+		goto fail_init;
+	}
+
+	if((err = update_best(ga)) != 0) {
+		ERRNO = err;
+		goto fail_init;
+	}
+	pr_debug("Initial population of %u individuals, best weight %u, %u threads.\n",
+			n, ga_best(ga)->w, pool_threads(&ga->pool));
+	return 0;
+
+fail_init:
+	pr_error("Could not initialize the genetic algorithm. ERRNO=%d\n\n",
+			ERRNO);
+	ga_free(ga);
+	return ERRNO;
+}
+
+
+/**
+ * ga_step - Run a single generation. Returns an error number (!= 0) on
+ * failure.
+ *
+ * @ga: engine.
+ * */
+int ga_step(struct ga *ga)
+{
+	int err;
+
+	prepare_selection(ga);
+	if(ga->params.replacement == GA_STEADY_STATE)
+		err = steady_state_step(ga);
+	else
+		err = generational_step(ga);
+	if(err != 0) {
+		pr_error("Generation %lu has failed. ERRNO=%d\n\n", ga->generation,
+				err);
+		return err;
+	}
+
+	ga->generation++;
+	return update_best(ga);
+}
+
+
+/**
+ * ga_immigrate - Insert a copy of an individual coming from outside of the
+ * engine in place of the worst individual, if it is better. Returns an error
+ * number (!= 0) if there is no memory.
+ *
+ * @ga: engine.
+ * @s: individual to insert.
+ * */
+int ga_immigrate(struct ga *ga, const struct solution *s)
+{
+	struct generation *g = ga->cur;
+	unsigned int worst = worst_individual(g);
+	int err;
+
+	if(s->w >= g->pop[worst].w)
+		return 0;
+	if((err = copy_solution(&g->pop[worst], s, &g->arena[0])) != 0)
+		return err;
+	return update_best(ga);
+}
+
+
+/**
+ * ga_within_gap - Return 1 if the best individual is within the gap of the
+ * lower bound of the parameters, if there is one.
+ *
+ * @ga: engine.
+ * */
+int ga_within_gap(const struct ga *ga)
+{
+	const struct ga_params *p = &ga->params;
+
+	return p->bound && lower_bound_gap(p->bound, ga_best(ga)->w) <=
+		p->max_gap;
+}
+
+
+/**
+ * ga_done - Return 1 if one of the stopping rules holds.
+ *
+ * @ga: engine.
+ * */
+int ga_done(struct ga *ga)
+{
+	const struct ga_params *p = &ga->params;
+
+	if(ga->generation >= p->max_generations) {
+		pr_debug("Stopping: %lu generations.\n", ga->generation);
+		return 1;
+	}
+	if(p->target_w > 0 && ga_best(ga)->w <= p->target_w) {
+		pr_debug("Stopping: the target weight %u was reached.\n",
+				p->target_w);
+		return 1;
+	}
+	if(p->stagnation > 0 &&
+			ga->generation - ga->last_improvement >= p->stagnation) {
+		pr_debug("Stopping: no improvement in %lu generations.\n",
+				p->stagnation);
+		return 1;
+	}
+	if(event_log_ended(p->log, p->island)) {
+		pr_debug("Stopping: the events of the log were replayed.\n");
+		return 1;
+	}
+	if(ga_within_gap(ga)) {
+		pr_debug("Stopping: within %.3f%% of the lower bound %lu.\n",
+				p->max_gap, lower_bound_get(p->bound));
+		return 1;
+	}
+	if(p->time_limit > 0.0 && elapsed(ga) >= p->time_limit) {
+		pr_debug("Stopping: time limit of %.3fs.\n", p->time_limit);
+		return 1;
+	}
+	return 0;
+}
+
+
+/**
+ * ga_run - Run generations until one of the stopping rules holds. Returns an
+ * error number (!= 0) on failure.
+ *
+ * @ga: engine.
+ * */
+int ga_run(struct ga *ga)
+{
+	int err;
+
+	while(!ga_done(ga)) {
+		if((err = ga_step(ga)) != 0)
+			return err;
+	}
+	return 0;
+}
+
+
+/**
+ * ga_free - Free the memory of the engine and its populations.
+ *
+ * @ga: engine.
+ * */
+void ga_free(struct ga *ga)
+{
+	unsigned int t;
+
+	if(ga->ls) {
+		for(t = 0; t < pool_threads(&ga->pool); t++)
+			ls_free(&ga->ls[t]);
+		free(ga->ls);
+	}
+	if(ga->cur)
+		free_generation(ga->cur);
+	if(ga->next)
+		free_generation(ga->next);
+	if(ga->best)
+		free_generation(ga->best);
+	free(ga->rank);
+	free(ga->prob);
+	free(ga->alias);
+	free(ga->improve);
+	free(ga->events);
+	free(ga->scratch);
+	pool_free(&ga->pool);
+	memset(ga, 0, sizeof(*ga));
+}
@@ -0,0 +1,411 @@
+/**
+ * heuristic.c - Constructive heuristics for the Steiner tree problem, which
+ * give a good tree in a fraction of the time of the genetic algorithm, either
+ * as the answer by themselves or as seeds of its initial population.
+ * */
+
+#include <string.h>
+
+#include "include/heuristic.h"
+#include "include/mst.h"
+#include "include/heap.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/* Edge between two Voronoi regions, weighing the path between their
+ * terminals through it */
+struct bridge {
+	unsigned int w;
+	unsigned int u;
+	unsigned int v;
+};
+
+
+/**
+ * cmp_bridge - Order the bridges by weight, and then by their vertexes, so the
+ * tree does not depend on the qsort implementation.
+ * */
+static int cmp_bridge(const void *a, const void *b)
+{
+	const struct bridge *ba = a, *bb = b;
+
+	if(ba->w != bb->w)
+		return ba->w < bb->w ? -1 : 1;
+	if(ba->u != bb->u)
+		return ba->u < bb->u ? -1 : 1;
+	return ba->v < bb->v ? -1 : ba->v > bb->v;
+}
+
+
+/**
+ * find_set - Return the representative of the set of x, halving the path to
+ * it on the way.
+ * */
+static unsigned int find_set(unsigned int *set, unsigned int x)
+{
+	while(set[x] != x) {
+		set[x] = set[set[x]];
+		x = set[x];
+	}
+	return x;
+}
+
+
+/**
+ * relax_from - Relax the edges of the vertex u just popped from the heap of a
+ * Dijkstra, pushing the vertexes whose distance was lowered. When base is
+ * not NULL, they also take the base of u.
+ * */
+static void relax_from(const struct stein *stein, struct heap *heap,
+		unsigned int u, unsigned int *dist, unsigned int *pred,
+		unsigned int *base)
+{
+	const unsigned int *off = NULL, *adj = NULL, *wts = NULL;
+	unsigned int n = stein->n_nodes, v, e, w, d;
+
+	if(stein->layout == ADJ_CSR) {
+		off = csr_off(stein);
+		adj = csr_adj(stein);
+		wts = csr_wts(stein);
+	}
+
+	for(e = off ? off[u] : 0u; e < (off ? off[u + 1] : n); e++) {
+		v = off ? adj[e] : e;
+		w = off ? wts[e] : stein_w(stein, u, v);
+		if(w == W_INF || (d = dist[u] + w) >= dist[v])
+			continue;
+		dist[v] = d;
+		pred[v] = u;
+		if(base)
+			base[v] = base[u];
+		heap_push(heap, v);
+	}
+}
+
+
+/**
+ * voronoi - Split the graph into the Voronoi regions of the terminals with a
+ * Dijkstra from all of them at once: base is the closest terminal of each
+ * vertex, dist the distance to it and pred the previous vertex on the path
+ * from it. The vertexes which can not be reached keep W_INF. It takes
+ * O(E log V). Returns an error number (!= 0) if there is no memory.
+ * */
+static int voronoi(const struct stein *stein, unsigned int *dist,
+		unsigned int *base, unsigned int *pred)
+{
+	struct heap heap;
+	unsigned int n = stein->n_nodes, i, u;
+
+	memset(dist, 0xff, sizeof(*dist) * n);
+	if(heap_init(&heap, n, dist) != 0) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	for(i = 0; i < stein->n_terminals; i++) {
+		u = stein->terminals[i];
+		dist[u] = 0u;
+		base[u] = u;
+		pred[u] = u;
+		heap_push(&heap, u);
+	}
+
+	while(heap.size > 0) {
+		u = heap_pop(&heap);
+		relax_from(stein, &heap, u, dist, pred, base);
+	}
+
+	heap_free(&heap);
+	return 0;
+}
+
+
+/**
+ * find_bridges - Write the edges whose ends lie in two different regions,
+ * each once. Returns their number.
+ * */
+static unsigned int find_bridges(const struct stein *stein,
+		const unsigned int *dist, const unsigned int *base,
+		struct bridge *bridges)
+{
+	const unsigned int *off = NULL, *adj = NULL, *wts = NULL;
+	unsigned int n = stein->n_nodes, k = 0u, u, v, e, w;
+
+	if(stein->layout == ADJ_CSR) {
+		off = csr_off(stein);
+		adj = csr_adj(stein);
+		wts = csr_wts(stein);
+	}
+
+	for(u = 0; u < n; u++) {
+		if(dist[u] == W_INF)
+			continue;
+		for(e = off ? off[u] : u + 1; e < (off ? off[u + 1] : n); e++) {
+			v = off ? adj[e] : e;
+			w = off ? wts[e] : stein_w(stein, u, v);
+			if(v <= u || w == W_INF || base[u] == base[v])
+				continue;
+			bridges[k].w = dist[u] + w + dist[v];
+			bridges[k].u = u;
+			bridges[k].v = v;
+			k++;
+		}
+	}
+	return k;
+}
+
+
+/**
+ * mehlhorn - Build a Steiner tree with Mehlhorn's 2-approximation. The graph
+ * is split into the Voronoi regions of the terminals, and the MST of the
+ * distance network restricted to the edges between two regions is expanded
+ * into the graph. Returns a pointer to the solution, or NULL if there is no
+ * memory or the terminals are not connected. The result only depends on the
+ * graph.
+ *
+ * The MST of the regions is a Kruskal over the sorted bridges, which takes
+ * O(E log E) rather than the O(E + V log V) of the paper, but stays below the
+ * cost of the Voronoi regions on the instances at hand.
+ *
+ * Source: K. Mehlhorn, A faster approximation algorithm for the Steiner
+ * problem in graphs, 1988.
+ *
+ * @stein: stein structure with the graph representation.
+ * @sol: solution where the tree is written, cleared first.
+ * @arena: arena the edges are allocated from.
+ * */
+struct solution *mehlhorn(struct stein *stein, struct solution *sol,
+		struct arena *arena)
+{
+	unsigned int n = stein->n_nodes, i, k, x, a, b, n_bridges, n_joined = 0u;
+	unsigned int *dist, *base, *pred, *set, *region;
+	struct bridge *bridges;
+	unsigned char *mark;
+
+	if(!(dist = malloc(sizeof(*dist) * 5 * (size_t)n)))
+		goto fail_alloc;
+	base = dist + n;
+	pred = base + n;
+	set = pred + n;
+	region = set + n;
+	if(!(mark = calloc(n, 1))) {
+		free(dist);
+		goto fail_alloc;
+	}
+	if(!(bridges = malloc(sizeof(*bridges) * (stein->n_edges + 1)))) {
+		free(mark);
+		free(dist);
+		goto fail_alloc;
+	}
+
+	if(voronoi(stein, dist, base, pred) != 0)
+		goto fail_free;
+	n_bridges = find_bridges(stein, dist, base, bridges);
+	qsort(bridges, n_bridges, sizeof(*bridges), cmp_bridge);
+
+	/* Kruskal over the regions, each known by its terminal; the paths of
+	 * the bridges kept are marked on the way. The terminals are marked
+	 * first, as every path ends at one. */
+	for(i = 0; i < n; i++)
+		region[i] = i;
+	for(i = 0; i < stein->n_terminals; i++)
+		mark[stein->terminals[i]] = 1;
+	for(i = 0, k = 0u; i < n_bridges &&
+			n_joined + 1 < stein->n_terminals; i++) {
+		a = find_set(region, base[bridges[i].u]);
+		b = find_set(region, base[bridges[i].v]);
+		if(a == b)
+			continue;
+		region[a] = b;
+		n_joined++;
+
+		for(x = bridges[i].u; !mark[x]; x = pred[x]) {
+			mark[x] = 1;
+			set[k++] = x;
+		}
+		for(x = bridges[i].v; !mark[x]; x = pred[x]) {
+			mark[x] = 1;
+			set[k++] = x;
+		}
+	}
+	free(bridges);
+	free(mark);
+
+	if(n_joined + 1 < stein->n_terminals) {
+		ERRNO = EDISCONNECTED;
+		pr_debug("The terminals are not connected, the regions were"
+				" joined %u times.\n", n_joined);
+		free(dist);
+		return NULL;
+	}
+	pr_debug("Mehlhorn: %u regions joined by %u bridges, %u Steiner"
+			" vertexes.\n", stein->n_terminals, n_joined, k);
+
+	/* The terminals go last, so the root is a terminal */
+	memcpy(set + k, stein->terminals, sizeof(*set) * stein->n_terminals);
+	sol = retrieve_mst_set(stein, set, k + stein->n_terminals, sol, NULL,
+			arena);
+	free(dist);
+	return sol;
+
+fail_free:
+	free(bridges);
+	free(mark);
+	free(dist);
+fail_alloc:
+	ERRNO = ENOMEM;
+	pr_error("There is no memory left to allocate. ERRNO=%d\n\n", ERRNO);
+	return NULL;
+}
+
+
+/**
+ * shortest_path_heuristic - Build a Steiner tree with the shortest path
+ * heuristic of Takahashi and Matsuyama: from the root, the closest terminal
+ * out of the tree is attached by its shortest path to the tree, until every
+ * terminal is in. The vertexes of the tree are then decoded by
+ * retrieve_mst_set(). Returns a pointer to the solution, or NULL if there is
+ * no memory or the terminals are not connected.
+ *
+ * A single Dijkstra runs from the growing tree: the vertexes of each new path
+ * go back to the heap with a distance of 0, and the distances they lower are
+ * propagated as the Dijkstra goes on.
+ *
+ * Source: H. Takahashi and A. Matsuyama, An approximate solution for the
+ * Steiner problem in graphs, 1980.
+ *
+ * @stein: stein structure with the graph representation.
+ * @root: terminal the tree grows from.
+ * @sol: solution where the tree is written, cleared first.
+ * @arena: arena the edges are allocated from.
+ * */
+struct solution *shortest_path_heuristic(struct stein *stein,
+		unsigned int root, struct solution *sol, struct arena *arena)
+{
+	struct heap heap;
+	unsigned int n = stein->n_nodes, i, k = 0u, u, x, joined = 1u;
+	unsigned int *dist, *pred, *set;
+	unsigned char *state;
+
+	/* Flags of the vertexes */
+	enum { S_TERMINAL = 1, S_TREE = 2 };
+
+	if(!(dist = malloc(sizeof(*dist) * 3 * (size_t)n)))
+		goto fail_alloc;
+	pred = dist + n;
+	set = pred + n;
+	if(!(state = calloc(n, 1))) {
+		free(dist);
+		goto fail_alloc;
+	}
+	memset(dist, 0xff, sizeof(*dist) * n);
+	if(heap_init(&heap, n, dist) != 0) {
+		free(state);
+		free(dist);
+		goto fail_alloc;
+	}
+
+	for(i = 0; i < stein->n_terminals; i++)
+		state[stein->terminals[i]] = S_TERMINAL;
+	state[root] |= S_TREE;
+	dist[root] = 0u;
+	pred[root] = root;
+	heap_push(&heap, root);
+
+	while(joined < stein->n_terminals && heap.size > 0) {
+		u = heap_pop(&heap);
+		if(state[u] != S_TERMINAL) {
+			relax_from(stein, &heap, u, dist, pred, NULL);
+			continue;
+		}
+
+		/* The closest terminal: its path joins the tree and becomes
+		 * a source of the Dijkstra */
+		for(x = u; !(state[x] & S_TREE); x = pred[x]) {
+			if(state[x] != S_TERMINAL)
+				set[k++] = x;
+			state[x] |= S_TREE;
+			dist[x] = 0u;
+			heap_push(&heap, x);
+		}
+		joined++;
+	}
+	heap_free(&heap);
+	free(state);
+
+	if(joined < stein->n_terminals) {
+		ERRNO = EDISCONNECTED;
+		pr_debug("Only %u terminals are connected to %u.\n", joined,
+				root + 1u);
+		free(dist);
+		return NULL;
+	}
+
+	/* The terminals go last, so the root is a terminal */
+	memcpy(set + k, stein->terminals, sizeof(*set) * stein->n_terminals);
+	sol = retrieve_mst_set(stein, set, k + stein->n_terminals, sol, NULL,
+			arena);
+	free(dist);
+	return sol;
+
+fail_alloc:
+	ERRNO = ENOMEM;
+	pr_error("There is no memory left to allocate. ERRNO=%d\n\n", ERRNO);
+	return NULL;
+}
+
+
+/* Arguments of the parallel loop of the multi-root heuristic */
+struct sph_task {
+	struct stein *stein;
+	struct solution *sols;
+	unsigned int n;
+	struct arena *arenas;
+
+	/* Set by a root whose tree could not be built */
+	int failed;
+};
+
+
+/**
+ * sph_root - Build the tree of the i-th root, the roots being spread evenly
+ * over the terminals.
+ * */
+static void sph_root(void *arg, unsigned int i, unsigned int thread)
+{
+	struct sph_task *task = arg;
+	struct stein *stein = task->stein;
+	unsigned int root = stein->terminals[(unsigned long)i *
+		stein->n_terminals / task->n];
+
+	init_solution(&task->sols[i]);
+	if(!shortest_path_heuristic(stein, root, &task->sols[i],
+				&task->arenas[thread]))
+		__atomic_store_n(&task->failed, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * multi_root_sph - Run the shortest path heuristic from n roots spread evenly
+ * over the terminals, in parallel, writing the tree of the i-th root in
+ * sols[i]. Returns an error number (!= 0) if a tree could not be built.
+ *
+ * @stein: stein structure with the graph representation.
+ * @sols: n solutions where the trees are written.
+ * @n: number of roots, not above the number of terminals.
+ * @arenas: arena of each thread of the pool, the edges of the trees built by
+ * the thread t are allocated from arenas[t].
+ * @pool: threads to work with, or NULL.
+ * */
+int multi_root_sph(struct stein *stein, struct solution *sols,
+		unsigned int n, struct arena *arenas, struct pool *pool)
+{
+	struct sph_task task = {stein, sols, n, arenas, 0};
+
+	pool_run(pool, sph_root, &task, n);
+	if(task.failed) {
+		ERRNO = EUNEXPECTED_ERROR;
+		return ERRNO;
+	}
+	return 0;
+}
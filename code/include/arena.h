@@ -0,0 +1,81 @@
+/**
+ * arena.h - Region allocator for the many small objects of a population,
+ * such as the solution edges.
+ *
+ * The memory is taken from large chunks by bumping a pointer, and there is no
+ * way to free a single object: the whole arena is reset at once, keeping its
+ * chunks for the next use, or destroyed.
+ * */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+
+#include <stddef.h>
+
+#include "list.h"
+
+
+/* Default size of the chunks */
+#ifndef ARENA_CHUNK_SIZE
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#endif
+
+/* Alignment of every object */
+#define ARENA_ALIGN 16
+
+
+struct arena {
+	/* List of struct arena_chunk, the ones in use first */
+	struct list_head chunks;
+
+	/* Chunk where the next object is taken from, or NULL before the
+	 * first allocation */
+	struct arena_chunk *cur;
+
+	/* Bytes used in the current chunk */
+	size_t used;
+
+	/* Size of the chunks allocated for the ordinary objects */
+	size_t chunk_size;
+};
+
+
+/**
+ * arena_init - Initialize an empty arena. No memory is allocated until the
+ * first object is.
+ *
+ * @a: arena to initialize.
+ * @chunk_size: size of the chunks, or 0 for ARENA_CHUNK_SIZE.
+ * */
+void arena_init(struct arena *a, size_t chunk_size);
+
+
+/**
+ * arena_alloc - Allocate an object aligned to ARENA_ALIGN, returning NULL if
+ * there is no memory left.
+ *
+ * @a: arena to take the object from.
+ * @size: size of the object.
+ * */
+void *arena_alloc(struct arena *a, size_t size);
+
+
+/**
+ * arena_reset - Release every object of the arena at once. The chunks are
+ * kept, so the next objects take no new memory from the system.
+ *
+ * @a: arena to reset.
+ * */
+void arena_reset(struct arena *a);
+
+
+/**
+ * arena_destroy - Free every chunk of the arena.
+ *
+ * @a: arena to destroy.
+ * */
+void arena_destroy(struct arena *a);
+
+
+#endif /* _ARENA_H_ */
@@ -0,0 +1,95 @@
+/**
+ * bin_file.h
+ *
+ * Binary instance format. The file is a header followed by the adjacency
+ * matrix cells, exactly as they are kept in memory, and the terminals array,
+ * so a whole instance is loaded with a single mmap.
+ *
+ * */
+
+
+#ifndef _BIN_FILE_H_
+#define _BIN_FILE_H_
+
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "types.h"
+
+
+#define STEIN_BIN_MAGIC "STEINBIN"
+#define STEIN_BIN_VERSION 1u
+
+/* Written as is, to detect a file created by a machine of other byte order */
+#define STEIN_BIN_BYTE_ORDER 0x01020304u
+
+/* Offset of the matrix in the file, keeping it page aligned in the mapping */
+#define STEIN_BIN_ALIGN 4096u
+
+/* Suffix added to the instance file name to get its cache file name */
+#define STEIN_BIN_SUFFIX ".bin"
+
+
+struct stein_bin_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	uint32_t n_nodes;
+	uint32_t n_edges;
+	uint32_t n_terminals;
+
+	/* enum adj_layout and the size in bytes of a matrix cell */
+	uint32_t layout;
+	uint32_t w_size;
+	uint32_t reserved;
+
+	/* Modification time and size of the text file the binary was created
+	 * from, used to tell whether a cache is stale. */
+	int64_t src_mtime;
+	int64_t src_mtime_nsec;
+	uint64_t src_size;
+
+	/* Position and size in bytes of the matrix and the terminals */
+	uint64_t adj_offset;
+	uint64_t adj_bytes;
+	uint64_t terminals_offset;
+};
+
+
+/**
+ * is_stein_bin - Check whether a mapped file starts with the binary format
+ * magic.
+ *
+ * @map: mapped file.
+ * @size: size of the mapping.
+ * */
+int is_stein_bin(const void *map, size_t size);
+
+
+/**
+ * get_stein_from_bin - Set the stein structure from a mapped binary file. The
+ * mapping is kept as the matrix memory, thus it is owned by the stein structure
+ * on success and unmapped otherwise.
+ *
+ * @map: file mapped with MAP_PRIVATE.
+ * @size: size of the mapping.
+ * @src: status of the text file the binary must have been created from, or
+ * NULL to accept the binary whatever its source is.
+ * */
+struct stein *get_stein_from_bin(void *map, size_t size, const struct stat *src);
+
+
+/**
+ * put_stein_to_bin - Write the current stein structure to a binary file. The
+ * file is written under a temporary name and renamed, thus a concurrent
+ * reader never sees it half written.
+ *
+ * @filename: path of the binary file.
+ * @src: status of the text file the stein structure was read from, or NULL.
+ * */
+int put_stein_to_bin(const char *filename, const struct stat *src);
+
+
+#endif /* _BIN_FILE_H_ */
@@ -0,0 +1,174 @@
+/**
+ * bound.h - Lower bound on the weight of the Steiner trees, by the dual ascent
+ * of Wong over the bidirected cut formulation: a tree is an arborescence from
+ * a root terminal, which every cut separating the root from a terminal is
+ * entered by. The ascent raises the dual variables of such cuts, lowering the
+ * reduced costs of the arcs entering them, until every terminal is joined to
+ * the root by arcs of reduced cost 0. The sum of the dual variables is a lower
+ * bound, and the reduced costs give the reduced cost test, see
+ * dual_ascent_test().
+ *
+ * The cuts of a terminal are grown one arc at a time, which amounts to a
+ * Dijkstra towards the terminal with the reduced costs: the cut of the
+ * terminal grows until it would hold the root, the ascent then goes on with
+ * the next terminal on the reduced costs left.
+ *
+ * Source: R. T. Wong, A dual ascent approach for Steiner tree problems on a
+ * directed graph, 1984.
+ * */
+
+#ifndef _BOUND_H_
+#define _BOUND_H_
+
+
+#include <pthread.h>
+
+#include "types.h"
+#include "heap.h"
+
+
+/* Roots the lower bound is computed from, the best bound is kept */
+#ifndef BOUND_ROOTS
+#define BOUND_ROOTS 8
+#endif
+
+
+struct dual_ascent {
+	unsigned int n;
+
+	/* Arcs entering each vertex v: (tail[a], v) for a from off[v] to
+	 * off[v + 1] - 1, with the position of the reverse arc, the weight
+	 * and the reduced cost */
+	unsigned int *off;
+	unsigned int *tail;
+	unsigned int *rev;
+	unsigned int *w;
+	unsigned int *rc;
+
+	/* Root and bound of the last ascent */
+	unsigned int root;
+	unsigned long lb;
+
+	/* Dijkstras, and the vertexes each cut holds */
+	unsigned int *dist;
+	unsigned int *dist_t;
+	unsigned int *cut;
+	unsigned char *in_cut;
+	struct heap heap;
+};
+
+
+/* Lower bound computed by a thread of its own, while the trees are searched */
+struct lower_bound {
+	struct stein *stein;
+	pthread_t thread;
+	int running;
+	int stop;
+
+	/* Best bound so far, updated by the thread */
+	unsigned long lb;
+
+	/* Weight left out of the instance and added to its trees, such as the
+	 * weight of the edges fixed by the reductions */
+	unsigned long offset;
+};
+
+
+/**
+ * dual_ascent_init - Build the arcs of the instance for the dual ascent.
+ * Returns an error number (!= 0) if there is no memory.
+ *
+ * @da: dual ascent to initialize.
+ * @stein: stein structure with the graph representation.
+ * */
+int dual_ascent_init(struct dual_ascent *da, const struct stein *stein);
+
+
+/**
+ * dual_ascent - Compute the lower bound and the reduced costs of the arcs from
+ * the root, in da->lb and da->rc. If *stop becomes set, the ascent stops with
+ * the bound of the terminals done so far, which is still valid. Returns an
+ * error number (!= 0) if a terminal can not be reached from the root.
+ *
+ * @da: dual ascent.
+ * @stein: stein structure with the graph representation.
+ * @root: terminal the arborescences grow from.
+ * @stop: flag set by another thread to stop the ascent, or NULL.
+ * */
+int dual_ascent(struct dual_ascent *da, const struct stein *stein,
+		unsigned int root, const int *stop);
+
+
+/**
+ * dual_ascent_test - Mark the arcs of the edges in no tree of weight ub or
+ * less, after dual_ascent(): a tree holding the arc (u, v) weighs at least the
+ * bound, plus the reduced cost of the arc and of the paths from the root to u
+ * and from v to a terminal. An edge is marked when both of its arcs are. The
+ * marks are added to cut, so that the tests from several roots add up.
+ * Returns the number of edges newly marked.
+ *
+ * @da: dual ascent.
+ * @stein: stein structure with the graph representation.
+ * @ub: weight of a known tree.
+ * @cut: one flag per arc, set for the arcs of the edges to remove.
+ * */
+unsigned int dual_ascent_test(struct dual_ascent *da,
+		const struct stein *stein, unsigned long ub, unsigned char *cut);
+
+
+/**
+ * dual_ascent_free - Release the memory of the dual ascent.
+ *
+ * @da: dual ascent.
+ * */
+void dual_ascent_free(struct dual_ascent *da);
+
+
+/**
+ * lower_bound_start - Start the thread computing the lower bound of the
+ * instance by dual ascents from up to BOUND_ROOTS roots. Returns an error
+ * number (!= 0) if the thread could not be created.
+ *
+ * @b: lower bound.
+ * @stein: stein structure with the graph representation, which must not
+ * change until lower_bound_stop().
+ * @lb: lower bound already known, or 0.
+ * @offset: weight added to the trees of the instance and to the bound.
+ * */
+int lower_bound_start(struct lower_bound *b, struct stein *stein,
+		unsigned long lb, unsigned long offset);
+
+
+/**
+ * lower_bound_stop - Stop the thread and wait for it. The ascent from the
+ * first root is finished first, so that there is a bound to report.
+ *
+ * @b: lower bound.
+ * */
+void lower_bound_stop(struct lower_bound *b);
+
+
+/**
+ * lower_bound_get - Return the best lower bound found so far on the trees of
+ * the instance, the offset included.
+ *
+ * @b: lower bound.
+ * */
+static inline unsigned long lower_bound_get(const struct lower_bound *b)
+{
+	return __atomic_load_n(&b->lb, __ATOMIC_RELAXED) + b->offset;
+}
+
+
+/**
+ * lower_bound_gap - Return how far above the lower bound a tree of the
+ * instance is, in percent of the bound, the offset included: an optimal tree
+ * is at most this much lighter.
+ *
+ * @b: lower bound.
+ * @w: weight of the tree, without the offset.
+ * */
+double lower_bound_gap(const struct lower_bound *b, unsigned long w);
+
+
+#endif /* _BOUND_H_ */
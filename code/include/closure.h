@@ -0,0 +1,177 @@
+/**
+ * closure.h - Metric closure of the graph: the shortest path distance between
+ * every pair of vertexes, with a predecessor table to expand the paths.
+ *
+ * The distances are kept in the row-major layout of ADJ_FULL, so the rows
+ * feed the same vector kernels as the adjacency matrix rows, see simd.h.
+ * Dense graphs are closed with a blocked Floyd-Warshall, whose blocks are
+ * relaxed in parallel, and ADJ_CSR graphs with a Dijkstra from every vertex,
+ * one source per thread at a time. Both take O(V^2) memory, so the closure is
+ * only computed on demand, see the --closure option: the search then runs on
+ * the closure in place of the graph, see closure_apply(), and the edges of the
+ * tree found are expanded back into paths of the graph, see closure_expand().
+ * */
+
+#ifndef _CLOSURE_H_
+#define _CLOSURE_H_
+
+
+#include <stdint.h>
+
+#include "types.h"
+#include "pool.h"
+
+
+/* Side of the square blocks of the Floyd-Warshall, in vertexes */
+#ifndef CLOSURE_BLOCK
+#define CLOSURE_BLOCK 64
+#endif
+
+/* Predecessor of the vertexes which can not be reached */
+#define CLOSURE_NONE UINT_MAX
+
+struct closure {
+	unsigned int n;
+
+	/* Distance from u to v at u * n + v, W_INF if v can not be reached */
+	unsigned int *dist;
+	size_t dist_size;
+
+	/* Vertex before v on the path from u, at u * n + v, as unsigned int
+	 * or, when every vertex fits, as uint16_t: pred_w is the size of a
+	 * cell */
+	void *pred;
+	size_t pred_size;
+	size_t pred_w;
+
+	/* Graph the closure stands for, while it is applied */
+	struct stein graph;
+	int applied;
+};
+
+
+/**
+ * closure_init - Compute the metric closure of the graph. Returns an error
+ * number (!= 0) if there is no memory.
+ *
+ * @c: closure to fill.
+ * @stein: stein structure with the graph representation.
+ * @pool: threads to work with, or NULL.
+ * */
+int closure_init(struct closure *c, const struct stein *stein,
+		struct pool *pool);
+
+
+/**
+ * closure_dist - Return the length of the shortest path from u to v, or W_INF
+ * if there is none.
+ *
+ * @c: closure.
+ * @u: source vertex.
+ * @v: destination vertex.
+ * */
+static inline unsigned int closure_dist(const struct closure *c,
+		unsigned int u, unsigned int v)
+{
+	return c->dist[(size_t)u * c->n + v];
+}
+
+
+/**
+ * closure_row - Return the distances from u to every vertex.
+ *
+ * @c: closure.
+ * @u: source vertex.
+ * */
+static inline const unsigned int *closure_row(const struct closure *c,
+		unsigned int u)
+{
+	return c->dist + (size_t)u * c->n;
+}
+
+
+/**
+ * closure_pred - Return the vertex before v on the shortest path from u, u
+ * itself if v is u, or CLOSURE_NONE if v can not be reached.
+ *
+ * @c: closure.
+ * @u: source vertex.
+ * @v: destination vertex.
+ * */
+static inline unsigned int closure_pred(const struct closure *c,
+		unsigned int u, unsigned int v)
+{
+	size_t i = (size_t)u * c->n + v;
+
+	if(c->pred_w == sizeof(uint16_t)) {
+		uint16_t p = ((const uint16_t *)c->pred)[i];
+		return p == UINT16_MAX ? CLOSURE_NONE : p;
+	}
+	return ((const unsigned int *)c->pred)[i];
+}
+
+
+/**
+ * closure_path - Write the vertexes of the shortest path from u to v, both
+ * included, from v back to u. Returns their number, or 0 if v can not be
+ * reached. path must have room for the number of vertexes.
+ *
+ * @c: closure.
+ * @u: source vertex.
+ * @v: destination vertex.
+ * @path: vertexes of the path.
+ * */
+unsigned int closure_path(const struct closure *c, unsigned int u,
+		unsigned int v, unsigned int *path);
+
+
+/**
+ * closure_expand - Build the tree given by edges of the closure: each edge is
+ * replaced by its shortest path in the graph, and the MST of the vertexes on
+ * the paths is pruned down to a Steiner tree, see retrieve_mst_set(). Returns
+ * an error number (!= 0) if there is no memory or if the edges do not connect
+ * the terminals.
+ *
+ * @stein: stein structure with the graph representation.
+ * @c: closure of the graph.
+ * @edges: pairs of vertexes, edges of the closure.
+ * @n_edges: number of edges.
+ * @sol: solution where the tree is written.
+ * @arena: arena the edges of the tree are allocated from.
+ * */
+int closure_expand(struct stein *stein, const struct closure *c,
+		const unsigned int (*edges)[2], unsigned int n_edges,
+		struct solution *sol, struct arena *arena);
+
+
+/**
+ * closure_apply - Make the closure the graph of stein, as a complete graph in
+ * the ADJ_FULL layout whose edges weigh the distances, until
+ * closure_restore(). The distance from a vertex to itself becomes W_INF, as
+ * there is no loop in the graph.
+ *
+ * @c: closure of the graph of stein.
+ * @stein: stein structure with the graph representation.
+ * */
+void closure_apply(struct closure *c, struct stein *stein);
+
+
+/**
+ * closure_restore - Give stein its own graph back, if the closure was
+ * applied, see closure_apply().
+ *
+ * @c: closure.
+ * @stein: stein structure the closure was applied to.
+ * */
+void closure_restore(struct closure *c, struct stein *stein);
+
+
+/**
+ * closure_free - Release the memory of the closure.
+ *
+ * @c: closure.
+ * */
+void closure_free(struct closure *c);
+
+
+#endif /* _CLOSURE_H_ */
@@ -17,6 +17,8 @@
 #define ENOMEM 105;
 #endif
 #define EUNEXPECTED_ERROR 106;
+#define EDISCONNECTED 107;
+#define EINVALID_ARGUMENT 108;
 
 
 
@@ -40,7 +42,12 @@
 		} \
 	} while(0)
 
-static int ERRNO = 0;
+/**
+ * The error number of the calling thread, defined once in types.c. Every
+ * module sets the same variable, so main() sees the errors of the functions
+ * it calls, and the threads of the pool do not race on it.
+ * */
+extern __thread int ERRNO;
 
 
 #endif
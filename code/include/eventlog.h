@@ -0,0 +1,166 @@
+/**
+ * eventlog.h - Binary log of the decisions of the genetic algorithm, to tell
+ * whether a run is reproduced exactly.
+ *
+ * The file is a header, with the seed and the parameters of the run, followed
+ * by an event per child bred: the parents drawn by the selection, the weight
+ * the crossover gave it, the number of mutations it went through and its
+ * final weight. A replay runs again from the header, checking every event
+ * against the log, and stops at the first one which differs.
+ *
+ * The random draws of a run only depend on its seed, see rng_derive(), so the
+ * events do not depend on the number of threads. What depends on the timing
+ * is when the run stops: the time limit, the gap to the lower bound, and an
+ * island reaching the target weight, which stops the other ones wherever they
+ * are. So the replay of an engine, or of an island, stops where its events
+ * end, see event_log_ended().
+ * */
+
+#ifndef _EVENTLOG_H_
+#define _EVENTLOG_H_
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+
+#define EVENT_LOG_MAGIC "STEINLOG"
+#define EVENT_LOG_VERSION 4u
+
+/* Written as is, to detect a file created by a machine of other byte order */
+#define EVENT_LOG_BYTE_ORDER 0x01020304u
+
+
+struct event_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	/* Seed of the run, the root of the seeding tree */
+	uint64_t seed;
+
+	/* Instance the run was made on, as read from the file and before
+	 * the reductions, which reduced tells whether they ran */
+	uint32_t n_nodes;
+	uint32_t n_edges;
+	uint32_t n_terminals;
+	uint32_t reduced;
+
+	/* Parameters the events depend on, the timed stopping rules aside */
+	uint64_t max_generations;
+	uint64_t stagnation;
+	uint64_t interval;
+	double crossover_rate;
+	uint32_t target_w;
+	uint32_t pop_size;
+	uint32_t mutation_rate;
+	uint32_t crossover;
+	uint32_t selection;
+	uint32_t tournament_size;
+	uint32_t replacement;
+	uint32_t elitism;
+	uint32_t local_search;
+	uint32_t ls_count;
+	uint32_t n_islands;
+	uint32_t n_migrants;
+	uint32_t topology;
+	uint32_t closure;
+	uint32_t sph_roots;
+	uint32_t reserved;
+};
+
+struct event {
+	uint32_t island;
+	uint32_t generation;
+	uint32_t child;
+
+	/* Parents drawn by the selection */
+	uint32_t p1;
+	uint32_t p2;
+
+	/* Weight after the crossover, mutations, and final weight */
+	uint32_t cross_w;
+	uint32_t n_mutations;
+	uint32_t w;
+};
+
+struct event_log {
+	/* Log being written, or NULL when replaying */
+	FILE *file;
+
+	/* The islands record their events concurrently */
+	pthread_mutex_t lock;
+
+	/* Events of the log being replayed, by island and then in their
+	 * order, with the next one of each island */
+	struct event *events;
+	size_t n_events;
+	size_t *next;
+	size_t *end;
+	unsigned int n_islands;
+
+	/* Events checked by the replay, and set at the first one differing */
+	unsigned long n_checked;
+	int diverged;
+};
+
+
+/**
+ * event_log_create - Create the log file and write its header. Returns an
+ * error number (!= 0) if the file could not be written.
+ *
+ * @log: log to initialize.
+ * @path: file to create.
+ * @h: header, whose magic, version and byte order are filled.
+ * */
+int event_log_create(struct event_log *log, const char *path,
+		struct event_header *h);
+
+
+/**
+ * event_log_replay - Read a log to replay, and its header. Returns an error
+ * number (!= 0) if the file could not be read or is not a log.
+ *
+ * @log: log to initialize.
+ * @path: file to read.
+ * @h: header read.
+ * */
+int event_log_replay(struct event_log *log, const char *path,
+		struct event_header *h);
+
+
+/**
+ * event_log_record - Write the events to the log, or when replaying, check
+ * them against the next events of their island. Returns an error number
+ * (!= 0) if the file could not be written, or the events differ from the
+ * ones replayed.
+ *
+ * @log: log.
+ * @events: events of consecutive children of an island.
+ * @n: number of events.
+ * */
+int event_log_record(struct event_log *log, const struct event *events,
+		unsigned int n);
+
+
+/**
+ * event_log_ended - Return 1 if the events of the island were all replayed.
+ *
+ * @log: log, or NULL.
+ * @island: island.
+ * */
+int event_log_ended(struct event_log *log, unsigned int island);
+
+
+/**
+ * event_log_close - Close the log and release its memory. Returns an error
+ * number (!= 0) if the file could not be written, or when replaying, if
+ * events of the log were never met.
+ *
+ * @log: log.
+ * */
+int event_log_close(struct event_log *log);
+
+
+#endif /* _EVENTLOG_H_ */
@@ -20,10 +20,14 @@
 
 /**
  * get_stein_from_file - Retrieve the data from the given file and returns the stein structure
- * associated with the extracted data.
+ * associated with the extracted data. The file may be in the text format or in
+ * the binary format of bin_file.h.
  * @filename: path to the file from where to retrieve the data.
+ * @use_cache: when set, a text file is loaded from its binary cache
+ * (filename + STEIN_BIN_SUFFIX) if the cache is up to date, and the cache is
+ * written otherwise.
  * */
-struct stein *get_stein_from_file(char *filename);
+struct stein *get_stein_from_file(char *filename, int use_cache);
 
 
 
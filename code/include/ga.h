@@ -0,0 +1,288 @@
+/**
+ * ga.h - Generation engine of the genetic algorithm: selection of the parents,
+ * reproduction and replacement, until one of the stopping rules holds.
+ * */
+
+#ifndef _GA_H_
+#define _GA_H_
+
+
+#include <time.h>
+
+#include "types.h"
+#include "population.h"
+#include "pool.h"
+#include "localsearch.h"
+#include "bound.h"
+#include "rng.h"
+#include "eventlog.h"
+#include "heuristic.h"
+
+
+/* The default size for a population */
+#ifndef POP_SIZE
+#define POP_SIZE 10
+#endif
+
+/* Every edge of a new individual mutates with probability 1 / MUTATION_RATE */
+#ifndef MUTATION_RATE
+#define MUTATION_RATE 16
+#endif
+
+/* Probability that a child is bred by the crossover, rather than copied from
+ * its first parent */
+#ifndef GA_CROSSOVER_RATE
+#define GA_CROSSOVER_RATE 1.0
+#endif
+
+/* Individuals drawn by each tournament */
+#ifndef GA_TOURNAMENT_SIZE
+#define GA_TOURNAMENT_SIZE 2
+#endif
+
+/* Best individuals copied unchanged to the next generation */
+#ifndef GA_ELITISM
+#define GA_ELITISM 1
+#endif
+
+/* Default generation budget */
+#ifndef GA_GENERATIONS
+#define GA_GENERATIONS 1000
+#endif
+
+/* Threads breeding the children, 0 for one per online CPU */
+#ifndef GA_THREADS
+#define GA_THREADS 0
+#endif
+
+/* Gap to the lower bound, in percent, at which the run stops */
+#ifndef GA_MAX_GAP
+#define GA_MAX_GAP 0.0
+#endif
+
+/* Best children of each generation improved by the local search */
+#ifndef GA_LS_COUNT
+#define GA_LS_COUNT 1
+#endif
+
+
+enum ga_selection {
+	/* The best of GA_TOURNAMENT_SIZE random individuals */
+	GA_TOURNAMENT,
+	/* Probability proportional to 1 / (1 + w) */
+	GA_ROULETTE,
+	/* Probability proportional to the position from the worst */
+	GA_RANK
+};
+
+enum ga_replacement {
+	/* The children replace the whole population, but the elite */
+	GA_GENERATIONAL,
+	/* Each child replaces the worst individual, if it is better */
+	GA_STEADY_STATE
+};
+
+
+struct ga_params {
+	/* Number of individuals */
+	unsigned int pop_size;
+
+	/* Every edge of a child mutates with probability 1 / mutation_rate */
+	unsigned int mutation_rate;
+
+	/* Each child is bred by the crossover with probability
+	 * crossover_rate, and is a copy of its first parent otherwise */
+	enum crossover_scheme crossover;
+	double crossover_rate;
+
+	enum ga_selection selection;
+	unsigned int tournament_size;
+
+	enum ga_replacement replacement;
+
+	/* Individuals kept by the generational replacement */
+	unsigned int elitism;
+
+	/* Stopping rules: the generation budget, and when not 0, the time
+	 * limit in seconds, the generations without improvement and the
+	 * weight to reach. */
+	unsigned long max_generations;
+	double time_limit;
+	unsigned long stagnation;
+	unsigned int target_w;
+
+	/* With a lower bound, the run also stops once the best tree is within
+	 * max_gap percent of it, or proven optimal for 0 */
+	const struct lower_bound *bound;
+	double max_gap;
+
+	/* Threads breeding the children, the calling one included, or 0 for
+	 * one per online CPU */
+	unsigned int n_threads;
+
+	/* Memetic step: the ls_count best children of each generation, and
+	 * the best individuals of the initial population, are improved by
+	 * the local search */
+	enum ls_mode local_search;
+	unsigned int ls_count;
+
+	/* Roots the shortest path heuristic seeding the population is run
+	 * from, up to one per terminal, see create_initial_population() */
+	unsigned int sph_roots;
+
+	/* Seed of the run: every draw of the engine derives from it, see
+	 * rng_derive(), so that the run does not depend on the threads */
+	uint64_t seed;
+
+	/* Log the decisions are recorded to, or checked against when it is
+	 * replayed, or NULL, with the island the engine runs on */
+	struct event_log *log;
+	unsigned int island;
+};
+
+
+/* Position of an individual when the population is ranked */
+struct ga_rank {
+	unsigned int w;
+	unsigned int i;
+};
+
+struct ga {
+	struct stein *stein;
+	struct ga_params params;
+
+	/* Threads breeding the children */
+	struct pool pool;
+
+	/* Current population, and the one where the children are written */
+	struct generation *cur;
+	struct generation *next;
+
+	/* Best individual found so far, in a generation of its own */
+	struct generation *best;
+
+	/* Population sorted from the best to the worst */
+	struct ga_rank *rank;
+
+	/* Alias table of the roulette and rank selections */
+	double *prob;
+	unsigned int *alias;
+
+	/* Positions of the individuals improved by the local search */
+	unsigned int *improve;
+
+	/* Generator of the seeds of the generations, and the seed of the
+	 * current one, which each child derives its own stream from */
+	struct rng rng;
+	uint64_t gen_seed;
+
+	/* Decisions which bred each child of the current generation */
+	struct event *events;
+
+	/* Scratch of the mutations and crossovers of each thread, see
+	 * population_scratch() */
+	unsigned int *scratch;
+
+	/* State of the local search of each thread, if there is one */
+	struct ls *ls;
+
+	unsigned long generation;
+	unsigned long last_improvement;
+	struct timespec start;
+};
+
+
+/**
+ * ga_default_params - Fill the parameters with the compile time defaults.
+ *
+ * @params: parameters to fill.
+ * */
+void ga_default_params(struct ga_params *params);
+
+
+/**
+ * ga_check_params - Validate the parameters of a run. Returns an error number
+ * (!= 0) if any of them is out of range.
+ *
+ * @params: parameters to check.
+ * */
+int ga_check_params(const struct ga_params *params);
+
+
+/**
+ * ga_init - Validate the parameters and create the initial population.
+ * Returns an error number (!= 0) on failure.
+ *
+ * @ga: engine to initialize.
+ * @stein: stein structure with the graph representation.
+ * @params: parameters of the run.
+ * */
+int ga_init(struct ga *ga, struct stein *stein, const struct ga_params *params);
+
+
+/**
+ * ga_step - Run a single generation. Returns an error number (!= 0) on
+ * failure.
+ *
+ * @ga: engine.
+ * */
+int ga_step(struct ga *ga);
+
+
+/**
+ * ga_immigrate - Insert a copy of an individual coming from outside of the
+ * engine in place of the worst individual, if it is better. Returns an error
+ * number (!= 0) if there is no memory.
+ *
+ * @ga: engine.
+ * @s: individual to insert.
+ * */
+int ga_immigrate(struct ga *ga, const struct solution *s);
+
+
+/**
+ * ga_within_gap - Return 1 if the best individual is within the gap of the
+ * lower bound of the parameters, if there is one.
+ *
+ * @ga: engine.
+ * */
+int ga_within_gap(const struct ga *ga);
+
+
+/**
+ * ga_done - Return 1 if one of the stopping rules holds.
+ *
+ * @ga: engine.
+ * */
+int ga_done(struct ga *ga);
+
+
+/**
+ * ga_run - Run generations until one of the stopping rules holds. Returns an
+ * error number (!= 0) on failure.
+ *
+ * @ga: engine.
+ * */
+int ga_run(struct ga *ga);
+
+
+/**
+ * ga_best - Return the best individual found so far.
+ *
+ * @ga: engine.
+ * */
+static inline const struct solution *ga_best(const struct ga *ga)
+{
+	return &ga->best->pop[0];
+}
+
+
+/**
+ * ga_free - Free the memory of the engine and its populations.
+ *
+ * @ga: engine.
+ * */
+void ga_free(struct ga *ga);
+
+
+#endif /* _GA_H_ */
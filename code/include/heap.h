@@ -0,0 +1,156 @@
+/**
+ * heap.h - Indexed binary min-heap of vertexes, for the Prim and Dijkstra
+ * implementations over sparse graphs.
+ *
+ * The keys live in an array owned by the caller, indexed by vertex. A vertex
+ * whose key was lowered is moved up with heap_push(), which also inserts it if
+ * it is not yet in the heap.
+ * */
+
+#ifndef _HEAP_H_
+#define _HEAP_H_
+
+
+#include <stdlib.h>
+#include <limits.h>
+
+
+#define HEAP_NONE UINT_MAX
+
+struct heap {
+	/* Number of vertexes in the heap */
+	unsigned int size;
+
+	/* Heap array of vertexes */
+	unsigned int *v;
+
+	/* Position of each vertex in the heap array, or HEAP_NONE */
+	unsigned int *pos;
+
+	/* Keys of the vertexes */
+	const unsigned int *key;
+};
+
+
+/**
+ * heap_init_at - Initialize an empty heap for the vertexes 0 to n - 1 in mem,
+ * 2 * n words owned by the caller, which must not call heap_free().
+ *
+ * @h: heap to initialize.
+ * @n: number of vertexes.
+ * @key: keys of the vertexes.
+ * @mem: memory of the heap.
+ * */
+static inline void heap_init_at(struct heap *h, unsigned int n,
+		const unsigned int *key, unsigned int *mem)
+{
+	unsigned int i;
+
+	h->size = 0;
+	h->key = key;
+	h->v = mem;
+	h->pos = h->v + n;
+	for(i = 0; i < n; i++)
+		h->pos[i] = HEAP_NONE;
+}
+
+
+/**
+ * heap_init - Allocate an empty heap for the vertexes 0 to n - 1. Returns
+ * an error number (!= 0) if there is no memory.
+ *
+ * @h: heap to initialize.
+ * @n: number of vertexes.
+ * @key: keys of the vertexes.
+ * */
+static inline int heap_init(struct heap *h, unsigned int n,
+		const unsigned int *key)
+{
+	unsigned int *mem;
+
+	if(!(mem = malloc(sizeof(*mem) * 2 * (size_t)n)))
+		return 1;
+	heap_init_at(h, n, key, mem);
+	return 0;
+}
+
+
+/**
+ * heap_free - Free the memory allocated by heap_init.
+ * */
+static inline void heap_free(struct heap *h)
+{
+	free(h->v);
+}
+
+
+static inline void __heap_set(struct heap *h, unsigned int i, unsigned int v)
+{
+	h->v[i] = v;
+	h->pos[v] = i;
+}
+
+
+/**
+ * heap_push - Insert the vertex, or move it up after its key was lowered.
+ * */
+static inline void heap_push(struct heap *h, unsigned int v)
+{
+	unsigned int i = h->pos[v];
+
+	if(i == HEAP_NONE)
+		i = h->size++;
+
+	while(i > 0) {
+		unsigned int parent = (i - 1) / 2;
+
+		if(h->key[h->v[parent]] <= h->key[v])
+			break;
+		__heap_set(h, i, h->v[parent]);
+		i = parent;
+	}
+	__heap_set(h, i, v);
+}
+
+
+/**
+ * heap_pop - Remove and return the vertex with the minimum key. The heap must
+ * not be empty.
+ * */
+static inline unsigned int heap_pop(struct heap *h)
+{
+	unsigned int top = h->v[0], last, i = 0;
+
+	h->pos[top] = HEAP_NONE;
+	if(--h->size == 0)
+		return top;
+
+	last = h->v[h->size];
+	for(;;) {
+		unsigned int c = 2 * i + 1;
+
+		if(c >= h->size)
+			break;
+		if(c + 1 < h->size && h->key[h->v[c + 1]] < h->key[h->v[c]])
+			c++;
+		if(h->key[last] <= h->key[h->v[c]])
+			break;
+		__heap_set(h, i, h->v[c]);
+		i = c;
+	}
+	__heap_set(h, i, last);
+	return top;
+}
+
+
+/**
+ * heap_clear - Empty the heap without ordering what is left in it.
+ * */
+static inline void heap_clear(struct heap *h)
+{
+	while(h->size > 0)
+		h->pos[h->v[--h->size]] = HEAP_NONE;
+}
+
+
+#endif /* _HEAP_H_ */
@@ -0,0 +1,77 @@
+/**
+ * heuristic.h - Constructive heuristics for the Steiner tree problem, which
+ * give a good tree in a fraction of the time of the genetic algorithm, either
+ * as the answer by themselves or as seeds of its initial population.
+ * */
+
+#ifndef _HEURISTIC_H_
+#define _HEURISTIC_H_
+
+
+#include "types.h"
+#include "pool.h"
+
+
+/* Default number of roots of the multi-root shortest path heuristic, which
+ * is never more than the number of terminals */
+#ifndef SPH_ROOTS
+#define SPH_ROOTS 8
+#endif
+
+
+/**
+ * mehlhorn - Build a Steiner tree with Mehlhorn's 2-approximation. The graph
+ * is split into the Voronoi regions of the terminals, and the MST of the
+ * distance network restricted to the edges between two regions is expanded
+ * into the graph. Returns a pointer to the solution, or NULL if there is no
+ * memory or the terminals are not connected. The result only depends on the
+ * graph.
+ *
+ * Source: K. Mehlhorn, A faster approximation algorithm for the Steiner
+ * problem in graphs, 1988.
+ *
+ * @stein: stein structure with the graph representation.
+ * @sol: solution where the tree is written, cleared first.
+ * @arena: arena the edges are allocated from.
+ * */
+struct solution *mehlhorn(struct stein *stein, struct solution *sol,
+		struct arena *arena);
+
+
+/**
+ * shortest_path_heuristic - Build a Steiner tree with the shortest path
+ * heuristic of Takahashi and Matsuyama: from the root, the closest terminal
+ * out of the tree is attached by its shortest path to the tree, until every
+ * terminal is in. The vertexes of the tree are then decoded by
+ * retrieve_mst_set(). Returns a pointer to the solution, or NULL if there is
+ * no memory or the terminals are not connected.
+ *
+ * Source: H. Takahashi and A. Matsuyama, An approximate solution for the
+ * Steiner problem in graphs, 1980.
+ *
+ * @stein: stein structure with the graph representation.
+ * @root: terminal the tree grows from.
+ * @sol: solution where the tree is written, cleared first.
+ * @arena: arena the edges are allocated from.
+ * */
+struct solution *shortest_path_heuristic(struct stein *stein,
+		unsigned int root, struct solution *sol, struct arena *arena);
+
+
+/**
+ * multi_root_sph - Run the shortest path heuristic from n roots spread evenly
+ * over the terminals, in parallel, writing the tree of the i-th root in
+ * sols[i]. Returns an error number (!= 0) if a tree could not be built.
+ *
+ * @stein: stein structure with the graph representation.
+ * @sols: n solutions where the trees are written.
+ * @n: number of roots, not above the number of terminals.
+ * @arenas: arena of each thread of the pool, the edges of the trees built by
+ * the thread t are allocated from arenas[t].
+ * @pool: threads to work with, or NULL.
+ * */
+int multi_root_sph(struct stein *stein, struct solution *sols,
+		unsigned int n, struct arena *arenas, struct pool *pool);
+
+
+#endif /* _HEURISTIC_H_ */
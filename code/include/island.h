@@ -0,0 +1,161 @@
+/**
+ * island.h - Island model of the genetic algorithm: independent populations,
+ * one per thread, which exchange their best individuals every few
+ * generations.
+ *
+ * Each island runs its own engine, see ga.h, with a single thread, seeded
+ * with the stream of its number of the seed of the run. The migrants travel
+ * through a lock-free queue per pair of islands, see spsc.h. The islands
+ * migrate in lockstep, so that a run only depends on its seed: at every
+ * interval generations, an island sends its migrants, waiting for room in the
+ * queue if its destination lags behind, and then waits for the migrants sent
+ * to it at the same generation. It only stops waiting for an island which is
+ * done, or when the run is stopped, which happens at a time of its own.
+ * */
+
+#ifndef _ISLAND_H_
+#define _ISLAND_H_
+
+
+#include "types.h"
+#include "ga.h"
+#include "pool.h"
+#include "spsc.h"
+
+
+/* Default number of islands; a single one runs the plain engine */
+#ifndef ISLANDS
+#define ISLANDS 1
+#endif
+
+/* Generations between two migrations */
+#ifndef MIGRATION_INTERVAL
+#define MIGRATION_INTERVAL 20
+#endif
+
+/* Best individuals sent by an island at each migration */
+#ifndef MIGRANTS
+#define MIGRANTS 1
+#endif
+
+
+enum island_topology {
+	/* The island i sends its migrants to the island i + 1 */
+	TOPOLOGY_RING,
+	/* Each migration goes to another island drawn at random, from a
+	 * stream of the seed of the run */
+	TOPOLOGY_RANDOM
+};
+
+struct island_params {
+	unsigned int n_islands;
+	unsigned long interval;
+	unsigned int n_migrants;
+	enum island_topology topology;
+};
+
+
+/* Copy of an individual travelling between two islands */
+struct migrant {
+	struct arena arena;
+	struct solution s;
+};
+
+/* Queue from an island to another one, with the slots of the migrants */
+struct island_link {
+	struct spsc q;
+	struct migrant *slot;
+};
+
+struct island {
+	struct ga ga;
+
+	/* Incoming links, indexed by the source island. Only the links of the
+	 * topology have slots. */
+	struct island_link *in;
+
+	/* Positions of the migrants, from the best */
+	unsigned int *elite;
+
+	/* Error number of the island, if it has failed */
+	int err;
+
+	/* Set once the island has left its generation loop */
+	int done;
+};
+
+struct archipelago {
+	struct stein *stein;
+	struct ga_params ga_params;
+	struct island_params params;
+
+	struct island *islands;
+
+	/* One thread per island */
+	struct pool pool;
+
+	/* Set once an island reaches the target weight or the gap */
+	int stop;
+};
+
+
+/**
+ * island_default_params - Fill the parameters with the compile time defaults.
+ *
+ * @params: parameters to fill.
+ * */
+void island_default_params(struct island_params *params);
+
+
+/**
+ * island_check_params - Validate the parameters of the island model. Returns
+ * an error number (!= 0) if any of them is out of range.
+ *
+ * @params: parameters to check.
+ * */
+int island_check_params(const struct island_params *params);
+
+
+/**
+ * archipelago_init - Validate the parameters, and allocate the islands and
+ * their links. The populations are created by archipelago_run(), on the
+ * thread of their island. Returns an error number (!= 0) on failure.
+ *
+ * @a: archipelago to initialize.
+ * @stein: stein structure with the graph representation.
+ * @ga_params: parameters of the engine of every island.
+ * @params: parameters of the island model.
+ * */
+int archipelago_init(struct archipelago *a, struct stein *stein,
+		const struct ga_params *ga_params,
+		const struct island_params *params);
+
+
+/**
+ * archipelago_run - Run every island on its own thread until the stopping
+ * rules of the engine hold for all of them, or until one of them reaches the
+ * target weight or the gap to the lower bound. Returns an error number (!= 0)
+ * on failure.
+ *
+ * @a: archipelago.
+ * */
+int archipelago_run(struct archipelago *a);
+
+
+/**
+ * archipelago_best - Return the best individual found by the islands.
+ *
+ * @a: archipelago, after archipelago_run().
+ * */
+const struct solution *archipelago_best(const struct archipelago *a);
+
+
+/**
+ * archipelago_free - Free the islands and their links.
+ *
+ * @a: archipelago.
+ * */
+void archipelago_free(struct archipelago *a);
+
+
+#endif /* _ISLAND_H_ */
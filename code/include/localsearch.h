@@ -0,0 +1,160 @@
+/**
+ * localsearch.h - Local search on the Steiner vertexes of a tree, which
+ * polishes the trees found by the genetic algorithm or the heuristics. Three
+ * neighbourhoods are tried, from the cheapest to evaluate:
+ *
+ *  - key-path exchange: a key path, whose inner vertexes are Steiner vertexes
+ *    of degree 2, is replaced by the shortest path between the two parts of
+ *    the tree it joins.
+ *  - key-vertex elimination: a Steiner vertex of degree 3 or more is removed,
+ *    and the parts of the tree it joined are reconnected by the MST of the
+ *    cheapest edges between them.
+ *  - vertex insertion: a vertex out of the tree is joined to it, each of its
+ *    edges to the tree replacing the heaviest edge of the cycle it closes.
+ *
+ * The moves only touch the tree and the edges around the changed vertexes,
+ * the MST of the whole vertex set is never computed again. After each move,
+ * the Steiner leaves are pruned.
+ *
+ * Source: E. Uchoa and R. F. Werneck, Fast local search for Steiner trees in
+ * graphs, 2010.
+ * */
+
+#ifndef _LOCALSEARCH_H_
+#define _LOCALSEARCH_H_
+
+
+#include "types.h"
+#include "heap.h"
+
+
+/* Key vertexes of a higher degree are not eliminated */
+#ifndef LS_MAX_DEGREE
+#define LS_MAX_DEGREE 64
+#endif
+
+
+enum ls_mode {
+	/* No local search */
+	LS_NONE,
+	/* Apply the first improving move found */
+	LS_FIRST,
+	/* Apply the best move of the three neighbourhoods */
+	LS_BEST
+};
+
+
+/* Edges of a tree, as (u, v, w), and their weight */
+struct ls_tree {
+	unsigned int (*e)[3];
+	unsigned int m;
+	unsigned long w;
+};
+
+/* Adjacency lists of a tree. The edge i gives the arcs 2i, leaving its first
+ * vertex, and 2i + 1, leaving the second one, so an arc a belongs to the edge
+ * a / 2 and is reversed by a ^ 1. */
+struct ls_adj {
+	/* First arc of each vertex */
+	unsigned int *head;
+	/* Next arc of the same vertex, and vertex each arc leads to */
+	unsigned int *next;
+	unsigned int *to;
+	unsigned int *deg;
+	/* Edges removed by the move under evaluation */
+	unsigned char *gone;
+};
+
+/* Edge out of a vertex, or between two parts of a tree */
+struct ls_link {
+	unsigned int w;
+	unsigned int u;
+	unsigned int v;
+};
+
+/* State of a search. The callers improving a tree per child keep one per
+ * thread, see ls_init(), so that no memory is taken from the system while the
+ * generations are bred. */
+struct ls {
+	struct stein *stein;
+	enum ls_mode mode;
+
+	/* Current tree, tree built by the move under evaluation, and best
+	 * one built so far in the pass */
+	struct ls_tree cur;
+	struct ls_tree cand;
+	struct ls_tree best;
+	struct ls_adj adj;
+	struct ls_adj cand_adj;
+
+	/* Vertexes of the current tree, which is rooted at the first one:
+	 * arc each vertex is reached by from the root, and depth */
+	unsigned int *tv;
+	unsigned int n_tv;
+	unsigned char *flag;
+	unsigned int *root_up;
+	unsigned int *depth;
+
+	/* Vertex the next scan of the insertions starts from */
+	unsigned int cursor;
+
+	/* Breadth-first visits: arc each vertex was reached by, and the
+	 * vertexes visited with the current stamp */
+	unsigned int *up;
+	unsigned int *queue;
+	unsigned int *mark;
+	unsigned int stamp;
+
+	/* Dijkstra of the key-path exchange, and the vertexes whose distance
+	 * it has to reset */
+	unsigned int *dist;
+	unsigned int *pred;
+	struct heap heap;
+	unsigned int *touched;
+	unsigned int n_touched;
+
+	/* Arcs of a key path, or part of the tree of each vertex */
+	unsigned int *list;
+
+	/* Tree neighbours of the vertex to insert, and cheapest edge between
+	 * each two parts of the tree left by an elimination */
+	struct ls_link *near;
+	struct ls_link *table;
+};
+
+
+/**
+ * ls_init - Allocate the memory of the search, which is O(V). Returns an
+ * error number (!= 0) if there is no memory.
+ *
+ * @ls: state of the search.
+ * @stein: stein structure with the graph representation.
+ * */
+int ls_init(struct ls *ls, struct stein *stein);
+
+
+/**
+ * ls_free - Free the memory of the search.
+ *
+ * @ls: state of the search.
+ * */
+void ls_free(struct ls *ls);
+
+
+/**
+ * local_search - Apply improving moves to the tree until there is none left.
+ * The solution is only rewritten if it was improved. Returns an error number
+ * (!= 0) if there is no memory.
+ *
+ * @stein: stein structure with the graph representation.
+ * @s: solution to improve, a tree spanning the terminals.
+ * @mode: how the move to apply is chosen, nothing is done for LS_NONE.
+ * @state: state of the search, see ls_init(), or NULL to allocate one for
+ * this call.
+ * @arena: arena the edges of the improved tree are allocated from.
+ * */
+int local_search(struct stein *stein, struct solution *s, enum ls_mode mode,
+		struct ls *state, struct arena *arena);
+
+
+#endif /* _LOCALSEARCH_H_ */
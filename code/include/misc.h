@@ -3,13 +3,14 @@
 
 
 #include <time.h>
-#include <libio.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
 
 
 /**
- * time_seed - Defines a seed for the srand function based on the system time.
+ * time_seed - Defines a seed for the random number generator based on the
+ * system time, used when no seed is given.
  * Source:
  * - http://eternallyconfuzzled.com/arts/jsw_art_rand.aspx
  * */
@@ -27,19 +28,4 @@ static inline unsigned time_seed()
 }
 
 
-/**
- * range_rand - Selects a random number between the given bounds.
- *
- * @upper: the range will be lesser or equal to this number.
- * @bottom: the range will be greater or equal to this number.
- * */
-static inline int range_rand(int upper, int bottom)
-{
-	int r;
-	do {
-		r = rand();
-	} while (r <= upper || r >= bottom);
-	return r;
-}
-
 #endif /* _MISC_H */
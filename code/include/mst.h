@@ -13,13 +13,48 @@
 #include "types.h"
 
 
+/**
+ * mst_scratch - Number of words of the scratch retrieve_mst_set() needs: the
+ * keys, the parents and the edges of the tree of the dense graphs, and the
+ * heap and the states of the vertexes of the sparse ones.
+ *
+ * @stein: stein structure with the graph representation.
+ * */
+static inline size_t mst_scratch(const struct stein *stein)
+{
+	return 8 * (size_t)stein->n_nodes;
+}
+
 
 /**
  * retrieve_mst - Builds a maximum spanning tree with the vertexes in
- * stein->terminals, returning a pointer to the solution list head.
+ * stein->terminals, returning a pointer to the solution.
+ *
+ * @stein: stein structure with the graph representation.
+ * @sol: solution where the edges are added, cleared first.
+ * @arena: arena the edges are allocated from, usually the one of the
+ * generation the solution belongs to.
+ * */
+struct solution *retrieve_mst(struct stein *stein, struct solution *sol,
+		struct arena *arena);
+
+
+/**
+ * retrieve_mst_set - Builds the MST of the subgraph induced by the vertexes in
+ * set and prunes its non-terminal leaves, returning a pointer to the solution,
+ * or NULL if the terminals are not connected in that subgraph. This decodes
+ * a set of Steiner vertexes into a tree.
  *
  * @stein: stein structure with the graph representation.
+ * @set: vertexes of the tree, with every terminal. The last one must be a
+ * terminal, it is the root.
+ * @n: number of vertexes in set.
+ * @sol: solution where the edges are added, cleared first.
+ * @scratch: mst_scratch() words, or NULL to allocate them for this call.
+ * @arena: arena the edges are allocated from.
  * */
-struct list_head *retrieve_mst(struct stein *stein);
+struct solution *retrieve_mst_set(struct stein *stein, const unsigned int *set,
+		unsigned int n, struct solution *sol, unsigned int *scratch,
+		struct arena *arena);
 
 #endif /* _MST_H_ */
@@ -0,0 +1,104 @@
+/**
+ * pool.h - Persistent pool of worker threads running parallel loops.
+ *
+ * The workers are created once and sleep between the loops. A loop hands out
+ * its iterations through an atomic counter, so no lock is taken while it runs:
+ * the lock is only held to start a loop and to wait for its end. The calling
+ * thread works on the loop as well, as the thread 0.
+ *
+ * The workers leave their random number generator as it is: a task which draws
+ * seeds the one of its thread with rng_split(), so that its draws do not
+ * depend on the thread running it.
+ * */
+
+#ifndef _POOL_H_
+#define _POOL_H_
+
+
+#include <pthread.h>
+
+
+/**
+ * Body of a parallel loop.
+ *
+ * @arg: argument given to pool_run().
+ * @i: iteration.
+ * @thread: thread running the iteration, from 0 to pool_threads() - 1.
+ * */
+typedef void (*pool_fn)(void *arg, unsigned int i, unsigned int thread);
+
+struct pool_thread {
+	struct pool *pool;
+	pthread_t thread;
+	unsigned int index;
+};
+
+struct pool {
+	/* Worker threads, the calling thread not included */
+	struct pool_thread *workers;
+	unsigned int n_threads;
+
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+
+	/* Number of loops started, and of workers still running the last one */
+	unsigned long job;
+	unsigned int running;
+	int stop;
+
+	/* Current loop */
+	pool_fn fn;
+	void *arg;
+	unsigned int n;
+
+	/* Next iteration to hand out */
+	unsigned int next;
+};
+
+
+/**
+ * pool_init - Start the worker threads. Returns an error number (!= 0) on
+ * failure.
+ *
+ * @pool: pool to initialize.
+ * @n_threads: number of threads, the calling one included, or 0 for one per
+ * online CPU.
+ * */
+int pool_init(struct pool *pool, unsigned int n_threads);
+
+
+/**
+ * pool_threads - Number of threads of the pool, the calling one included. A
+ * NULL pool has a single thread.
+ *
+ * @pool: pool.
+ * */
+static inline unsigned int pool_threads(const struct pool *pool)
+{
+	return pool ? pool->n_threads : 1u;
+}
+
+
+/**
+ * pool_run - Run fn(arg, i, thread) for every i in [0, n) and wait for all of
+ * them. The calling thread runs the whole loop by itself when the pool is
+ * NULL or has a single thread.
+ *
+ * @pool: pool.
+ * @fn: body of the loop.
+ * @arg: argument given to fn.
+ * @n: number of iterations.
+ * */
+void pool_run(struct pool *pool, pool_fn fn, void *arg, unsigned int n);
+
+
+/**
+ * pool_free - Stop the worker threads and free the pool.
+ *
+ * @pool: pool.
+ * */
+void pool_free(struct pool *pool);
+
+
+#endif /* _POOL_H_ */
@@ -8,15 +8,58 @@
 #define _POPULATION_H_
 
 #include "types.h"
+#include "pool.h"
+#include "mst.h"
+
+
+enum crossover_scheme {
+	/* The Steiner vertexes of both parents, and each one of a single
+	 * parent with probability 1/2 */
+	CROSSOVER_UNIFORM,
+	/* The Steiner vertexes of the first parent below a random vertex, and
+	 * the ones of the second parent from it on */
+	CROSSOVER_ONE_POINT
+};
+
+
+/**
+ * population_scratch - Number of words of the scratch a thread needs for the
+ * mutations, repairs and crossovers, see mutate_solution(), repair_solution()
+ * and crossover(). Each thread
+ * has its own, allocated once by its caller, so they take no memory from the
+ * system while they run. The vertex set being decoded takes the first
+ * stein->n_nodes words, the scratch of retrieve_mst_set() the next ones, and
+ * the marks of the vertexes a repair keeps the last stein->n_nodes.
+ *
+ * @stein: stein structure with the graph representation.
+ * */
+static inline size_t population_scratch(const struct stein *stein)
+{
+	return 2 * (size_t)stein->n_nodes + mst_scratch(stein);
+}
 
 
 /**
- * create_initial_population - From a common ancestor, create a population of
- * solutions based on this ancestor random mutations.
+ * create_initial_population - From a few seeds, create a population of
+ * solutions based on their random mutations. The seeds are the tree of
+ * Mehlhorn's heuristic, see mehlhorn(), the MST of the terminals, see
+ * retrieve_mst(), and, when there is room in the population, the trees of
+ * the shortest path heuristic from up to n_roots roots, see multi_root_sph(),
+ * the lightest first. The first individuals are the seeds themselves, so the
+ * population is never worse than the first of them. The individuals are
+ * owned by the returned generation, see free_generation().
  *
  * @stein: Stein structure used to create a common ancestor.
+ * @size: number of individuals.
+ * @rate: every edge mutates with probability 1 / rate.
+ * @n_roots: roots of the shortest path heuristic, up to one per terminal.
+ * @seed: seed of the random draws, the same seed giving the same population
+ * whatever the threads.
+ * @pool: threads to work with, or NULL.
  * */
-struct list_head *create_initial_population(struct stein *stein);
+struct generation *create_initial_population(struct stein *stein,
+		unsigned int size, unsigned int rate, unsigned int n_roots,
+		uint64_t seed, struct pool *pool);
 
 /**
  * Mutations are based on a triangle inequality, i.e., when a mutation is
@@ -24,18 +67,81 @@ struct list_head *create_initial_population(struct stein *stein);
  * to a direct edge between two terminals. The method, thus, adds two edges to the
  * solution and removes one.
  *
+ * The cheapest insertion point is used when it makes the solution cheaper,
+ * otherwise a random vertex the decoding keeps, see get_cheapest_v(), or any
+ * random vertex if there is none. On sparse graphs, where the ends of
+ * an edge seldom have a common neighbour, the vertex set is mutated instead:
+ * a vertex next to the edge, see get_near_v(), joins the tree as a leaf, and
+ * repair_solution() decides what it is joined to.
+ *
  * @s: Solution which will mutate.
+ * @e: index of the edge to replace.
  * @stein: Stein struct.
- * @s_head: Solution list head.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the solution belongs to.
  * */
-void mutation(struct solution *s, struct stein *stein, struct list_head *s_head);
+void mutation(struct solution *s, unsigned int e, struct stein *stein,
+		unsigned int *scratch, struct arena *arena);
+
+
+/**
+ * mutate_solution - Mutate every edge of the solution with probability
+ * 1 / rate, see mutation(). Returns the number of mutations. The tree is left
+ * as the insertions made it, see repair_solution().
+ *
+ * @s: Solution which will mutate.
+ * @stein: Stein struct.
+ * @rate: inverse of the mutation probability.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the solution belongs to.
+ * */
+unsigned int mutate_solution(struct solution *s, struct stein *stein,
+		unsigned int rate, unsigned int *scratch, struct arena *arena);
+
+
+/**
+ * repair_solution - Decode the vertexes of a mutated solution into a tree
+ * again, see retrieve_mst_set(), which connects each inserted vertex to its
+ * nearest ones and prunes the Steiner leaves, and bypass the Steiner vertexes
+ * of degree 2 whose neighbours are no farther apart by their own edge, but
+ * for the inserted ones. The tree is never heavier than before. Returns an
+ * error number (!= 0) if there is no memory.
+ *
+ * @s: Solution to repair.
+ * @stein: Stein struct.
+ * @first_new: number of vertexes of the solution before the mutations, which
+ * inserted the ones from this position on.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the solution belongs to.
+ * */
+int repair_solution(struct solution *s, struct stein *stein,
+		unsigned int first_new, unsigned int *scratch,
+		struct arena *arena);
 
 
 /**
  * Crossover is based on an exchange of partial solutions of a population, i.e.,
  * given two solutions, part of the solution structure - the use or not of an
- * intermediate terminal - is exchanged, forming a new population.
+ * intermediate vertex - is exchanged, forming a new population.
+ *
+ * The child takes the terminals and a set of Steiner vertexes drawn from the
+ * ones of its parents, see enum crossover_scheme, which is decoded into a tree
+ * by retrieve_mst_set(). When the terminals are not connected through that
+ * set, the child is a copy of the first parent.
+ *
+ * Returns an error number (!= 0) if there is no memory.
+ *
+ * @child: solution where the child is written.
+ * @s1: first parent.
+ * @s2: second parent.
+ * @stein: Stein struct.
+ * @scheme: how the Steiner vertexes are drawn.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the child belongs to.
  * */
-void crossover(struct solution *s1, struct solution *s2);
+int crossover(struct solution *child, const struct solution *s1,
+		const struct solution *s2, struct stein *stein,
+		enum crossover_scheme scheme, unsigned int *scratch,
+		struct arena *arena);
 
 #endif /* _POPULATION_H_ */
@@ -30,6 +30,11 @@
 #define pr_error(fmt, ...) \
 	pr_level(PRINT_ERROR, __FILE__, __func__, __LINE__, fmt, ##__VA_ARGS__)
 
+/* Errors in what the user gave (options, configuration, log or instance)
+ * stop the program, so they go to stderr whatever the print level is */
+#define pr_fatal(fmt, ...) \
+	fprintf(stderr, "[ERROR] " fmt, ##__VA_ARGS__)
+
 #pragma GCC diagnostic pop
 
 #ifndef PRINT_LEVEL
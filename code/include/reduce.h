@@ -0,0 +1,126 @@
+/**
+ * reduce.h - Reduction tests, which shrink the instance before it is solved
+ * while keeping an optimal tree in it:
+ *
+ *  - a Steiner vertex of degree 0 or 1 is removed with its edge.
+ *  - a Steiner vertex of degree 2 is replaced by an edge between its two
+ *    neighbours, weighing both of its edges.
+ *  - the edge of a terminal of degree 1 is in every tree: it is fixed, and the
+ *    terminal merged into its neighbour, which becomes a terminal.
+ *  - long edge: an edge heavier than another path between its ends is in no
+ *    minimum tree, and is removed.
+ *  - special distance: nor is an edge heavier than both paths from its ends
+ *    to a same terminal, since the bottleneck of the elementary paths of the
+ *    path between its ends through the terminal is below its weight.
+ *  - reduced cost: nor is an edge which the dual ascent proves to be in no
+ *    tree lighter than a known one, see dual_ascent_test().
+ *
+ * The distance tests are bounded Dijkstras from every vertex, so they find
+ * fewer edges than the exact tests, but none in a minimum tree. The reduced
+ * graph replaces the instance, with its vertexes numbered again, and the
+ * trees found in it are expanded back to the original graph through the
+ * record of the reductions.
+ *
+ * Source: C. W. Duin and A. Volgenant, Reduction tests for the Steiner
+ * problem in graphs, 1989.
+ * */
+
+#ifndef _REDUCE_H_
+#define _REDUCE_H_
+
+
+#include "types.h"
+
+
+/* Rounds of the distance tests, each followed by the degree tests */
+#ifndef REDUCE_ROUNDS
+#define REDUCE_ROUNDS 4
+#endif
+
+/* Edges scanned by the Dijkstra from each vertex in the distance tests, on
+ * top of the edges of the vertex itself */
+#ifndef REDUCE_SD_SCANS
+#define REDUCE_SD_SCANS 4096
+#endif
+
+/* Closest terminals of each vertex kept for the special distance test */
+#ifndef REDUCE_SD_TERMINALS
+#define REDUCE_SD_TERMINALS 4
+#endif
+
+/* Roots of the dual ascents of the reduced cost test */
+#ifndef REDUCE_DA_ROOTS
+#define REDUCE_DA_ROOTS 4
+#endif
+
+/* No edge, or no vertex */
+#define REDUCE_NONE UINT_MAX
+
+
+struct reduction {
+	/* Number of vertexes of the original graph, and original vertex of
+	 * each vertex of the reduced one */
+	unsigned int n_orig;
+	unsigned int *orig;
+
+	/* Every edge met by the reductions, as (u, v, w) in the original
+	 * vertexes: the edges of the original graph, and then the ones made
+	 * by the degree-2 test, which stand for the two edges in merged, or
+	 * REDUCE_NONE for the original edges. */
+	unsigned int (*edge)[3];
+	unsigned int (*merged)[2];
+	unsigned int n_edges;
+
+	/* Edges fixed by the degree-1 test on the terminals, and their
+	 * weight, which the trees of the reduced graph do not count */
+	unsigned int *fixed;
+	unsigned int n_fixed;
+	unsigned long fixed_w;
+
+	/* Lower bound on the trees of the reduced graph, found by the reduced
+	 * cost test, the fixed edges not included */
+	unsigned long lb;
+
+	/* Edges of the reduced graph, as (u, v, edge) with u < v in the
+	 * reduced vertexes, sorted to be searched */
+	unsigned int (*index)[3];
+	unsigned int n_index;
+};
+
+
+/**
+ * reduce_graph - Apply the reduction tests to the instance returned by
+ * get_stein(), which is replaced by the reduced graph. Instances with less
+ * than two terminals are left as they are. Returns an error number (!= 0) if
+ * there is no memory, in which case the instance may be lost.
+ *
+ * @stein: stein structure with the graph representation.
+ * @r: record of the reductions, to expand the trees.
+ * */
+int reduce_graph(struct stein *stein, struct reduction *r);
+
+
+/**
+ * reduction_expand - Write the edges of the original graph the tree of the
+ * reduced graph stands for, the fixed edges included, as (u, v, w). Returns an
+ * error number (!= 0) if there is no memory, or an edge of the tree is not in
+ * the reduced graph.
+ *
+ * @r: record of the reductions.
+ * @s: tree of the reduced graph.
+ * @edges: set to the edges, to be released with free().
+ * @n_edges: set to the number of edges.
+ * */
+int reduction_expand(const struct reduction *r, const struct solution *s,
+		unsigned int (**edges)[3], unsigned int *n_edges);
+
+
+/**
+ * reduction_free - Release the memory of the record of the reductions.
+ *
+ * @r: record of the reductions.
+ * */
+void reduction_free(struct reduction *r);
+
+
+#endif /* _REDUCE_H_ */
@@ -0,0 +1,151 @@
+/**
+ * rng.h - Pseudo random number generator used by the genetic operators.
+ *
+ * The generator is xoshiro256**, whose state is seeded by splitmix64. Every
+ * thread has its own state, see get_rng(), so no lock is taken on a draw.
+ * Bounded draws use Lemire's multiply and shift, which is unbiased and
+ * rarely takes more than a single draw.
+ *
+ * Sources:
+ * - http://prng.di.unimi.it/xoshiro256starstar.c
+ * - D. Lemire, Fast Random Integer Generation in an Interval, 2019.
+ * */
+
+#ifndef _RNG_H_
+#define _RNG_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+struct rng {
+	uint64_t s[4];
+};
+
+
+static inline uint64_t __rng_rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+
+/**
+ * rng_next - Return the next 64 random bits.
+ *
+ * @r: generator state.
+ * */
+static inline uint64_t rng_next(struct rng *r)
+{
+	uint64_t *s = r->s;
+	uint64_t result = __rng_rotl(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = __rng_rotl(s[3], 45);
+
+	return result;
+}
+
+
+/**
+ * rng_bound - Return a random number in [0, n), without bias. n must not be 0.
+ *
+ * @r: generator state.
+ * @n: upper bound, excluded.
+ * */
+static inline uint32_t rng_bound(struct rng *r, uint32_t n)
+{
+	uint64_t m = (rng_next(r) >> 32) * n;
+
+	/* The low half is below 2^32 mod n for the values drawn more often
+	 * than the others, which are thus rejected. */
+	if((uint32_t)m < n) {
+		uint32_t t = -n % n;
+
+		while((uint32_t)m < t)
+			m = (rng_next(r) >> 32) * n;
+	}
+
+	return m >> 32;
+}
+
+
+/**
+ * rng_unit - Return a random number in [0, 1).
+ *
+ * @r: generator state.
+ * */
+static inline double rng_unit(struct rng *r)
+{
+	return (rng_next(r) >> 11) * 0x1.0p-53;
+}
+
+
+/**
+ * rng_chance - Return 1 with probability 1 / n, and 0 otherwise.
+ *
+ * @r: generator state.
+ * @n: inverse of the probability, not 0.
+ * */
+static inline int rng_chance(struct rng *r, uint32_t n)
+{
+	return rng_bound(r, n) == 0;
+}
+
+
+/**
+ * get_rng - Return the generator state of the calling thread.
+ * */
+struct rng *get_rng();
+
+
+/**
+ * rng_seed - Seed the generator. The same seed always gives the same
+ * sequence.
+ *
+ * @r: generator state.
+ * @seed: seed.
+ * */
+void rng_seed(struct rng *r, uint64_t seed);
+
+
+/**
+ * rng_derive - Return the seed of the stream id of a seed. The streams of a
+ * same seed are independent, and only depend on the seed and their number,
+ * which makes a tree of seeds: a seed per island from the seed of the run, a
+ * seed per generation from the one of the island, and so on.
+ *
+ * @seed: seed the stream is derived from.
+ * @id: number of the stream.
+ * */
+uint64_t rng_derive(uint64_t seed, uint64_t id);
+
+
+/**
+ * rng_split - Seed the generator with the stream id of a seed, see
+ * rng_derive(). A task of a parallel loop seeds the generator of its thread
+ * this way, so that its draws do not depend on the thread running it.
+ *
+ * @r: generator state.
+ * @seed: seed the stream is derived from.
+ * @id: number of the stream.
+ * */
+void rng_split(struct rng *r, uint64_t seed, uint64_t id);
+
+
+/**
+ * rng_skip - Return the number of failed trials before the first success,
+ * when every trial succeeds with probability 1 / n, with a single draw.
+ *
+ * @r: generator state.
+ * @n: inverse of the probability, not 0.
+ * */
+uint32_t rng_skip(struct rng *r, uint32_t n);
+
+
+#endif /* _RNG_H_ */
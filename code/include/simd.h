@@ -0,0 +1,70 @@
+/**
+ * simd.h - Vectorized kernels for the scans over unsigned int weight rows
+ * performed by the MST, the mutation and the metric closure. Each kernel has
+ * an AVX2, a SSE4.1 and a scalar implementation, and the best one supported
+ * by the running CPU is selected when the program starts.
+ * */
+
+
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+
+/**
+ * simd_key_update - Relax the Prim keys against a new tree vertex: for every
+ * i < n where row[i] < key[i], key[i] is set to row[i] and parent[i] to v.
+ *
+ * @key: cheapest known cost of each vertex.
+ * @parent: tree vertex giving each key.
+ * @row: cost of each vertex from v.
+ * @v: vertex just added to the tree.
+ * @n: size of the arrays.
+ * */
+void simd_key_update(unsigned int *key, unsigned int *parent,
+		const unsigned int *row, unsigned int v, unsigned int n);
+
+
+/**
+ * simd_argmin - Return the first position of the minimum value in the array,
+ * or 0 if the array is empty.
+ *
+ * @a: array to scan.
+ * @n: size of the array.
+ * */
+unsigned int simd_argmin(const unsigned int *a, unsigned int n);
+
+
+/**
+ * simd_pair_argmin - Return the first position i minimizing a[i] + b[i]. The
+ * sum saturates at UINT_MAX, so W_INF in either array is never selected
+ * unless there is nothing else.
+ *
+ * @a: first array to scan.
+ * @b: second array to scan.
+ * @n: size of the arrays.
+ * @min: filled with the minimum sum.
+ * */
+unsigned int simd_pair_argmin(const unsigned int *a, const unsigned int *b,
+		unsigned int n, unsigned int *min);
+
+
+
+/**
+ * simd_relax - Relax the shortest paths of a source through the vertex k:
+ * for every i < n where d + via[i] < dist[i], dist[i] is set to the sum and
+ * pred[i] to via_pred[i]. The sum saturates at UINT_MAX, so W_INF is never
+ * shortened.
+ *
+ * @dist: distance of each vertex from the source.
+ * @pred: predecessor of each vertex on its path from the source.
+ * @via: distance of each vertex from k.
+ * @via_pred: predecessor of each vertex on its path from k.
+ * @d: distance of k from the source.
+ * @n: size of the arrays.
+ * */
+void simd_relax(unsigned int *dist, unsigned int *pred,
+		const unsigned int *via, const unsigned int *via_pred,
+		unsigned int d, unsigned int n);
+
+
+#endif /* _SIMD_H_ */
@@ -0,0 +1,117 @@
+/**
+ * spsc.h - Lock-free bounded queue with a single producer and a single
+ * consumer.
+ *
+ * The queue only hands out slot positions: the slots themselves live in an
+ * array owned by the caller, of spsc_capacity() entries. The producer fills
+ * the slot given by spsc_back() and publishes it with spsc_push(), the
+ * consumer reads the slot given by spsc_front() and releases it with
+ * spsc_pop(). A slot belongs to a single thread at any time, so its content
+ * needs no lock.
+ * */
+
+#ifndef _SPSC_H_
+#define _SPSC_H_
+
+
+#define SPSC_NONE (~0u)
+
+/* Producer and consumer positions live in their own cache lines */
+#define SPSC_LINE 64
+
+struct spsc {
+	/* Next slot to read, written by the consumer only */
+	unsigned int head __attribute__((aligned(SPSC_LINE)));
+
+	/* Next slot to fill, written by the producer only */
+	unsigned int tail __attribute__((aligned(SPSC_LINE)));
+
+	/* Capacity - 1, the capacity being a power of 2 */
+	unsigned int mask;
+};
+
+
+/**
+ * spsc_init - Initialize an empty queue with room for at least n slots.
+ *
+ * @q: queue to initialize.
+ * @n: minimum capacity, not 0.
+ * */
+static inline void spsc_init(struct spsc *q, unsigned int n)
+{
+	unsigned int capacity = 1u;
+
+	while(capacity < n)
+		capacity <<= 1;
+	q->head = 0u;
+	q->tail = 0u;
+	q->mask = capacity - 1;
+}
+
+
+/**
+ * spsc_capacity - Number of slots of the queue.
+ *
+ * @q: queue.
+ * */
+static inline unsigned int spsc_capacity(const struct spsc *q)
+{
+	return q->mask + 1;
+}
+
+
+/**
+ * spsc_back - Producer side: return the slot to fill next, or SPSC_NONE if
+ * the queue is full.
+ *
+ * @q: queue.
+ * */
+static inline unsigned int spsc_back(struct spsc *q)
+{
+	unsigned int head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+	if(q->tail - head > q->mask)
+		return SPSC_NONE;
+	return q->tail & q->mask;
+}
+
+
+/**
+ * spsc_push - Producer side: publish the slot given by spsc_back().
+ *
+ * @q: queue.
+ * */
+static inline void spsc_push(struct spsc *q)
+{
+	__atomic_store_n(&q->tail, q->tail + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * spsc_front - Consumer side: return the oldest published slot, or SPSC_NONE
+ * if the queue is empty.
+ *
+ * @q: queue.
+ * */
+static inline unsigned int spsc_front(struct spsc *q)
+{
+	unsigned int tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+	if(q->head == tail)
+		return SPSC_NONE;
+	return q->head & q->mask;
+}
+
+
+/**
+ * spsc_pop - Consumer side: release the slot given by spsc_front().
+ *
+ * @q: queue.
+ * */
+static inline void spsc_pop(struct spsc *q)
+{
+	__atomic_store_n(&q->head, q->head + 1, __ATOMIC_RELEASE);
+}
+
+
+#endif /* _SPSC_H_ */
@@ -12,8 +12,44 @@
 
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "list.h"
+#include "arena.h"
+
+
+/* Weight returned for a missing edge (and for the matrix diagonal). Every cell
+ * width stores it with all bits set, so a memset(0xff) initializes a matrix
+ * with no edges. */
+#define W_INF UINT_MAX
+
+/* Complete graphs with at least this number of nodes store only the upper
+ * triangle of the adjacency matrix. */
+#ifndef TRIANGLE_MIN_NODES
+#define TRIANGLE_MIN_NODES 2048
+#endif
+
+/* Graphs with less than 1 / CSR_DENSITY_RATIO of the n(n-1)/2 possible edges
+ * are stored in the compressed sparse row layout. */
+#ifndef CSR_DENSITY_RATIO
+#define CSR_DENSITY_RATIO 8
+#endif
+
+/* Storage layouts of the adjacency matrix */
+enum adj_layout {
+	/* n_nodes x n_nodes cells, every weight is stored twice */
+	ADJ_FULL,
+	/* n_nodes * (n_nodes - 1) / 2 cells, row by row, holding only the
+	 * (u, v) cells with u < v */
+	ADJ_TRIANGLE,
+	/* Compressed sparse rows, three unsigned int arrays one after the
+	 * other: the n_nodes + 1 row offsets, then the 2 * n_edges neighbours
+	 * and the 2 * n_edges weights. The neighbours of u are at the positions
+	 * offsets[u] to offsets[u + 1] - 1, sorted, and every edge is stored
+	 * in both rows. */
+	ADJ_CSR,
+};
 
 struct stein {
 	/* Number of nodes on the graph - retrieved directly from the initial file. */
@@ -32,26 +68,360 @@ struct stein {
 	/* Vector indicating which nodes are terminals */
 	unsigned int *terminals;
 
-	/* Graph adjacency matrix */
-	unsigned int **adj_m;
+	/* Graph adjacency matrix. It is a single page aligned block with its
+	 * cells in row-major order, laid out as given by layout. Use stein_w()
+	 * to read it, since the cells may be narrowed to uint16_t after the
+	 * file is read. */
+	void *adj_m;
+
+	/* Layout of adj_m (enum adj_layout) */
+	unsigned int layout;
+
+	/* Size in bytes of an adjacency matrix cell */
+	unsigned int w_size;
+
+	/* Memory mapping holding adj_m and its size in bytes. It is adj_m
+	 * itself, unless the matrix was loaded from a binary file. */
+	void *adj_map;
+	size_t adj_size;
 };
 
 
-/* Solution list for the problem. It will be used to build a initial population
- * based in a common ancestor: a MST solution for the terminals.
+/**
+ * adj_cells - Return the number of cells of the adjacency matrix. For the
+ * ADJ_CSR layout, it is the number of unsigned int in the three arrays.
+ *
+ * @stein: stein structure with the graph representation.
+ * */
+static inline size_t adj_cells(const struct stein *stein)
+{
+	size_t n = stein->n_nodes;
+
+	if(stein->layout == ADJ_CSR)
+		return n + 1 + 4 * (size_t)stein->n_edges;
+	if(stein->layout == ADJ_TRIANGLE)
+		return n * (n - 1) / 2;
+	return n * n;
+}
+
+
+/**
+ * csr_off, csr_adj, csr_wts - Return the row offsets, neighbours and weights
+ * arrays of a graph in the ADJ_CSR layout.
+ * */
+static inline unsigned int *csr_off(const struct stein *stein)
+{
+	return stein->adj_m;
+}
+
+static inline unsigned int *csr_adj(const struct stein *stein)
+{
+	return csr_off(stein) + stein->n_nodes + 1;
+}
+
+static inline unsigned int *csr_wts(const struct stein *stein)
+{
+	return csr_adj(stein) + 2 * (size_t)stein->n_edges;
+}
+
+
+/**
+ * csr_w - Binary search the neighbour v in the row of u, returning the edge
+ * weight or W_INF if they are not adjacent.
+ * */
+static inline unsigned int csr_w(const struct stein *stein, unsigned int u,
+		unsigned int v)
+{
+	const unsigned int *off = csr_off(stein), *adj = csr_adj(stein);
+	unsigned int lo = off[u], hi = off[u + 1];
+
+	while(lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if(adj[mid] < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < off[u + 1] && adj[lo] == v ? csr_wts(stein)[lo] : W_INF;
+}
+
+
+/**
+ * adj_index - Return the cell of the adjacency matrix holding the edge (u, v).
+ * The vertexes must be different.
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: first vertex of the edge.
+ * @v: second vertex of the edge.
+ * */
+static inline size_t adj_index(const struct stein *stein, unsigned int u,
+		unsigned int v)
+{
+	size_t n = stein->n_nodes;
+
+	if(stein->layout == ADJ_TRIANGLE) {
+		/* The rows 0..u-1 take u * (2n - u - 1) / 2 cells, and the
+		 * row u starts at the column u + 1. */
+		if(u > v) {
+			unsigned int tmp = u;
+			u = v;
+			v = tmp;
+		}
+		return (size_t)u * (2 * n - u - 1) / 2 + (v - u - 1);
+	}
+	return (size_t)u * n + v;
+}
+
+
+/**
+ * stein_w - Return the weight of the edge (u, v), or W_INF if there is no such
+ * edge. This is the only way the adjacency matrix should be read.
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: first vertex of the edge.
+ * @v: second vertex of the edge.
+ * */
+static inline unsigned int stein_w(const struct stein *stein, unsigned int u,
+		unsigned int v)
+{
+	size_t i;
+
+	if(u == v)
+		return W_INF;
+	if(stein->layout == ADJ_CSR)
+		return csr_w(stein, u, v);
+
+	i = adj_index(stein, u, v);
+	if(stein->w_size == sizeof(uint16_t)) {
+		uint16_t w = ((const uint16_t *)stein->adj_m)[i];
+		return w == UINT16_MAX ? W_INF : w;
+	}
+	return ((const unsigned int *)stein->adj_m)[i];
+}
+
+
+/**
+ * stein_set_w - Set the weight of the undirected edge (u, v). It must only be
+ * used before compact_adj_m(), while the cells are still unsigned int, and
+ * never in the ADJ_CSR layout, which is filled at once by fill_csr().
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: first vertex of the edge.
+ * @v: second vertex of the edge.
+ * @w: edge weight.
+ * */
+static inline void stein_set_w(struct stein *stein, unsigned int u,
+		unsigned int v, unsigned int w)
+{
+	unsigned int *adj_m = stein->adj_m;
+
+	adj_m[adj_index(stein, u, v)] = w;
+	if(stein->layout == ADJ_FULL)
+		adj_m[adj_index(stein, v, u)] = w;
+}
+
+
+/**
+ * stein_gather - Fill row[i] with the weight of the edge (u, idx[i]), for
+ * every i < n. The layout and cell width are checked once, outside the loop.
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: vertex common to every edge.
+ * @idx: vertexes at the other end of the edges.
+ * @n: number of edges.
+ * @row: filled with the weights.
+ * */
+void stein_gather(const struct stein *stein, unsigned int u,
+		const unsigned int *idx, unsigned int n, unsigned int *row);
+
+
+/**
+ * stein_row - Fill row[v] with the weight of the edge (u, v), for every vertex
+ * v of the graph.
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: vertex common to every edge.
+ * @row: filled with the n_nodes weights.
+ * */
+void stein_row(const struct stein *stein, unsigned int u, unsigned int *row);
+
+
+/* An individual of the population: a tree given by its edges, kept in a
+ * contiguous array so it is copied with a single memcpy. The first solution is
+ * the common ancestor, a MST solution for the terminals.
+ *
+ * The edge array and the vertex set are taken from the arena of the
+ * generation the solution belongs to, see reserve_solution().
  * */
 struct solution {
-	struct list_head list;
-	int w;
-	unsigned int edge[2]; /*__attribute__ ((packed));*/
+	/* Total weight of the tree */
+	unsigned int w;
+
+	/* Number of edges in the tree */
+	unsigned int n_edges;
+
+	/* Number of vertexes in the tree, terminals and Steiner ones */
+	unsigned int n_vertexes;
+
+	/* Number of edges the edge array has room for */
+	unsigned int max_edges;
+
+	/* Edges of the tree */
+	unsigned int (*edge)[2];
+
+	/* Sparse set of the vertexes: vertex is a permutation of the graph
+	 * vertexes where the n_vertexes ones in the tree come first, and pos
+	 * the position of each vertex in it. Both membership and picking a
+	 * random vertex out of the tree are O(1). */
+	unsigned int *vertex;
+	unsigned int *pos;
 };
 
-struct population {
-	struct list_head solution;
-	struct list_head list;
+/* A generation owns its individuals, whose edges are taken from its arenas
+ * and released together: there is no per-edge free, and the memory is reused
+ * by the next generation after reset_generation(). There is an arena for each
+ * thread working on the generation, so they never share one.
+ * */
+struct generation {
+	/* Array of the individuals */
+	struct solution *pop;
+
+	/* Number of individuals */
+	unsigned int size;
+
+	/* Memory of the individuals edges and vertex sets, one arena per
+	 * thread */
+	struct arena *arena;
+	unsigned int n_arenas;
 };
 
 
+/**
+ * solution_has_v - Test whether the vertex v is in the solution.
+ *
+ * @s: solution.
+ * @v: vertex to search.
+ * */
+static inline int solution_has_v(const struct solution *s, unsigned int v)
+{
+	return s->pos[v] < s->n_vertexes;
+}
+
+
+/**
+ * __solution_swap_v - Swap the vertex v with the one at position i of the
+ * solution vertex set.
+ * */
+static inline void __solution_swap_v(struct solution *s, unsigned int v,
+		unsigned int i)
+{
+	unsigned int u = s->vertex[i];
+
+	s->vertex[s->pos[v]] = u;
+	s->pos[u] = s->pos[v];
+	s->vertex[i] = v;
+	s->pos[v] = i;
+}
+
+
+/**
+ * solution_add_v - Mark the vertex v as part of the solution.
+ *
+ * @s: solution.
+ * @v: vertex to add.
+ * */
+static inline void solution_add_v(struct solution *s, unsigned int v)
+{
+	if(!solution_has_v(s, v))
+		__solution_swap_v(s, v, s->n_vertexes++);
+}
+
+
+/**
+ * clear_solution - Remove every edge and vertex of the solution, keeping its
+ * memory.
+ *
+ * @s: solution.
+ * */
+static inline void clear_solution(struct solution *s)
+{
+	s->w = 0u;
+	s->n_edges = 0u;
+	s->n_vertexes = 0u;
+}
+
+
+/**
+ * solution_del_v - Remove the vertex v from the vertexes of the solution. The
+ * edges are left untouched.
+ *
+ * @s: solution.
+ * @v: vertex to remove.
+ * */
+static inline void solution_del_v(struct solution *s, unsigned int v)
+{
+	if(solution_has_v(s, v))
+		__solution_swap_v(s, v, --s->n_vertexes);
+}
+
+
+/**
+ * The weight of a solution is cached in its w field and kept up to date by
+ * the operators in O(1) per changed edge, with the helpers below, rather
+ * than summed again over the whole tree. Builds with -DFITNESS_CHECK, see the
+ * debug target of the Makefile, recompute it after each operator through
+ * check_solution_weight(), which costs nothing otherwise.
+ * */
+
+/**
+ * solution_set_edge - Replace the edge e of the solution by (u, v).
+ *
+ * @s: solution.
+ * @e: index of the edge.
+ * @u: first vertex of the new edge.
+ * @v: second vertex of the new edge.
+ * @old_w: weight of the replaced edge.
+ * @w: weight of the new edge.
+ * */
+static inline void solution_set_edge(struct solution *s, unsigned int e,
+		unsigned int u, unsigned int v, unsigned int old_w,
+		unsigned int w)
+{
+	s->edge[e][0] = u;
+	s->edge[e][1] = v;
+	s->w += w - old_w;
+}
+
+
+/**
+ * solution_del_edge - Remove the edge e of the solution, moving the last edge
+ * in its place. The vertexes are left untouched.
+ *
+ * @s: solution.
+ * @e: index of the edge.
+ * @w: weight of the edge.
+ * */
+static inline void solution_del_edge(struct solution *s, unsigned int e,
+		unsigned int w)
+{
+	s->n_edges--;
+	s->edge[e][0] = s->edge[s->n_edges][0];
+	s->edge[e][1] = s->edge[s->n_edges][1];
+	s->w -= w;
+}
+
+
+#ifdef FITNESS_CHECK
+void __check_solution_weight(const struct stein *stein,
+		const struct solution *s, const char *caller);
+#define check_solution_weight(stein, s) \
+	__check_solution_weight(stein, s, __func__)
+#else
+#define check_solution_weight(stein, s) do { } while(0)
+#endif
+
+
 
 /**
  * Defines a common variable statically linked to a specific region,
@@ -72,11 +442,32 @@ struct stein *get_stein();
 
 /**
  * alloc_adj_m - Allocate memory for the adjacency matrix acording to the values
- * of n_nodes and n_edges.
+ * of n_nodes and n_edges. All the cells start as W_INF. Complete graphs with
+ * at least TRIANGLE_MIN_NODES nodes get the ADJ_TRIANGLE layout, and sparse
+ * graphs (see CSR_DENSITY_RATIO) the ADJ_CSR layout.
  * */
 void alloc_adj_m();
 
 
+/**
+ * fill_csr - Fill the arrays of the ADJ_CSR layout from the list of edges.
+ *
+ * @edges: n_edges triples (u, v, w), where u and v are vertexes of the edge
+ * and w its weight.
+ * */
+int fill_csr(const unsigned int (*edges)[3]);
+
+
+/**
+ * compact_adj_m - Narrow the adjacency matrix cells to uint16_t when every
+ * weight fits, releasing the memory left unused at the end of the matrix.
+ * It is a no-op when the program is compiled with -DNO_COMPACT_WEIGHTS.
+ *
+ * @max_w: greatest edge weight set in the matrix.
+ * */
+void compact_adj_m(unsigned int max_w);
+
+
 /**
  * alloc_terminals - Allocate memory for the terminals vector acording 
  * to the value of n_terminals.
@@ -91,52 +482,77 @@ void free_stein();
 
 
 /**
- * alloc_solution - Allocate memory for the solution and its edge.
+ * init_solution - Initialize an empty solution, which holds no memory until
+ * reserve_solution() is called.
+ *
+ * @s: solution to initialize.
  * */
-struct solution *alloc_solution();
+void init_solution(struct solution *s);
 
 
 /**
- * alloc_population - Allocate memory for a population.
+ * reserve_solution - Make room in the solution for n_edges edges, allocating
+ * its vertex set on the first call. The edges already in the solution are
+ * kept. Returns an error number (!= 0) if there is no memory.
+ *
+ * @s: solution.
+ * @n_edges: number of edges.
+ * @arena: arena of the generation the solution belongs to.
  * */
-struct population *alloc_population();
+int reserve_solution(struct solution *s, unsigned int n_edges,
+		struct arena *arena);
 
 
 /**
- * free_population - iterates over the population list and free its solution and
- * the population struct itself.
+ * add_solution_edge - Append the edge (u, v) of weight w to the solution.
+ * Returns an error number (!= 0) if there is no memory.
  *
- * @head: population list head.
+ * @s: solution.
+ * @u: first vertex of the edge.
+ * @v: second vertex of the edge.
+ * @w: weight of the edge.
+ * @arena: arena of the generation the solution belongs to.
  * */
-void free_population_list(struct list_head *head);
+int add_solution_edge(struct solution *s, unsigned int u, unsigned int v,
+		unsigned int w, struct arena *arena);
 
 
 /**
- * copy_solution - Use this function to create a copy of an entire solution
- * list. It will walk down the solution list allocating a new memory chunk for
- * every solution.
+ * copy_solution - Copy the source solution into dst, reusing the memory of dst
+ * when it is large enough. Returns an error number (!= 0) if there is no
+ * memory.
  *
- * @source: Solution list head to be copied.
- * @s_head: Solution list head for the new solution.
+ * @dst: solution to overwrite.
+ * @source: solution to be copied.
+ * @arena: arena of the generation dst belongs to.
  * */
-void copy_solution(struct list_head *source, struct list_head *s_head);
+int copy_solution(struct solution *dst, const struct solution *source,
+		struct arena *arena);
 
 
 /**
- * solution_has_v - Search for the vertex v in the solution.
+ * alloc_generation - Allocate a generation of size empty individuals.
  *
- * @h: solution list head.
- * @v: vertex to search.
+ * @size: number of individuals.
+ * @n_arenas: number of threads working on the generation, at least 1.
+ * */
+struct generation *alloc_generation(unsigned int size, unsigned int n_arenas);
+
+
+/**
+ * reset_generation - Release every individual of the generation at once,
+ * keeping the memory for the next one.
+ *
+ * @g: generation to reset.
  * */
-int solution_has_v(struct list_head *h, unsigned int v);
+void reset_generation(struct generation *g);
 
 
 /**
- * update_solution_weight - Update the given solution list weight.
+ * free_generation - Free the generation along with its individuals.
  *
- * @s_head: solution list head pointer.
- * @w: new weight.
+ * @g: generation to free.
  * */
-void update_solution_weight(struct list_head *s_head, unsigned int w);
+void free_generation(struct generation *g);
 
 #endif /* _TYPES_H */
@@ -0,0 +1,408 @@
+/**
+ * island.c - Island model of the genetic algorithm: independent populations,
+ * one per thread, which exchange their best individuals every few
+ * generations.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "include/island.h"
+#include "include/rng.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/**
+ * island_default_params - Fill the parameters with the compile time defaults.
+ *
+ * @params: parameters to fill.
+ * */
+void island_default_params(struct island_params *params)
+{
+	params->n_islands = ISLANDS;
+	params->interval = MIGRATION_INTERVAL;
+	params->n_migrants = MIGRANTS;
+	params->topology = TOPOLOGY_RING;
+}
+
+
+/**
+ * island_check_params - Validate the parameters of the island model. Returns
+ * an error number (!= 0) if any of them is out of range.
+ *
+ * @p: parameters to check.
+ * */
+int island_check_params(const struct island_params *p)
+{
+	if(p->n_islands == 0) {
+		pr_fatal("There must be at least one island.\n");
+		goto fail_params;
+	}
+	if(p->interval == 0 || p->n_migrants == 0) {
+		pr_fatal("The migration interval and the migrants must be at"
+				" least 1.\n");
+		goto fail_params;
+	}
+	if(p->topology > TOPOLOGY_RANDOM) {
+		pr_fatal("Unknown migration topology.\n");
+		goto fail_params;
+	}
+	return 0;
+
+fail_params:
+	ERRNO = EINVALID_ARGUMENT;
+	return ERRNO;
+}
+
+
+/**
+ * init_link - Allocate the slots of a link, with room for two migrations in
+ * case the destination lags behind. Returns an error number (!= 0) if there
+ * is no memory.
+ * */
+static int init_link(struct island_link *l, unsigned int n_migrants)
+{
+	unsigned int i;
+
+	spsc_init(&l->q, 2 * n_migrants);
+	if(!(l->slot = malloc(sizeof(*l->slot) * spsc_capacity(&l->q)))) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	for(i = 0; i < spsc_capacity(&l->q); i++) {
+		arena_init(&l->slot[i].arena, 0);
+		init_solution(&l->slot[i].s);
+	}
+	return 0;
+}
+
+
+/**
+ * free_link - Free the slots of a link.
+ * */
+static void free_link(struct island_link *l)
+{
+	unsigned int i;
+
+	if(!l->slot)
+		return;
+	for(i = 0; i < spsc_capacity(&l->q); i++)
+		arena_destroy(&l->slot[i].arena);
+	free(l->slot);
+	l->slot = NULL;
+}
+
+
+/**
+ * archipelago_init - Validate the parameters, and allocate the islands and
+ * their links. The populations are created by archipelago_run(), on the
+ * thread of their island. Returns an error number (!= 0) on failure.
+ *
+ * @a: archipelago to initialize.
+ * @stein: stein structure with the graph representation.
+ * @ga_params: parameters of the engine of every island.
+ * @params: parameters of the island model.
+ * */
+int archipelago_init(struct archipelago *a, struct stein *stein,
+		const struct ga_params *ga_params,
+		const struct island_params *params)
+{
+	unsigned int i, j, n = params->n_islands;
+	int err;
+
+	memset(a, 0, sizeof(*a));
+	if((err = island_check_params(params)) != 0)
+		return err;
+	if((err = pool_init(&a->pool, n)) != 0)
+		return err;
+
+	a->stein = stein;
+	a->params = *params;
+	a->ga_params = *ga_params;
+	/* The threads are the islands themselves */
+	a->ga_params.n_threads = 1u;
+
+	if(!(a->islands = calloc(n, sizeof(*a->islands)))) {
+		ERRNO = ENOMEM;
+		goto fail_init;
+	}
+	for(i = 0; i < n; i++) {
+		if(!(a->islands[i].in = calloc(n, sizeof(*a->islands[i].in))) ||
+				!(a->islands[i].elite = malloc(
+						sizeof(*a->islands[i].elite) *
+						params->n_migrants))) {
+			ERRNO = ENOMEM;
+			goto fail_init;
+		}
+	}
+
+	/* Link j -> i, where the island i reads what j sends */
+	for(i = 0; i < n; i++) {
+		for(j = 0; j < n; j++) {
+			if(j == i || (params->topology == TOPOLOGY_RING &&
+						i != (j + 1) % n))
+				continue;
+			if((err = init_link(&a->islands[i].in[j],
+							params->n_migrants)) != 0)
+				goto fail_init;
+		}
+	}
+
+	pr_debug("%u islands, %u migrants every %lu generations.\n", n,
+			params->n_migrants, params->interval);
+	return 0;
+
+fail_init:
+	pr_error("Could not allocate the islands. ERRNO=%d\n\n", ERRNO);
+	archipelago_free(a);
+	return ERRNO;
+}
+
+
+/**
+ * select_elite - Write in the elite of the island the positions of its best
+ * individuals, from the best. Returns their number.
+ * */
+static unsigned int select_elite(struct island *isl, unsigned int n_migrants)
+{
+	const struct generation *g = isl->ga.cur;
+	unsigned int i, k, n = 0u;
+
+	/* Insertion into the short sorted list of the best ones so far */
+	for(i = 0; i < g->size; i++) {
+		if(n == n_migrants && g->pop[i].w >=
+				g->pop[isl->elite[n - 1]].w)
+			continue;
+		k = n < n_migrants ? n++ : n - 1;
+		for(; k > 0 && g->pop[isl->elite[k - 1]].w > g->pop[i].w; k--)
+			isl->elite[k] = isl->elite[k - 1];
+		isl->elite[k] = i;
+	}
+	return n;
+}
+
+
+/**
+ * destination - Island the island i sends its migrants to at the generation
+ * g. The random topology draws it from a stream of the seed of the run of its
+ * own, so every island knows where the others send theirs.
+ * */
+static unsigned int destination(const struct archipelago *a, unsigned int i,
+		unsigned long g)
+{
+	unsigned int dst, n_islands = a->params.n_islands;
+	struct rng r;
+
+	if(a->params.topology == TOPOLOGY_RING)
+		return (i + 1) % n_islands;
+
+	rng_split(&r, rng_derive(a->ga_params.seed, UINT64_MAX),
+			(uint64_t)(g / a->params.interval) * n_islands + i);
+	dst = rng_bound(&r, n_islands - 1);
+	return dst + (dst >= i);
+}
+
+
+/**
+ * island_done - Return 1 if the island i has left its generation loop, so
+ * that it neither sends nor receives migrants anymore.
+ * */
+static int island_done(struct archipelago *a, unsigned int i)
+{
+	return __atomic_load_n(&a->islands[i].done, __ATOMIC_ACQUIRE);
+}
+
+
+/**
+ * emigrate - Send copies of the best individuals of the island i to its
+ * destination. While the link is full, the island waits for the destination
+ * to read it, unless it is done or the run is stopped, in which case the
+ * migrants are dropped. Returns an error number (!= 0) if there is no memory.
+ * */
+static int emigrate(struct archipelago *a, unsigned int i)
+{
+	struct island *isl = &a->islands[i];
+	struct island_link *l;
+	struct migrant *m;
+	unsigned int dst, k, n, slot;
+	int err;
+
+	if(a->params.n_islands == 1)
+		return 0;
+	dst = destination(a, i, isl->ga.generation);
+	l = &a->islands[dst].in[i];
+
+	n = select_elite(isl, a->params.n_migrants);
+	for(k = 0; k < n; k++) {
+		while((slot = spsc_back(&l->q)) == SPSC_NONE) {
+			if(island_done(a, dst) ||
+					__atomic_load_n(&a->stop, __ATOMIC_RELAXED))
+				return 0;
+			sched_yield();
+		}
+		m = &l->slot[slot];
+		arena_reset(&m->arena);
+		init_solution(&m->s);
+		if((err = copy_solution(&m->s, &isl->ga.cur->pop[isl->elite[k]],
+						&m->arena)) != 0)
+			return err;
+		spsc_push(&l->q);
+	}
+	return 0;
+}
+
+
+/**
+ * immigrate - Insert into the population of the island i the migrants sent to
+ * it at this generation, in the order of their sources. The island waits for
+ * each of them, unless its source is done or the run is stopped. Returns an
+ * error number (!= 0) if there is no memory.
+ * */
+static int immigrate(struct archipelago *a, unsigned int i)
+{
+	struct island *isl = &a->islands[i];
+	struct island_link *l;
+	unsigned int j, k, n, slot;
+	int err;
+
+	/* Every island sends as many migrants, see select_elite() */
+	n = a->params.n_migrants < a->ga_params.pop_size ?
+		a->params.n_migrants : a->ga_params.pop_size;
+
+	for(j = 0; j < a->params.n_islands; j++) {
+		l = &isl->in[j];
+		if(!l->slot || destination(a, j, isl->ga.generation) != i)
+			continue;
+		for(k = 0; k < n; k++) {
+			/* A source publishes its last migrants before it is
+			 * done, so the queue is checked once more after */
+			while((slot = spsc_front(&l->q)) == SPSC_NONE) {
+				if(__atomic_load_n(&a->stop, __ATOMIC_RELAXED))
+					return 0;
+				if(island_done(a, j) &&
+						(slot = spsc_front(&l->q)) ==
+						SPSC_NONE)
+					break;
+				sched_yield();
+			}
+			if(slot == SPSC_NONE)
+				break;
+			err = ga_immigrate(&isl->ga, &l->slot[slot].s);
+			spsc_pop(&l->q);
+			if(err != 0)
+				return err;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * run_island - Run the engine of the island i, migrating every interval
+ * generations, until its stopping rules hold or another island stops them
+ * all. The engine draws from the stream i of the seed of the run.
+ * */
+static void run_island(void *arg, unsigned int i, unsigned int thread)
+{
+	struct archipelago *a = arg;
+	struct island *isl = &a->islands[i];
+	struct ga *ga = &isl->ga;
+	struct ga_params params = a->ga_params;
+	unsigned int target_w = params.target_w;
+	int err;
+
+	params.seed = rng_derive(a->ga_params.seed, i);
+	params.island = i;
+	if((err = ga_init(ga, a->stein, &params)) != 0)
+		goto fail_island;
+
+	while(!ga_done(ga) && !__atomic_load_n(&a->stop, __ATOMIC_RELAXED)) {
+		if((err = ga_step(ga)) != 0)
+			goto fail_island;
+		if(ga->generation % a->params.interval != 0)
+			continue;
+		if((err = emigrate(a, i)) != 0 || (err = immigrate(a, i)) != 0)
+			goto fail_island;
+	}
+
+	__atomic_store_n(&isl->done, 1, __ATOMIC_RELEASE);
+	if((target_w > 0 && ga_best(ga)->w <= target_w) || ga_within_gap(ga))
+		__atomic_store_n(&a->stop, 1, __ATOMIC_RELAXED);
+	pr_debug("Island %u: %lu generations, best weight %u.\n", i,
+			ga->generation, ga_best(ga)->w);
+	return;
+
+fail_island:
+	pr_error("Island %u has failed. ERRNO=%d\n\n", i, err);
+	isl->err = err;
+	__atomic_store_n(&isl->done, 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&a->stop, 1, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * archipelago_run - Run every island on its own thread until the stopping
+ * rules of the engine hold for all of them, or until one of them reaches the
+ * target weight or the gap to the lower bound. Returns an error number (!= 0)
+ * on failure.
+ *
+ * @a: archipelago.
+ * */
+int archipelago_run(struct archipelago *a)
+{
+	unsigned int i;
+
+	pool_run(&a->pool, run_island, a, a->params.n_islands);
+	for(i = 0; i < a->params.n_islands; i++) {
+		if(a->islands[i].err != 0)
+			return a->islands[i].err;
+	}
+	return 0;
+}
+
+
+/**
+ * archipelago_best - Return the best individual found by the islands.
+ *
+ * @a: archipelago, after archipelago_run().
+ * */
+const struct solution *archipelago_best(const struct archipelago *a)
+{
+	const struct solution *best = NULL, *s;
+	unsigned int i;
+
+	for(i = 0; i < a->params.n_islands; i++) {
+		s = ga_best(&a->islands[i].ga);
+		if(!best || s->w < best->w)
+			best = s;
+	}
+	return best;
+}
+
+
+/**
+ * archipelago_free - Free the islands and their links.
+ *
+ * @a: archipelago.
+ * */
+void archipelago_free(struct archipelago *a)
+{
+	unsigned int i, j;
+
+	for(i = 0; a->islands && i < a->params.n_islands; i++) {
+		struct island *isl = &a->islands[i];
+
+		/* A failed ga_init() has already freed its engine */
+		if(isl->ga.cur)
+			ga_free(&isl->ga);
+		for(j = 0; isl->in && j < a->params.n_islands; j++)
+			free_link(&isl->in[j]);
+		free(isl->in);
+		free(isl->elite);
+	}
+	free(a->islands);
+	pool_free(&a->pool);
+	memset(a, 0, sizeof(*a));
+}
@@ -0,0 +1,799 @@
+/**
+ * localsearch.c - Local search on the Steiner vertexes of a tree: key-path
+ * exchange, key-vertex elimination and vertex insertion, until no move
+ * improves the tree.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/localsearch.h"
+#include "include/heap.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/* No arc, or no vertex */
+#define LS_NIL UINT_MAX
+
+/* Flags of the vertexes */
+#define LS_TREE 1
+#define LS_TERMINAL 2
+/* Removed by the move under evaluation */
+#define LS_CUT 4
+
+
+/**
+ * alloc_adj - Allocate adjacency lists for the trees of n vertexes. Returns 1
+ * if there is no memory.
+ * */
+static int alloc_adj(struct ls_adj *adj, unsigned int n)
+{
+	adj->head = malloc(sizeof(*adj->head) * n);
+	adj->next = malloc(sizeof(*adj->next) * 2 * n);
+	adj->to = malloc(sizeof(*adj->to) * 2 * n);
+	adj->deg = malloc(sizeof(*adj->deg) * n);
+	adj->gone = calloc(n, 1);
+	return !adj->head || !adj->next || !adj->to || !adj->deg || !adj->gone;
+}
+
+
+/**
+ * free_adj - Free the adjacency lists.
+ * */
+static void free_adj(struct ls_adj *adj)
+{
+	free(adj->head);
+	free(adj->next);
+	free(adj->to);
+	free(adj->deg);
+	free(adj->gone);
+}
+
+
+/**
+ * ls_free - Free the memory of the search.
+ *
+ * @ls: state of the search.
+ * */
+void ls_free(struct ls *ls)
+{
+	free(ls->cur.e);
+	free(ls->cand.e);
+	free(ls->best.e);
+	free_adj(&ls->adj);
+	free_adj(&ls->cand_adj);
+	free(ls->tv);
+	free(ls->flag);
+	free(ls->root_up);
+	free(ls->depth);
+	free(ls->up);
+	free(ls->queue);
+	free(ls->mark);
+	free(ls->dist);
+	free(ls->pred);
+	free(ls->touched);
+	if(ls->heap.v)
+		heap_free(&ls->heap);
+	free(ls->list);
+	free(ls->near);
+	free(ls->table);
+	memset(ls, 0, sizeof(*ls));
+}
+
+
+/**
+ * ls_init - Allocate the memory of the search, which is O(V). A tree never
+ * has more than V - 1 edges, nor does any tree built by a move before its
+ * leaves are pruned. Returns an error number (!= 0) if there is no memory.
+ *
+ * @ls: state of the search.
+ * @stein: stein structure with the graph representation.
+ * */
+int ls_init(struct ls *ls, struct stein *stein)
+{
+	unsigned int n = stein->n_nodes, i;
+
+	memset(ls, 0, sizeof(*ls));
+	ls->stein = stein;
+
+	if(!(ls->cur.e = malloc(sizeof(*ls->cur.e) * n)) ||
+			!(ls->cand.e = malloc(sizeof(*ls->cand.e) * n)) ||
+			!(ls->best.e = malloc(sizeof(*ls->best.e) * n)) ||
+			alloc_adj(&ls->adj, n) || alloc_adj(&ls->cand_adj, n) ||
+			!(ls->tv = malloc(sizeof(*ls->tv) * n)) ||
+			!(ls->flag = calloc(n, 1)) ||
+			!(ls->root_up = malloc(sizeof(*ls->root_up) * n)) ||
+			!(ls->depth = malloc(sizeof(*ls->depth) * n)) ||
+			!(ls->up = malloc(sizeof(*ls->up) * n)) ||
+			!(ls->queue = malloc(sizeof(*ls->queue) * n)) ||
+			!(ls->mark = calloc(n, sizeof(*ls->mark))) ||
+			!(ls->dist = malloc(sizeof(*ls->dist) * n)) ||
+			!(ls->pred = malloc(sizeof(*ls->pred) * n)) ||
+			!(ls->touched = malloc(sizeof(*ls->touched) * n)) ||
+			heap_init(&ls->heap, n, ls->dist) != 0 ||
+			!(ls->list = malloc(sizeof(*ls->list) * n)) ||
+			!(ls->near = malloc(sizeof(*ls->near) * n)) ||
+			!(ls->table = malloc(sizeof(*ls->table) * LS_MAX_DEGREE *
+					LS_MAX_DEGREE))) {
+		ls_free(ls);
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+
+	for(i = 0; i < stein->n_terminals; i++)
+		ls->flag[stein->terminals[i]] |= LS_TERMINAL;
+	memset(ls->dist, 0xff, sizeof(*ls->dist) * n);
+	return 0;
+}
+
+
+/**
+ * build_adj - Build the adjacency lists of the tree t. Only the vertexes of
+ * the tree are touched.
+ * */
+static void build_adj(struct ls_adj *adj, const struct ls_tree *t)
+{
+	unsigned int i, a, u, v;
+
+	for(i = 0; i < t->m; i++) {
+		adj->head[t->e[i][0]] = adj->head[t->e[i][1]] = LS_NIL;
+		adj->deg[t->e[i][0]] = adj->deg[t->e[i][1]] = 0u;
+	}
+	for(i = 0; i < t->m; i++) {
+		u = t->e[i][0];
+		v = t->e[i][1];
+		a = 2 * i;
+		adj->to[a] = v;
+		adj->next[a] = adj->head[u];
+		adj->head[u] = a;
+		adj->to[a + 1] = u;
+		adj->next[a + 1] = adj->head[v];
+		adj->head[v] = a + 1;
+		adj->deg[u]++;
+		adj->deg[v]++;
+	}
+}
+
+
+/**
+ * visit - Visit the part of the tree reachable from root without crossing the
+ * removed edges nor the cut vertexes, marking the vertexes with the current
+ * stamp. The vertexes are left in the queue, and up holds the arc each one
+ * was reached by. Returns their number.
+ * */
+static unsigned int visit(struct ls *ls, const struct ls_adj *adj,
+		unsigned int root)
+{
+	unsigned int head = 0u, tail = 0u, x, y, a;
+
+	ls->mark[root] = ls->stamp;
+	ls->up[root] = LS_NIL;
+	ls->queue[tail++] = root;
+	while(head < tail) {
+		x = ls->queue[head++];
+		for(a = adj->head[x]; a != LS_NIL; a = adj->next[a]) {
+			y = adj->to[a];
+			if(ls->mark[y] == ls->stamp || adj->gone[a >> 1] ||
+					(ls->flag[y] & LS_CUT))
+				continue;
+			ls->mark[y] = ls->stamp;
+			ls->up[y] = a;
+			ls->queue[tail++] = y;
+		}
+	}
+	return tail;
+}
+
+
+/**
+ * prune - Remove the Steiner leaves of the tree t, one after the other, and
+ * compute its weight.
+ * */
+static void prune(struct ls *ls, struct ls_tree *t)
+{
+	struct ls_adj *adj = &ls->cand_adj;
+	unsigned int i, k, n_q = 0u, x, y, a;
+
+	build_adj(adj, t);
+	for(i = 0; i < t->m; i++) {
+		for(k = 0; k < 2; k++) {
+			x = t->e[i][k];
+			if(adj->deg[x] == 1 && !(ls->flag[x] & LS_TERMINAL))
+				ls->queue[n_q++] = x;
+		}
+	}
+
+	while(n_q > 0) {
+		x = ls->queue[--n_q];
+		for(a = adj->head[x]; a != LS_NIL && adj->gone[a >> 1];
+				a = adj->next[a])
+			;
+		if(a == LS_NIL)
+			continue;
+		adj->gone[a >> 1] = 1;
+		adj->deg[x]--;
+		y = adj->to[a];
+		if(--adj->deg[y] == 1 && !(ls->flag[y] & LS_TERMINAL))
+			ls->queue[n_q++] = y;
+	}
+
+	t->w = 0ul;
+	for(i = k = 0; i < t->m; i++) {
+		if(adj->gone[i]) {
+			adj->gone[i] = 0;
+			continue;
+		}
+		if(k != i)
+			memcpy(t->e[k], t->e[i], sizeof(*t->e));
+		t->w += t->e[k++][2];
+	}
+	t->m = k;
+}
+
+
+/**
+ * copy_tree - Copy the tree src into dst.
+ * */
+static void copy_tree(struct ls_tree *dst, const struct ls_tree *src)
+{
+	memcpy(dst->e, src->e, sizeof(*src->e) * src->m);
+	dst->m = src->m;
+	dst->w = src->w;
+}
+
+
+/**
+ * set_current - Make t the current tree, mark its vertexes and root it.
+ * */
+static void set_current(struct ls *ls, const struct ls_tree *t)
+{
+	unsigned int i, k, x, a, n_x;
+
+	for(i = 0; i < ls->n_tv; i++)
+		ls->flag[ls->tv[i]] &= ~LS_TREE;
+	ls->n_tv = 0u;
+
+	copy_tree(&ls->cur, t);
+	for(i = 0; i < t->m; i++) {
+		for(k = 0; k < 2; k++) {
+			x = t->e[i][k];
+			if(!(ls->flag[x] & LS_TREE)) {
+				ls->flag[x] |= LS_TREE;
+				ls->tv[ls->n_tv++] = x;
+			}
+		}
+	}
+	build_adj(&ls->adj, &ls->cur);
+	if(ls->n_tv == 0)
+		return;
+
+	ls->stamp++;
+	n_x = visit(ls, &ls->adj, ls->tv[0]);
+	for(i = 0; i < n_x; i++) {
+		x = ls->queue[i];
+		a = ls->root_up[x] = ls->up[x];
+		ls->depth[x] = a == LS_NIL ? 0u :
+			ls->depth[ls->adj.to[a ^ 1]] + 1;
+	}
+}
+
+
+/**
+ * offer - Prune the candidate tree and keep it if it is the best one of the
+ * pass. Returns 1 if the pass is over, in the first improvement mode.
+ * */
+static int offer(struct ls *ls)
+{
+	prune(ls, &ls->cand);
+	if(ls->cand.w >= ls->best.w)
+		return 0;
+	copy_tree(&ls->best, &ls->cand);
+	return ls->mode == LS_FIRST;
+}
+
+
+/**
+ * add_cand_edge - Append the edge (u, v) of weight w to the candidate tree.
+ * */
+static void add_cand_edge(struct ls *ls, unsigned int u, unsigned int v,
+		unsigned int w)
+{
+	unsigned int *e = ls->cand.e[ls->cand.m++];
+
+	e[0] = u;
+	e[1] = v;
+	e[2] = w;
+	ls->cand.w += w;
+}
+
+
+/**
+ * connect_parts - Dijkstra from the part of the tree visited with the current
+ * stamp, left in the queue, to the rest of the tree. The path may only cross
+ * vertexes out of the tree, or cut from it. Returns the first vertex of the
+ * rest of the tree reached at a distance below bound, or LS_NIL. The
+ * distances are left for the path to be read, and only reset by the next
+ * call, which costs the vertexes reached rather than O(V).
+ * */
+static unsigned int connect_parts(struct ls *ls, unsigned int n_src,
+		unsigned long bound)
+{
+	const struct stein *stein = ls->stein;
+	const unsigned int *off = NULL, *adj = NULL, *wts = NULL;
+	unsigned int n = stein->n_nodes, found = LS_NIL, i, u, v, e, w;
+	unsigned long d;
+
+	if(stein->layout == ADJ_CSR) {
+		off = csr_off(stein);
+		adj = csr_adj(stein);
+		wts = csr_wts(stein);
+	}
+
+	while(ls->n_touched > 0)
+		ls->dist[ls->touched[--ls->n_touched]] = W_INF;
+	for(i = 0; i < n_src; i++) {
+		u = ls->queue[i];
+		ls->dist[u] = 0u;
+		ls->pred[u] = u;
+		ls->touched[ls->n_touched++] = u;
+		heap_push(&ls->heap, u);
+	}
+
+	while(ls->heap.size > 0) {
+		u = heap_pop(&ls->heap);
+		if((ls->flag[u] & (LS_TREE | LS_CUT)) == LS_TREE &&
+				ls->mark[u] != ls->stamp) {
+			found = u;
+			break;
+		}
+		for(e = off ? off[u] : 0u; e < (off ? off[u + 1] : n); e++) {
+			v = off ? adj[e] : e;
+			w = off ? wts[e] : stein_w(stein, u, v);
+			if(w == W_INF)
+				continue;
+			d = (unsigned long)ls->dist[u] + w;
+			if(d >= bound || d >= ls->dist[v])
+				continue;
+			if(ls->dist[v] == W_INF)
+				ls->touched[ls->n_touched++] = v;
+			ls->dist[v] = d;
+			ls->pred[v] = u;
+			heap_push(&ls->heap, v);
+		}
+	}
+
+	while(ls->heap.size > 0)
+		heap_pop(&ls->heap);
+	return found;
+}
+
+
+/**
+ * is_key - Test whether x ends the key paths through it: a terminal, or a
+ * Steiner vertex of degree other than 2.
+ * */
+static int is_key(const struct ls *ls, unsigned int x)
+{
+	return (ls->flag[x] & LS_TERMINAL) || ls->adj.deg[x] != 2;
+}
+
+
+/**
+ * try_key_path - Evaluate the exchange of the key path from x to y, of n_arcs
+ * arcs in the list and of weight wp, for the shortest path joining the two
+ * parts of the tree it leaves. The search starts from the smaller part.
+ * Returns 1 if the pass is over.
+ * */
+static int try_key_path(struct ls *ls, unsigned int x, unsigned int y,
+		unsigned int n_arcs, unsigned long wp)
+{
+	struct ls_adj *adj = &ls->adj;
+	unsigned int i, v, n_src;
+	int done = 0;
+
+	for(i = 0; i < n_arcs; i++) {
+		adj->gone[ls->list[i] >> 1] = 1;
+		if(i + 1 < n_arcs)
+			ls->flag[adj->to[ls->list[i]]] |= LS_CUT;
+	}
+
+	ls->stamp++;
+	n_src = visit(ls, adj, x);
+	if(2 * n_src > ls->n_tv - (n_arcs - 1)) {
+		ls->stamp++;
+		n_src = visit(ls, adj, y);
+	}
+	if((v = connect_parts(ls, n_src, wp)) != LS_NIL) {
+		ls->cand.m = 0u;
+		ls->cand.w = 0ul;
+		for(i = 0; i < ls->cur.m; i++) {
+			if(!adj->gone[i])
+				add_cand_edge(ls, ls->cur.e[i][0], ls->cur.e[i][1],
+						ls->cur.e[i][2]);
+		}
+		for(; ls->pred[v] != v; v = ls->pred[v])
+			add_cand_edge(ls, ls->pred[v], v, ls->dist[v] -
+					ls->dist[ls->pred[v]]);
+	}
+
+	for(i = 0; i < n_arcs; i++) {
+		adj->gone[ls->list[i] >> 1] = 0;
+		ls->flag[adj->to[ls->list[i]]] &= ~LS_CUT;
+	}
+	if(v != LS_NIL)
+		done = offer(ls);
+	return done;
+}
+
+
+/**
+ * exchange_key_paths - Try to exchange every key path of the current tree.
+ * Returns 1 if the pass is over.
+ * */
+static int exchange_key_paths(struct ls *ls)
+{
+	const struct ls_adj *adj = &ls->adj;
+	unsigned int i, n_arcs, x, y, a, a0;
+	unsigned long wp;
+
+	for(i = 0; i < ls->n_tv; i++) {
+		x = ls->tv[i];
+		if(!is_key(ls, x))
+			continue;
+		for(a0 = adj->head[x]; a0 != LS_NIL; a0 = adj->next[a0]) {
+			/* Walk through the Steiner vertexes of degree 2 */
+			n_arcs = 0u;
+			wp = 0ul;
+			for(a = a0;; ) {
+				ls->list[n_arcs++] = a;
+				wp += ls->cur.e[a >> 1][2];
+				if(is_key(ls, y = adj->to[a]))
+					break;
+				a = adj->head[y] == (a ^ 1) ? adj->next[a ^ 1] :
+					adj->head[y];
+			}
+			/* Each path is found from both of its ends */
+			if(y < x)
+				continue;
+			if(try_key_path(ls, x, y, n_arcs, wp))
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * try_elimination - Evaluate the elimination of the Steiner vertex v, of
+ * degree k, the parts of the tree it leaves being reconnected by Prim over
+ * the cheapest edge between each two of them. Returns 1 if the pass is over.
+ * */
+static int try_elimination(struct ls *ls, unsigned int v, unsigned int k)
+{
+	const struct stein *stein = ls->stein;
+	const struct ls_adj *adj = &ls->adj;
+	const unsigned int *off = NULL, *nbr = NULL, *wts = NULL;
+	unsigned int *part = ls->list, i, j, p, q, n_x, x, y, a, e, w;
+	unsigned int key[LS_MAX_DEGREE], from[LS_MAX_DEGREE];
+	unsigned char in[LS_MAX_DEGREE];
+	unsigned long gain = 0ul, cost = 0ul;
+	struct ls_link *l;
+
+	if(stein->layout == ADJ_CSR) {
+		off = csr_off(stein);
+		nbr = csr_adj(stein);
+		wts = csr_wts(stein);
+	}
+
+	ls->flag[v] |= LS_CUT;
+	ls->stamp++;
+	for(a = adj->head[v], p = 0u; a != LS_NIL; a = adj->next[a], p++) {
+		n_x = visit(ls, adj, adj->to[a]);
+		for(i = 0; i < n_x; i++)
+			part[ls->queue[i]] = p;
+		gain += ls->cur.e[a >> 1][2];
+	}
+	ls->flag[v] &= ~LS_CUT;
+
+	for(i = 0; i < k * k; i++)
+		ls->table[i].w = W_INF;
+	for(i = 0; i < ls->n_tv; i++) {
+		if((x = ls->tv[i]) == v)
+			continue;
+		n_x = off ? off[x + 1] - off[x] : ls->n_tv;
+		for(j = 0; j < n_x; j++) {
+			y = off ? nbr[off[x] + j] : ls->tv[j];
+			if(y == v || !(ls->flag[y] & LS_TREE) || part[x] >= part[y])
+				continue;
+			w = off ? wts[off[x] + j] : stein_w(stein, x, y);
+			l = &ls->table[part[x] * k + part[y]];
+			if(w < l->w) {
+				l->w = w;
+				l->u = x;
+				l->v = y;
+			}
+		}
+	}
+
+	/* Prim on the k parts */
+	memset(in, 0, k);
+	in[0] = 1;
+	for(q = 1; q < k; q++) {
+		key[q] = ls->table[q].w;
+		from[q] = 0u;
+	}
+	for(i = 1; i < k; i++) {
+		for(q = 1, p = 0u; q < k; q++) {
+			if(!in[q] && (p == 0 || key[q] < key[p]))
+				p = q;
+		}
+		if(key[p] == W_INF || (cost += key[p]) >= gain)
+			return 0;
+		in[p] = 1;
+		for(q = 1; q < k; q++) {
+			e = p < q ? p * k + q : q * k + p;
+			if(!in[q] && ls->table[e].w < key[q]) {
+				key[q] = ls->table[e].w;
+				from[q] = p;
+			}
+		}
+	}
+
+	ls->cand.m = 0u;
+	ls->cand.w = 0ul;
+	for(i = 0; i < ls->cur.m; i++) {
+		if(ls->cur.e[i][0] != v && ls->cur.e[i][1] != v)
+			add_cand_edge(ls, ls->cur.e[i][0], ls->cur.e[i][1],
+					ls->cur.e[i][2]);
+	}
+	for(q = 1; q < k; q++) {
+		p = from[q];
+		l = &ls->table[p < q ? p * k + q : q * k + p];
+		add_cand_edge(ls, l->u, l->v, l->w);
+	}
+	return offer(ls);
+}
+
+
+/**
+ * eliminate_key_vertexes - Try to eliminate every Steiner vertex of degree 3
+ * to LS_MAX_DEGREE of the current tree. Returns 1 if the pass is over.
+ * */
+static int eliminate_key_vertexes(struct ls *ls)
+{
+	unsigned int i, v, k;
+
+	for(i = 0; i < ls->n_tv; i++) {
+		v = ls->tv[i];
+		k = ls->adj.deg[v];
+		if((ls->flag[v] & LS_TERMINAL) || k < 3 || k > LS_MAX_DEGREE)
+			continue;
+		if(try_elimination(ls, v, k))
+			return 1;
+	}
+	return 0;
+}
+
+
+/**
+ * cmp_link - Order the edges by weight, and then by their vertexes, so the
+ * search does not depend on the qsort implementation.
+ * */
+static int cmp_link(const void *a, const void *b)
+{
+	const struct ls_link *la = a, *lb = b;
+
+	if(la->w != lb->w)
+		return la->w < lb->w ? -1 : 1;
+	return la->u < lb->u ? -1 : la->u > lb->u;
+}
+
+
+/**
+ * max_on_path - Return the index of the heaviest edge on the path of the
+ * candidate tree from x up to the root of the last visit.
+ * */
+static unsigned int max_on_path(struct ls *ls, unsigned int x)
+{
+	const struct ls_adj *adj = &ls->cand_adj;
+	unsigned int a, max = LS_NIL;
+
+	for(; (a = ls->up[x]) != LS_NIL; x = adj->to[a ^ 1]) {
+		if(max == LS_NIL || ls->cand.e[a >> 1][2] > ls->cand.e[max][2])
+			max = a >> 1;
+	}
+	return max;
+}
+
+
+/**
+ * max_on_cur_path - Return the weight of the heaviest edge on the path of the
+ * current tree between x and y, 0 if they are the same vertex.
+ * */
+static unsigned int max_on_cur_path(const struct ls *ls, unsigned int x,
+		unsigned int y)
+{
+	unsigned int a, t, max = 0u;
+
+	while(x != y) {
+		if(ls->depth[x] < ls->depth[y]) {
+			t = x;
+			x = y;
+			y = t;
+		}
+		a = ls->root_up[x];
+		if(ls->cur.e[a >> 1][2] > max)
+			max = ls->cur.e[a >> 1][2];
+		x = ls->adj.to[a ^ 1];
+	}
+	return max;
+}
+
+
+/**
+ * try_insertion - Evaluate the insertion of the vertex v: it is joined to the
+ * tree by its cheapest edge, and each of its other edges to the tree, from
+ * the cheapest, replaces the heaviest edge of the cycle it closes, if it is
+ * lighter. Returns 1 if the pass is over.
+ * */
+static int try_insertion(struct ls *ls, unsigned int v)
+{
+	const struct stein *stein = ls->stein;
+	unsigned int i, n_near = 0u, e, u, w, max;
+
+	if(stein->layout == ADJ_CSR) {
+		const unsigned int *off = csr_off(stein), *adj = csr_adj(stein);
+		const unsigned int *wts = csr_wts(stein);
+
+		for(e = off[v]; e < off[v + 1]; e++) {
+			if(ls->flag[adj[e]] & LS_TREE) {
+				ls->near[n_near].w = wts[e];
+				ls->near[n_near++].u = adj[e];
+			}
+		}
+	} else {
+		for(i = 0; i < ls->n_tv; i++) {
+			u = ls->tv[i];
+			if((w = stein_w(stein, v, u)) != W_INF) {
+				ls->near[n_near].w = w;
+				ls->near[n_near++].u = u;
+			}
+		}
+	}
+	/* A leaf would be pruned at once */
+	if(n_near < 2)
+		return 0;
+	qsort(ls->near, n_near, sizeof(*ls->near), cmp_link);
+
+	/* Until an edge replaces one of the tree, the cycles are the paths of
+	 * the current tree from near[0], closed by v, so the tree is only
+	 * copied for the vertexes which do change it */
+	for(i = 1; i < n_near; i++) {
+		if(max_on_cur_path(ls, ls->near[0].u, ls->near[i].u) >
+				ls->near[i].w)
+			break;
+	}
+	if(i == n_near)
+		return 0;
+
+	copy_tree(&ls->cand, &ls->cur);
+	add_cand_edge(ls, v, ls->near[0].u, ls->near[0].w);
+	build_adj(&ls->cand_adj, &ls->cand);
+	ls->stamp++;
+	visit(ls, &ls->cand_adj, v);
+
+	for(; i < n_near; i++) {
+		u = ls->near[i].u;
+		w = ls->near[i].w;
+		max = max_on_path(ls, u);
+		if(w >= ls->cand.e[max][2])
+			continue;
+		ls->cand.w += w - (unsigned long)ls->cand.e[max][2];
+		ls->cand.e[max][0] = v;
+		ls->cand.e[max][1] = u;
+		ls->cand.e[max][2] = w;
+		/* The paths from v have changed */
+		build_adj(&ls->cand_adj, &ls->cand);
+		ls->stamp++;
+		visit(ls, &ls->cand_adj, v);
+	}
+
+	return offer(ls);
+}
+
+
+/**
+ * insert_vertexes - Try to insert every vertex out of the current tree, from
+ * the one after the last vertex inserted, so that the first improvement mode
+ * does not scan the same vertexes again after each move. Returns 1 if the
+ * pass is over.
+ * */
+static int insert_vertexes(struct ls *ls)
+{
+	unsigned int n = ls->stein->n_nodes, i, v;
+
+	for(i = 0, v = ls->cursor; i < n; i++, v = v + 1 < n ? v + 1 : 0u) {
+		if(!(ls->flag[v] & LS_TREE) && try_insertion(ls, v)) {
+			ls->cursor = v + 1 < n ? v + 1 : 0u;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * local_search - Apply improving moves to the tree until there is none left.
+ * The solution is only rewritten if it was improved. Returns an error number
+ * (!= 0) if there is no memory.
+ *
+ * A search leaves its state as it found it but for the vertexes of the last
+ * tree, so the state is only reset for them. The search does not depend on
+ * the ones made before with the same state.
+ *
+ * @stein: stein structure with the graph representation.
+ * @s: solution to improve, a tree spanning the terminals.
+ * @mode: how the move to apply is chosen, nothing is done for LS_NONE.
+ * @state: state of the search, see ls_init(), or NULL to allocate one for
+ * this call.
+ * @arena: arena the edges of the improved tree are allocated from.
+ * */
+int local_search(struct stein *stein, struct solution *s, enum ls_mode mode,
+		struct ls *state, struct arena *arena)
+{
+	struct ls own, *ls = state ? state : &own;
+	unsigned int i;
+	int err = 0;
+
+	if(mode == LS_NONE || s->n_edges == 0)
+		return 0;
+	if(!state && (err = ls_init(&own, stein)) != 0)
+		return err;
+
+	for(i = 0; i < ls->n_tv; i++)
+		ls->flag[ls->tv[i]] &= ~LS_TREE;
+	ls->n_tv = 0u;
+	ls->cursor = 0u;
+	ls->mode = mode;
+
+	/* The stamps would wrap around, the marks start over */
+	if(ls->stamp > UINT_MAX / 2) {
+		memset(ls->mark, 0, sizeof(*ls->mark) * stein->n_nodes);
+		ls->stamp = 0u;
+	}
+
+	ls->cand.m = 0u;
+	ls->cand.w = 0ul;
+	for(i = 0; i < s->n_edges; i++)
+		add_cand_edge(ls, s->edge[i][0], s->edge[i][1],
+				stein_w(stein, s->edge[i][0], s->edge[i][1]));
+	prune(ls, &ls->cand);
+	set_current(ls, &ls->cand);
+
+	for(;;) {
+		ls->best.m = 0u;
+		ls->best.w = ls->cur.w;
+		/* In the best improvement mode, none of them ends the pass */
+		if(!exchange_key_paths(ls) && !eliminate_key_vertexes(ls))
+			insert_vertexes(ls);
+		if(ls->best.w >= ls->cur.w)
+			break;
+		set_current(ls, &ls->best);
+	}
+
+	if(ls->cur.w < s->w) {
+		clear_solution(s);
+		for(i = 0; i < ls->cur.m; i++) {
+			if((err = add_solution_edge(s, ls->cur.e[i][0],
+							ls->cur.e[i][1],
+							ls->cur.e[i][2], arena)) != 0)
+				break;
+		}
+		if(err == 0)
+			check_solution_weight(stein, s);
+	}
+	if(!state)
+		ls_free(&own);
+	return err;
+}
@@ -1,45 +1,975 @@
-
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <limits.h>
+#include <getopt.h>
 
 #include "include/errno.h"
 #include "include/print.h"
 #include "include/misc.h"
+#include "include/rng.h"
 #include "include/file_reader.h"
-#include "include/population.h"
+#include "include/bin_file.h"
+#include "include/ga.h"
+#include "include/island.h"
+#include "include/heuristic.h"
+#include "include/reduce.h"
+#include "include/bound.h"
+#include "include/eventlog.h"
+#include "include/closure.h"
+
+
+/* Options without a short name */
+enum {
+	OPT_STAGNATION = 256,
+	OPT_TARGET,
+	OPT_SELECTION,
+	OPT_REPLACEMENT,
+	OPT_CROSSOVER,
+	OPT_ISLANDS,
+	OPT_INTERVAL,
+	OPT_MIGRANTS,
+	OPT_TOPOLOGY,
+	OPT_MODE,
+	OPT_LOCAL_SEARCH,
+	OPT_LS_COUNT,
+	OPT_NO_REDUCE,
+	OPT_GAP,
+	OPT_LOG,
+	OPT_REPLAY,
+	OPT_CROSSOVER_RATE,
+	OPT_ELITISM,
+	OPT_TOURNAMENT_SIZE,
+	OPT_FORMAT,
+	OPT_CLOSURE,
+	OPT_SPH_ROOTS,
+	OPT_CONFIG
+};
+
+static struct option long_options[] = {
+	{"convert",	required_argument,	NULL, 'c'},
+	{"no-cache",	no_argument,		NULL, 'n'},
+	{"seed",	required_argument,	NULL, 's'},
+	{"generations",	required_argument,	NULL, 'g'},
+	{"time",	required_argument,	NULL, 't'},
+	{"threads",	required_argument,	NULL, 'j'},
+	{"population",	required_argument,	NULL, 'p'},
+	{"mutation-rate", required_argument,	NULL, 'm'},
+	{"crossover-rate", required_argument,	NULL, OPT_CROSSOVER_RATE},
+	{"elitism",	required_argument,	NULL, OPT_ELITISM},
+	{"tournament-size", required_argument,	NULL, OPT_TOURNAMENT_SIZE},
+	{"stagnation",	required_argument,	NULL, OPT_STAGNATION},
+	{"target",	required_argument,	NULL, OPT_TARGET},
+	{"selection",	required_argument,	NULL, OPT_SELECTION},
+	{"replacement",	required_argument,	NULL, OPT_REPLACEMENT},
+	{"crossover",	required_argument,	NULL, OPT_CROSSOVER},
+	{"islands",	required_argument,	NULL, OPT_ISLANDS},
+	{"migration-interval", required_argument, NULL, OPT_INTERVAL},
+	{"migrants",	required_argument,	NULL, OPT_MIGRANTS},
+	{"topology",	required_argument,	NULL, OPT_TOPOLOGY},
+	{"mode",	required_argument,	NULL, OPT_MODE},
+	{"local-search", required_argument,	NULL, OPT_LOCAL_SEARCH},
+	{"ls-count",	required_argument,	NULL, OPT_LS_COUNT},
+	{"sph-roots",	required_argument,	NULL, OPT_SPH_ROOTS},
+	{"no-reduce",	no_argument,		NULL, OPT_NO_REDUCE},
+	{"closure",	no_argument,		NULL, OPT_CLOSURE},
+	{"gap",		required_argument,	NULL, OPT_GAP},
+	{"log",		required_argument,	NULL, OPT_LOG},
+	{"replay",	required_argument,	NULL, OPT_REPLAY},
+	{"format",	required_argument,	NULL, OPT_FORMAT},
+	{"config",	required_argument,	NULL, OPT_CONFIG},
+	{"help",	no_argument,		NULL, 'h'},
+	{NULL, 0, NULL, 0}
+};
+
+
+/* Format of the printed tree */
+enum output_format {
+	/* The format of the instance files, with the bound and the gap */
+	OUTPUT_TEXT,
+	/* A single JSON object, for the scripts collecting the results */
+	OUTPUT_JSON
+};
+
+/* Settings of a run, from the command line and the configuration file */
+struct config {
+	struct ga_params params;
+	struct island_params islands;
+	unsigned long long seed;
+	int use_cache;
+	int heuristic;
+	int reduce;
+	int closure;
+	enum output_format format;
+
+	/* Files given by the options, or NULL */
+	const char *convert;
+	const char *log_path;
+	const char *replay_path;
+
+	/* Text of the configuration file, which its values point into */
+	char *text;
+};
+
+
+/**
+ * usage - Print the command line syntax.
+ *
+ * @name: program name.
+ * */
+static void usage(const char *name)
+{
+	printf("Usage: %s [options] <instance file>\n"
+		"  -h, --help          print this help and exit\n"
+		"      --config=FILE   read the options from FILE, one per line"
+		" as in\n"
+		"                      \"population = 50\"; the options"
+		" after it override it\n"
+		"  -c, --convert=FILE  write the instance in the binary format"
+		" to FILE and exit\n"
+		"  -n, --no-cache      neither read nor write the binary cache"
+		" of the instance\n"
+		"      --no-reduce     solve the instance as it is, without"
+		" the reduction tests\n"
+		"      --closure       search the trees in the metric closure"
+		" of the graph, whose\n"
+		"                      edges are expanded into shortest paths"
+		" in the end\n"
+		"      --mode=M        ga, or heuristic for the best tree of"
+		" Mehlhorn's and of the\n"
+		"                      shortest path heuristics alone, after"
+		" the local search\n"
+		"      --format=F      text, or json for a single JSON object"
+		" with the weight,\n"
+		"                      the bound, the gap and the edges of"
+		" the tree\n"
+		"  -s, --seed=N        seed of the random number generator,"
+		" for reproducible runs\n"
+		"                      whatever the threads\n"
+		"      --log=FILE      record the decisions of the genetic"
+		" algorithm to FILE\n"
+		"      --replay=FILE   run again with the seed and the"
+		" parameters of the log FILE,\n"
+		"                      checking that every decision is"
+		" the same\n"
+		"  -g, --generations=N stop after N generations (default %d)\n"
+		"  -t, --time=SECONDS  stop after the given time\n"
+		"  -j, --threads=N     threads breeding the children"
+		" (default one per CPU)\n"
+		"  -p, --population=N  individuals of the population"
+		" (default %d)\n"
+		"  -m, --mutation-rate=N\n"
+		"                      every edge of a child mutates with"
+		" probability 1/N\n"
+		"                      (default %d)\n"
+		"      --crossover-rate=P\n"
+		"                      probability that a child is bred by"
+		" the crossover rather\n"
+		"                      than copied from a parent"
+		" (default %g)\n"
+		"      --stagnation=N  stop after N generations without"
+		" improvement\n"
+		"      --target=W      stop once a tree of weight W or less is"
+		" found\n"
+		"      --gap=PERCENT   stop once the best tree is within PERCENT"
+		" of the lower\n"
+		"                      bound (default 0: once it is proven"
+		" optimal)\n"
+		"      --selection=S   tournament, roulette or rank\n"
+		"      --tournament-size=N\n"
+		"                      individuals drawn by each tournament"
+		" (default %d)\n"
+		"      --replacement=R generational or steady-state\n"
+		"      --elitism=N     best individuals kept by the"
+		" generational replacement\n"
+		"                      (default %d)\n"
+		"      --crossover=C   uniform or one-point\n"
+		"      --islands=N     run N populations, one per thread,"
+		" with migrations\n"
+		"      --migration-interval=K\n"
+		"                      generations between migrations"
+		" (default %d)\n"
+		"      --migrants=M    individuals sent by each migration"
+		" (default %d)\n"
+		"      --topology=T    ring or random\n"
+		"      --local-search=L\n"
+		"                      none, first or best improvement"
+		" (default first)\n"
+		"      --ls-count=N    best children of each generation"
+		" improved by the local\n"
+		"                      search (default %d)\n"
+		"      --sph-roots=N   roots the shortest path heuristic is"
+		" run from, in\n"
+		"                      parallel, up to one per terminal"
+		" (default %d)\n",
+		name, GA_GENERATIONS, POP_SIZE, MUTATION_RATE,
+		GA_CROSSOVER_RATE, GA_TOURNAMENT_SIZE, GA_ELITISM,
+		MIGRATION_INTERVAL, MIGRANTS, GA_LS_COUNT, SPH_ROOTS);
+}
+
+
+/**
+ * parse_number - Parse a whole non-negative number, returning -1 if arg is
+ * not one.
+ *
+ * @arg: text to parse.
+ * @v: parsed number.
+ * */
+static int parse_number(const char *arg, unsigned long long *v)
+{
+	char *end;
+
+	if(*arg == '\0' || *arg == '-')
+		return -1;
+	*v = strtoull(arg, &end, 0);
+	return *end == '\0' ? 0 : -1;
+}
+
+
+/**
+ * parse_real - Parse a non-negative real number, returning -1 if arg is not
+ * one.
+ *
+ * @arg: text to parse.
+ * @v: parsed number.
+ * */
+static int parse_real(const char *arg, double *v)
+{
+	char *end;
+
+	*v = strtod(arg, &end);
+	return *arg != '\0' && *end == '\0' && *v >= 0.0 ? 0 : -1;
+}
+
+
+/**
+ * default_config - Fill the settings with the compile time defaults, and a
+ * seed from the clock.
+ *
+ * @c: settings to fill.
+ * */
+static void default_config(struct config *c)
+{
+	memset(c, 0, sizeof(*c));
+	ga_default_params(&c->params);
+	island_default_params(&c->islands);
+	c->seed = time_seed();
+	c->use_cache = 1;
+	c->reduce = 1;
+	c->format = OUTPUT_TEXT;
+}
+
+
+/**
+ * set_option - Apply an option to the settings. Returns -1 if it is not an
+ * option, or if its value is not a valid one; the values in range are
+ * checked by check_config().
+ *
+ * @c: settings.
+ * @opt: option, as returned by getopt_long().
+ * @arg: value of the option, or NULL if it takes none.
+ * */
+static int set_option(struct config *c, int opt, const char *arg)
+{
+	struct ga_params *p = &c->params;
+	unsigned long long v;
+
+	switch(opt) {
+	case 'c':
+		c->convert = arg;
+		return 0;
+	case 'n':
+		c->use_cache = 0;
+		return 0;
+	case 's':
+		return parse_number(arg, &c->seed);
+	case 'g':
+		if(parse_number(arg, &v) != 0)
+			return -1;
+		p->max_generations = v;
+		return 0;
+	case 't':
+		return parse_real(arg, &p->time_limit);
+	case 'j':
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->n_threads = v;
+		return 0;
+	case 'p':
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->pop_size = v;
+		return 0;
+	case 'm':
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->mutation_rate = v;
+		return 0;
+	case OPT_CROSSOVER_RATE:
+		return parse_real(arg, &p->crossover_rate);
+	case OPT_ELITISM:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->elitism = v;
+		return 0;
+	case OPT_TOURNAMENT_SIZE:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->tournament_size = v;
+		return 0;
+	case OPT_STAGNATION:
+		if(parse_number(arg, &v) != 0)
+			return -1;
+		p->stagnation = v;
+		return 0;
+	case OPT_TARGET:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->target_w = v;
+		return 0;
+	case OPT_SELECTION:
+		if(!strcmp(arg, "tournament"))
+			p->selection = GA_TOURNAMENT;
+		else if(!strcmp(arg, "roulette"))
+			p->selection = GA_ROULETTE;
+		else if(!strcmp(arg, "rank"))
+			p->selection = GA_RANK;
+		else
+			return -1;
+		return 0;
+	case OPT_REPLACEMENT:
+		if(!strcmp(arg, "generational"))
+			p->replacement = GA_GENERATIONAL;
+		else if(!strcmp(arg, "steady-state"))
+			p->replacement = GA_STEADY_STATE;
+		else
+			return -1;
+		return 0;
+	case OPT_CROSSOVER:
+		if(!strcmp(arg, "uniform"))
+			p->crossover = CROSSOVER_UNIFORM;
+		else if(!strcmp(arg, "one-point"))
+			p->crossover = CROSSOVER_ONE_POINT;
+		else
+			return -1;
+		return 0;
+	case OPT_ISLANDS:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		c->islands.n_islands = v;
+		return 0;
+	case OPT_INTERVAL:
+		if(parse_number(arg, &v) != 0)
+			return -1;
+		c->islands.interval = v;
+		return 0;
+	case OPT_MIGRANTS:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		c->islands.n_migrants = v;
+		return 0;
+	case OPT_TOPOLOGY:
+		if(!strcmp(arg, "ring"))
+			c->islands.topology = TOPOLOGY_RING;
+		else if(!strcmp(arg, "random"))
+			c->islands.topology = TOPOLOGY_RANDOM;
+		else
+			return -1;
+		return 0;
+	case OPT_MODE:
+		if(!strcmp(arg, "ga"))
+			c->heuristic = 0;
+		else if(!strcmp(arg, "heuristic"))
+			c->heuristic = 1;
+		else
+			return -1;
+		return 0;
+	case OPT_LOCAL_SEARCH:
+		if(!strcmp(arg, "none"))
+			p->local_search = LS_NONE;
+		else if(!strcmp(arg, "first"))
+			p->local_search = LS_FIRST;
+		else if(!strcmp(arg, "best"))
+			p->local_search = LS_BEST;
+		else
+			return -1;
+		return 0;
+	case OPT_LS_COUNT:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->ls_count = v;
+		return 0;
+	case OPT_SPH_ROOTS:
+		if(parse_number(arg, &v) != 0 || v > UINT_MAX)
+			return -1;
+		p->sph_roots = v;
+		return 0;
+	case OPT_NO_REDUCE:
+		c->reduce = 0;
+		return 0;
+	case OPT_CLOSURE:
+		c->closure = 1;
+		return 0;
+	case OPT_GAP:
+		return parse_real(arg, &p->max_gap);
+	case OPT_LOG:
+		c->log_path = arg;
+		return 0;
+	case OPT_REPLAY:
+		c->replay_path = arg;
+		return 0;
+	case OPT_FORMAT:
+		if(!strcmp(arg, "text"))
+			c->format = OUTPUT_TEXT;
+		else if(!strcmp(arg, "json"))
+			c->format = OUTPUT_JSON;
+		else
+			return -1;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+
+/**
+ * trim - Cut the white space at both ends of a string, returning its first
+ * character left.
+ * */
+static char *trim(char *s)
+{
+	char *end = s + strlen(s);
+
+	while(isspace((unsigned char)*s))
+		s++;
+	while(end > s && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+	return s;
+}
+
+
+/**
+ * read_config - Apply the options of a configuration file to the settings.
+ * Each line holds an option by its long name, followed by '=' and its value
+ * if it takes one, as in "population = 50" or "no-reduce"; '#' starts a
+ * comment. A configuration file can not include another one. Returns an
+ * error number (!= 0) if the file could not be read or one of its lines is
+ * invalid.
+ *
+ * @c: settings, which keep the text of the file.
+ * @path: configuration file.
+ * */
+static int read_config(struct config *c, const char *path)
+{
+	const struct option *o;
+	char *line, *next, *key, *value, *sep;
+	unsigned int n_line = 0u;
+	FILE *file;
+	long size;
+
+	if(c->text) {
+		pr_fatal("Only one configuration file can be given.\n");
+		ERRNO = EINVALID_ARGUMENT;
+		return ERRNO;
+	}
+	if(!(file = fopen(path, "r"))) {
+		pr_fatal("Could not open the configuration file %s.\n", path);
+		ERRNO = EFILE_NOT_FOUND;
+		return ERRNO;
+	}
+	if(fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+			fseek(file, 0, SEEK_SET) != 0 ||
+			!(c->text = malloc(size + 1)) ||
+			fread(c->text, 1, size, file) != (size_t)size) {
+		pr_fatal("Could not read the configuration file %s.\n", path);
+		fclose(file);
+		ERRNO = EUNEXPECTED_ERROR;
+		return ERRNO;
+	}
+	fclose(file);
+	c->text[size] = '\0';
+
+	for(line = c->text; line; line = next) {
+		n_line++;
+		if((next = strchr(line, '\n')))
+			*next++ = '\0';
+		if((sep = strchr(line, '#')))
+			*sep = '\0';
+		value = NULL;
+		if((sep = strchr(line, '='))) {
+			*sep = '\0';
+			value = trim(sep + 1);
+		}
+		if(*(key = trim(line)) == '\0' && !value)
+			continue;
+
+		for(o = long_options; o->name && strcmp(o->name, key); o++)
+			;
+		if(!o->name || (o->has_arg == required_argument) != !!value ||
+				set_option(c, o->val, value) != 0) {
+			pr_fatal("%s:%u: invalid option \"%s\".\n", path,
+					n_line, key);
+			ERRNO = EINVALID_ARGUMENT;
+			return ERRNO;
+		}
+	}
+	pr_debug("Options read from %s.\n", path);
+	return 0;
+}
+
+
+/**
+ * check_config - Validate the settings before anything is run. Returns an
+ * error number (!= 0) if they are not consistent or out of range.
+ *
+ * @c: settings.
+ * */
+static int check_config(const struct config *c)
+{
+	int err;
+
+	if((c->log_path || c->replay_path) && (c->heuristic || c->convert)) {
+		pr_fatal("Only the runs of the genetic algorithm have a log.\n");
+		goto fail_config;
+	}
+	if(c->log_path && c->replay_path) {
+		pr_fatal("A run can not be logged and replayed at once.\n");
+		goto fail_config;
+	}
+	if((err = ga_check_params(&c->params)) != 0 ||
+			(err = island_check_params(&c->islands)) != 0)
+		return err;
+	return 0;
+
+fail_config:
+	ERRNO = EINVALID_ARGUMENT;
+	return ERRNO;
+}
+
+
+/**
+ * fill_header - Write the seed, the instance and the parameters of the run to
+ * the header of its log.
+ *
+ * @h: header to fill.
+ * @stein: stein structure with the graph representation, before the
+ * reductions.
+ * @c: settings of the run.
+ * */
+static void fill_header(struct event_header *h, const struct stein *stein,
+		const struct config *c)
+{
+	const struct ga_params *p = &c->params;
+
+	memset(h, 0, sizeof(*h));
+	h->seed = c->seed;
+	h->n_nodes = stein->n_nodes;
+	h->n_edges = stein->n_edges;
+	h->n_terminals = stein->n_terminals;
+	h->reduced = c->reduce;
+	h->closure = c->closure;
+	h->max_generations = p->max_generations;
+	h->stagnation = p->stagnation;
+	h->target_w = p->target_w;
+	h->pop_size = p->pop_size;
+	h->mutation_rate = p->mutation_rate;
+	h->crossover = p->crossover;
+	h->crossover_rate = p->crossover_rate;
+	h->selection = p->selection;
+	h->tournament_size = p->tournament_size;
+	h->replacement = p->replacement;
+	h->elitism = p->elitism;
+	h->local_search = p->local_search;
+	h->ls_count = p->ls_count;
+	h->sph_roots = p->sph_roots;
+	h->n_islands = c->islands.n_islands;
+	h->n_migrants = c->islands.n_migrants;
+	h->topology = c->islands.topology;
+	h->interval = c->islands.interval;
+}
+
+
+/**
+ * apply_header - Set the seed and the parameters of the run to the ones of
+ * the log being replayed. The time limit and the gap, which depend on the
+ * timing, are left out: the replay stops where the events of the log end.
+ *
+ * @h: header of the log.
+ * @c: settings of the run.
+ * */
+static void apply_header(const struct event_header *h, struct config *c)
+{
+	struct ga_params *p = &c->params;
+
+	c->seed = h->seed;
+	c->reduce = h->reduced;
+	c->closure = h->closure;
+	p->max_generations = h->max_generations;
+	p->stagnation = h->stagnation;
+	p->target_w = h->target_w;
+	p->time_limit = 0.0;
+	p->pop_size = h->pop_size;
+	p->mutation_rate = h->mutation_rate;
+	p->crossover = h->crossover;
+	p->crossover_rate = h->crossover_rate;
+	p->selection = h->selection;
+	p->tournament_size = h->tournament_size;
+	p->replacement = h->replacement;
+	p->elitism = h->elitism;
+	p->local_search = h->local_search;
+	p->ls_count = h->ls_count;
+	p->sph_roots = h->sph_roots;
+	c->islands.n_islands = h->n_islands;
+	c->islands.n_migrants = h->n_migrants;
+	c->islands.topology = h->topology;
+	c->islands.interval = h->interval;
+}
+
+
+/**
+ * print_solution - Print the tree in the given format, with the vertexes
+ * numbered from 1, and with the lower bound and the gap of the tree to it.
+ * The trees of the closure are expanded to the graph first, and the ones of a
+ * reduced instance to the original graph. Returns an error number (!= 0) if
+ * it could not be expanded, or there is no memory.
+ *
+ * @stein: stein structure with the graph representation.
+ * @red: record of the reductions of the instance, or NULL if it was not
+ * reduced.
+ * @metric: closure the tree was searched in, which is restored, or NULL.
+ * @bound: lower bound of the instance, whose thread is stopped first.
+ * @s: solution to print.
+ * @format: format of the output.
+ * */
+static int print_solution(struct stein *stein, const struct reduction *red,
+		struct closure *metric, struct lower_bound *bound,
+		const struct solution *s, enum output_format format)
+{
+	unsigned int (*edges)[3], n_edges, i;
+	struct solution tree;
+	struct arena arena;
+	unsigned long w;
+	double gap;
+	int err;
+
+	/* The bound reads the graph, which the closure gives back */
+	lower_bound_stop(bound);
+	arena_init(&arena, 0);
+	if(metric) {
+		closure_restore(metric, stein);
+		init_solution(&tree);
+		if((err = closure_expand(stein, metric,
+						(const unsigned int (*)[2])s->edge,
+						s->n_edges, &tree, &arena)) != 0) {
+			pr_error("Could not expand the closure tree."
+					" ERRNO=%d\n\n", err);
+			goto free_tree;
+		}
+		s = &tree;
+	}
+
+	if(red) {
+		if((err = reduction_expand(red, s, &edges, &n_edges)) != 0) {
+			pr_error("Could not expand the tree. ERRNO=%d\n\n",
+					err);
+			goto free_tree;
+		}
+		w = s->w + red->fixed_w;
+	} else {
+		if(!(edges = malloc(sizeof(*edges) * (s->n_edges + 1)))) {
+			err = ENOMEM;
+			goto free_tree;
+		}
+		for(i = 0; i < s->n_edges; i++) {
+			edges[i][0] = s->edge[i][0];
+			edges[i][1] = s->edge[i][1];
+			edges[i][2] = stein_w(stein, s->edge[i][0],
+					s->edge[i][1]);
+		}
+		n_edges = s->n_edges;
+		w = s->w;
+	}
+	gap = lower_bound_gap(bound, s->w);
+
+	if(format == OUTPUT_JSON) {
+		printf("{\"weight\": %lu, \"bound\": %lu, \"gap\": ", w,
+				lower_bound_get(bound));
+		/* JSON has no infinity, which is the gap to a bound of 0 */
+		if(isfinite(gap))
+			printf("%.4f", gap);
+		else
+			printf("null");
+		printf(", \"edges\": [");
+		for(i = 0; i < n_edges; i++)
+			printf("%s[%u, %u, %u]", i > 0 ? ", " : "",
+					edges[i][0] + 1u, edges[i][1] + 1u,
+					edges[i][2]);
+		printf("]}\n");
+	} else {
+		printf("Weight %lu\nEdges %u\n", w, n_edges);
+		for(i = 0; i < n_edges; i++)
+			printf("E %u %u %u\n", edges[i][0] + 1u,
+					edges[i][1] + 1u, edges[i][2]);
+		printf("Bound %lu\nGap %.2f%%\n", lower_bound_get(bound), gap);
+	}
+	free(edges);
+	err = 0;
+
+free_tree:
+	arena_destroy(&arena);
+	return err;
+}
+
+
+/**
+ * run_heuristics - Print the best of the trees of Mehlhorn's heuristic and of
+ * the shortest path heuristic from n_roots roots, improved by the local
+ * search. Returns an error number (!= 0) on failure.
+ *
+ * @stein: stein structure with the graph representation.
+ * @n_threads: threads running the shortest path heuristic, 0 for one per
+ * online CPU.
+ * @n_roots: roots of the shortest path heuristic, up to one per terminal.
+ * @ls: local search applied to the best tree.
+ * @red: record of the reductions of the instance, or NULL.
+ * @metric: closure the trees are searched in, or NULL.
+ * @bound: lower bound of the instance.
+ * @format: format of the output.
+ * */
+static int run_heuristics(struct stein *stein, unsigned int n_threads,
+		unsigned int n_roots, enum ls_mode ls,
+		const struct reduction *red, struct closure *metric,
+		struct lower_bound *bound, enum output_format format)
+{
+	struct generation *g;
+	struct pool pool;
+	unsigned int i, best = 0u;
+	int err;
+
+	if(n_roots > stein->n_terminals)
+		n_roots = stein->n_terminals;
+	if((err = pool_init(&pool, n_threads)) != 0)
+		return err;
+	if(!(g = alloc_generation(1 + n_roots, pool_threads(&pool)))) {
+		pool_free(&pool);
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+
+	/* The first individual is Mehlhorn's tree, the others the ones of the
+	 * shortest path heuristic */
+	if(!mehlhorn(stein, &g->pop[0], &g->arena[0]) || (n_roots > 0 &&
+				multi_root_sph(stein, g->pop + 1, n_roots,
+					g->arena, &pool) != 0)) {
+		ERRNO = EUNEXPECTED_ERROR;
+		goto free_heuristics;
+	}
+	for(i = 1; i <= n_roots; i++) {
+		pr_debug("Shortest path heuristic from the root %u: %u.\n", i,
+				g->pop[i].w);
+		if(g->pop[i].w < g->pop[best].w)
+			best = i;
+	}
+	pr_debug("Mehlhorn: %u, best tree: %u.\n", g->pop[0].w, g->pop[best].w);
+	if((ERRNO = local_search(stein, &g->pop[best], ls, NULL,
+					&g->arena[0])) != 0)
+		goto free_heuristics;
+	pr_debug("After the local search: %u.\n", g->pop[best].w);
+	ERRNO = print_solution(stein, red, metric, bound, &g->pop[best],
+			format);
+
+free_heuristics:
+	free_generation(g);
+	pool_free(&pool);
+	return ERRNO;
+}
+
 
 int main(int argc, char *argv[])
 {
 	char *filename;
+	struct config conf;
+	struct ga_params *params = &conf.params;
 	struct stein *stein_data;
-	struct list_head *p_head = NULL;
+	struct ga ga;
+	struct archipelago archipelago;
+	struct reduction red, *reduced = NULL;
+	struct closure closure, *metric = NULL;
+	struct pool pool;
+	struct lower_bound bound;
+	struct event_header header;
+	struct event_log log, *event_log = NULL;
+	int opt, err;
+
+	default_config(&conf);
 
-	srand(time_seed());
+	/* The options are applied in their order, so the ones after a
+	 * configuration file override it */
+	while((opt = getopt_long(argc, argv, "hc:ns:g:t:j:p:m:", long_options,
+					NULL)) != -1) {
+		if(opt == 'h') {
+			usage(argv[0]);
+			goto free_config;
+		}
+		if(opt == '?') {
+			usage(argv[0]);
+			ERRNO = EUNEXPECTED_ERROR;
+			goto free_config;
+		}
+		if(opt == OPT_CONFIG) {
+			if(read_config(&conf, optarg) != 0)
+				goto free_config;
+		} else if(set_option(&conf, opt, optarg) != 0) {
+			ERRNO = EINVALID_ARGUMENT;
+			pr_fatal("Invalid option value: %s.\n", optarg);
+			usage(argv[0]);
+			goto free_config;
+		}
+	}
 
-	if(!(filename = argv[1])) {
+	if(!(filename = argv[optind])) {
 		ERRNO = EFILENAME_MISSING;
-		pr_error("No filename was provided. Exiting. Error code = %d.\n"
-				, ERRNO);
+		pr_fatal("No filename was provided.\n");
+		usage(argv[0]);
 		goto missing_file;
 	}
 
-	if(!(stein_data = get_stein_from_file(filename)))
+	/* The replay runs with the seed and the parameters of the log */
+	if(conf.replay_path && !conf.log_path) {
+		if((ERRNO = event_log_replay(&log, conf.replay_path,
+						&header)) != 0)
+			goto missing_file;
+		event_log = &log;
+		apply_header(&header, &conf);
+	}
+
+	/* Everything is checked before the instance is read, which may take
+	 * a while */
+	if((ERRNO = check_config(&conf)) != 0)
+		goto close_log;
+
+	rng_seed(get_rng(), conf.seed);
+	params->seed = conf.seed;
+	pr_debug("Random number generator seeded with %llu.\n", conf.seed);
+
+	if(!(stein_data = get_stein_from_file(filename,
+					conf.use_cache && !conf.convert))) {
+		if(ERRNO == 0)
+			ERRNO = EINVALID_FILE_FORMAT;
 		goto reset_stein;
+	}
 
-	if (!(p_head = create_initial_population(stein_data)))
+	/* Converter mode: the source status is not recorded, as the binary
+	 * file is an instance by itself and not a cache. */
+	if(conf.convert) {
+		if(put_stein_to_bin(conf.convert, NULL) != 0) {
+			ERRNO = EUNEXPECTED_ERROR;
+			pr_fatal("Could not write %s.\n", conf.convert);
+		}
 		goto free_population;
+	}
 
-	pr_debug("End of history. Freeing allocated resources. p_head=%p\n",
-			*p_head);
-	free_population_list(p_head);
-	free(p_head);
-	free_stein();
-	return 0;
+	if(conf.replay_path && (header.n_nodes != stein_data->n_nodes ||
+				header.n_edges != stein_data->n_edges ||
+				header.n_terminals != stein_data->n_terminals)) {
+		ERRNO = EINVALID_ARGUMENT;
+		pr_fatal("The log %s was made on another instance.\n",
+				conf.replay_path);
+		goto free_population;
+	}
+	if(conf.log_path) {
+		fill_header(&header, stein_data, &conf);
+		if((ERRNO = event_log_create(&log, conf.log_path,
+						&header)) != 0)
+			goto free_population;
+		event_log = &log;
+	}
+	params->log = event_log;
+
+	/* The trees are searched in the reduced graph, which does not count
+	 * the weight of the fixed edges */
+	if(conf.reduce) {
+		if((ERRNO = reduce_graph(stein_data, &red)) != 0)
+			goto free_population;
+		reduced = &red;
+		if(params->target_w > 0)
+			params->target_w = params->target_w > red.fixed_w ?
+				params->target_w - red.fixed_w : 1u;
+	}
+
+	/* The trees are searched in the metric closure of the graph instead,
+	 * and expanded back to its paths when printed */
+	if(conf.closure) {
+		if((ERRNO = pool_init(&pool, params->n_threads)) != 0)
+			goto free_reduction;
+		ERRNO = closure_init(&closure, stein_data, &pool);
+		pool_free(&pool);
+		if(ERRNO != 0)
+			goto free_reduction;
+		closure_apply(&closure, stein_data);
+		metric = &closure;
+	}
+
+	/* The lower bound is computed while the trees are searched, from the
+	 * one the reductions found. The replay does not stop at the gap, which
+	 * depends on the timing, but where the events of the log end. */
+	if((ERRNO = lower_bound_start(&bound, stein_data,
+					reduced ? red.lb : 0ul,
+					reduced ? red.fixed_w : 0ul)) != 0)
+		goto free_closure;
+	params->bound = conf.replay_path ? NULL : &bound;
+
+	/* Heuristic mode: the constructive heuristics alone, without the GA */
+	if(conf.heuristic) {
+		ERRNO = run_heuristics(stein_data, params->n_threads,
+				params->sph_roots, params->local_search, reduced, metric, &bound,
+				conf.format);
+		goto stop_bound;
+	}
+
+	if(conf.islands.n_islands > 1) {
+		if((ERRNO = archipelago_init(&archipelago, stein_data, params,
+						&conf.islands)) != 0)
+			goto stop_bound;
+		if((ERRNO = archipelago_run(&archipelago)) == 0)
+			ERRNO = print_solution(stein_data, reduced, metric,
+					&bound, archipelago_best(&archipelago),
+					conf.format);
+		archipelago_free(&archipelago);
+		goto stop_bound;
+	}
+
+	if((ERRNO = ga_init(&ga, stein_data, params)) != 0)
+		goto stop_bound;
 
+	if((ERRNO = ga_run(&ga)) == 0)
+		ERRNO = print_solution(stein_data, reduced, metric, &bound,
+				ga_best(&ga), conf.format);
+
+	pr_debug("End of history after %lu generations. Freeing allocated"
+			" resources.\n", ga.generation);
+	ga_free(&ga);
+
+stop_bound:
+	lower_bound_stop(&bound);
+free_closure:
+	if(metric) {
+		closure_restore(metric, stein_data);
+		closure_free(metric);
+	}
+free_reduction:
+	if(reduced)
+		reduction_free(reduced);
 free_population:
 	free_stein();
 reset_stein:
+close_log:
+	if(event_log && (err = event_log_close(event_log)) != 0 && ERRNO == 0)
+		ERRNO = err;
 missing_file:
+free_config:
+	free(conf.text);
 	return -ERRNO;
 }
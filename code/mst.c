@@ -6,181 +6,312 @@
  * */
 
 #include <limits.h>
+#include <string.h>
 
 #include "include/mst.h"
+#include "include/simd.h"
+#include "include/heap.h"
 #include "include/print.h"
 #include "include/errno.h"
 
-static LIST_HEAD(terminal_head);
-static LIST_HEAD(terminal_solution_head);
-static LIST_HEAD(solution_head);
 
 /**
- * This is a temporary structure to store the terminals not yet added to the
- * MST.
- * */
-struct _terminal_list {
-	struct list_head list;
-	unsigned int v;
-};
-
-
-/**
- * create_terminal - Allocate memory for a _terminal_list_t and set the vertex
- * with the given value.
+ * retrieve_sparse_mst - Builds the Steiner tree of a graph in the ADJ_CSR
+ * layout, where the terminals are seldom adjacent to each other. Prim's
+ * algorithm runs with a heap over the whole graph, or over the vertexes marked
+ * in allowed, from a terminal and until every terminal is in the tree, and
+ * then the non-terminal leaves are pruned until every leaf is a terminal. It
+ * takes O(E log V).
  *
- * @value: Value to set in the vertex(v).
+ * @stein: stein structure with the graph representation.
+ * @allowed: vertexes the tree may use, or NULL for every vertex.
+ * @sol: cleared solution where the edges are added.
+ * @scratch: 7 * stein->n_nodes words.
+ * @arena: arena the edges are allocated from.
  * */
-static inline struct _terminal_list *create_terminal(unsigned int value)
+static struct solution *retrieve_sparse_mst(struct stein *stein,
+		const unsigned char *allowed, struct solution *sol,
+		unsigned int *scratch, struct arena *arena)
 {
-	struct _terminal_list *tl;
-	tl = malloc(sizeof(*tl));
-	tl->v = value;
-	return tl;
-}
+	struct heap heap;
+	const unsigned int *off = csr_off(stein), *adj = csr_adj(stein);
+	const unsigned int *wts = csr_wts(stein);
+	unsigned int n = stein->n_nodes, *key, *parent, *children, *order;
+	unsigned int i, k = 0u, found = 0u, root;
+	unsigned char *state;
+
+	/* A vertex is out of the tree, in the tree or pruned from it */
+	enum { V_OUT, V_TREE, V_PRUNED };
+
+	key = scratch;
+	parent = key + n;
+	children = parent + n;
+	order = children + n;
+	heap_init_at(&heap, n, key, order + n);
+	state = (unsigned char *)(order + 3 * (size_t)n);
+	memset(state, 0, 2 * (size_t)n);
+
+	/* The second half of state marks the terminals */
+	for(i = 0; i < stein->n_terminals; i++)
+		state[n + stein->terminals[i]] = 1;
+	for(i = 0; i < n; i++) {
+		key[i] = W_INF;
+		children[i] = 0u;
+	}
 
+	root = stein->terminals[stein->n_terminals - 1];
+	key[root] = 0u;
+	parent[root] = root;
+	heap_push(&heap, root);
 
-/**
- * get_list_from_terminals - Create the linked list with all the given
- * terminals. The list is not ordered.
- * The global variable terminal_list_head is set with the linked list head.
- * Thus this method must be called before operating with the
- * terminal_list_head list.
- *
- * @terminals: The terminals array in the stein struct.
- * @size: the size of the given array.
- * */
-static inline void get_list_from_terminals(unsigned int *terminals,
-		unsigned int size)
-{
-	unsigned int i;
-	struct _terminal_list *err_tl;
+	while(heap.size > 0 && found < stein->n_terminals) {
+		unsigned int u = heap_pop(&heap);
+
+		state[u] = V_TREE;
+		order[k++] = u;
+		found += state[n + u];
+		if(u != root)
+			children[parent[u]]++;
 
-	for(i = 0; i < size; i++) {
-		struct _terminal_list *_tl;
+		for(i = off[u]; i < off[u + 1]; i++) {
+			unsigned int v = adj[i];
 
-		if(!(_tl = create_terminal(terminals[i])))
-			goto free_list;
+			if(state[v] == V_OUT && wts[i] < key[v] &&
+					(!allowed || allowed[v])) {
+				key[v] = wts[i];
+				parent[v] = u;
+				heap_push(&heap, v);
+			}
+		}
+	}
 
-		list_add_tail(&_tl->list, &terminal_head);
+	if(found < stein->n_terminals) {
+		ERRNO = EDISCONNECTED;
+		pr_debug("The terminals are not connected. ERRNO=%d\n", ERRNO);
+		return NULL;
+	}
 
-		pr_debug("Added terminal: %u.\n", terminals[i] + 1u);
+	/* Prune the non-terminal leaves, the vertexes added last first, so a
+	 * pruned parent is always visited after its children. */
+	for(i = k; i-- > 1;) {
+		unsigned int v = order[i];
+
+		if(children[v] == 0 && !state[n + v]) {
+			state[v] = V_PRUNED;
+			children[parent[v]]--;
+		}
 	}
-	return;
-free_list:
-	free_list_entry(&terminal_head, err_tl, list);
-	ERRNO = ENOMEM;
-	return;
+
+	if(reserve_solution(sol, k - 1u, arena) != 0)
+		return NULL;
+	solution_add_v(sol, root);
+	for(i = 1; i < k; i++) {
+		unsigned int v = order[i];
+
+		if(state[v] == V_PRUNED)
+			continue;
+		add_solution_edge(sol, parent[v], v, key[v], arena);
+		pr_debug("Selected edge:(%u, %u), w=%u.\n", parent[v] + 1u,
+				v + 1u, key[v]);
+	}
+	return sol;
 }
 
 
 /**
- * retrieve_mst - Builds a maximum spanning tree with the vertexes in
- * stein->terminals, returning a pointer to the solution list head.
+ * retrieve_dense_mst - Builds the MST of the subgraph induced by the n
+ * vertexes in set, rooted at set[n - 1], and prunes its non-terminal leaves
+ * until every leaf is a terminal.
+ *
+ * The vertexes not yet in the tree are kept packed at the beginning of the
+ * out array, along with the cheapest edge (key) connecting each of them to the
+ * tree and the tree vertex at the other end of that edge (parent). Every
+ * iteration picks the minimum key, swaps the last position into the selected
+ * one and relaxes the keys against the new tree vertex, thus the whole tree is
+ * built in O(n^2) with sequential accesses only. Both scans are done by the
+ * vector kernels of simd.h, over the weights gathered in the row array.
+ *
+ * The edges are added to the tree in order, so a vertex always comes after
+ * its parent, and the leaves are pruned walking them backwards.
  *
  * @stein: stein structure with the graph representation.
+ * @set: vertexes of the tree, with every terminal.
+ * @n: number of vertexes in set, at least 1.
+ * @sol: cleared solution where the edges are added.
+ * @scratch: 8 * stein->n_nodes words.
+ * @arena: arena the edges are allocated from.
  * */
-struct list_head *retrieve_mst(struct stein *stein)
+static struct solution *retrieve_dense_mst(struct stein *stein,
+		const unsigned int *set, unsigned int n, struct solution *sol,
+		unsigned int *scratch, struct arena *arena)
 {
-	struct solution *err_s;
-	struct list_head *t_head, *ts_head, *tmp;
-	unsigned int w_total = 0u;
-
-	pr_debug("Creating terminal list to retrieve the mst.\n", 0);
-
-	/* terminal_list_head is now set */
-	get_list_from_terminals(stein->terminals, stein->n_terminals);
-	error_goto(fail_get_terminals);
-
-	/* ts_head contains all terminals not yet added in the mst
-	 * t_head contains the terminals already added.
-	 * */
-	ts_head = &terminal_head;
-	t_head = &terminal_solution_head;
-
-	pr_debug("List created: size=%u.\n", list_size(ts_head));
-
-	/* Select the first vertex - the last in the list and
-	 * remove it from the not added vertex list. The vertex is then added to
-	 * the solution vertex list. */
-	tmp = ts_head->prev;
-	list_del(ts_head->prev);
-	list_add_tail(tmp, t_head);
-
-	while(ts_head->next != ts_head) {
-		unsigned int v = UINT_MAX;
-		unsigned int min_cost =  UINT_MAX;
-		struct _terminal_list *terminal_out = NULL;
-		struct _terminal_list *terminal_in = NULL;
-		struct _terminal_list *selected_v = NULL;
-		struct _terminal_list *selected_u = NULL;
-		struct solution *s;
-
-
-		/**
-		 * For each vertex added in the MST, it will be searched the
-		 * vertex with minimum cost to be added in the MST.
-		 * */
-		list_for_each_entry(terminal_in, t_head, list) {
-			v = terminal_in->v;
-
-			list_for_each_entry(terminal_out, ts_head, list) {
-				unsigned int u = terminal_out->v;
-				unsigned int w = stein->adj_m[v][u];
-
-				pr_debug("Current data: v=%u; u=%u; w=%u; min_cost=%u\n",
-						v + 1u, u + 1u, w, min_cost);
-
-				/**
-				 * Select the edge with minimum cost in the
-				 * current list.
-				 * */
-				if(w < min_cost) {
-					selected_v = terminal_in;
-					selected_u = terminal_out;
-					min_cost = w;
-				}
-				if(terminal_out->list.next == ts_head) break;
-			}
-			if(terminal_in->list.next == t_head) break;
+	unsigned int *out = scratch, *key, *parent, *row, (*edge)[3];
+	unsigned int *children = scratch + 7 * (size_t)stein->n_nodes;
+	unsigned int i, m, root;
+
+	key = out + n;
+	parent = key + n;
+	row = parent + n;
+	edge = (unsigned int (*)[3])(row + n);
+
+	/* The tree starts with the last vertex, every other vertex is
+	 * connected to it by now. */
+	m = n - 1;
+	root = set[m];
+	memcpy(out, set, sizeof(*out) * m);
+	for(i = 0; i < m; i++)
+		parent[i] = root;
+	stein_gather(stein, root, out, m, key);
+	pr_debug("Vertex %u is the mst root.\n", root + 1u);
+
+	for(i = 0; m > 0; i++) {
+		unsigned int p, u;
+
+		/* Select the vertex with minimum cost to be added in the MST */
+		p = simd_argmin(key, m);
+
+		if(key[p] == W_INF) {
+			ERRNO = EDISCONNECTED;
+			pr_debug("The vertexes are not connected. ERRNO=%d\n",
+					ERRNO);
+			return NULL;
 		}
 
-		if(selected_v != selected_u && min_cost != UINT_MAX) {
-			struct list_head *u_tmp = NULL;
+		/* Keep the selected edge */
+		u = out[p];
+		edge[i][0] = parent[p];
+		edge[i][1] = u;
+		edge[i][2] = key[p];
 
+		pr_debug("Selected edge:(%u, %u), w=%u.\n", parent[p] + 1u,
+				u + 1u, key[p]);
 
-			/* Add the selected edge to the solution */
-			if(!(s = alloc_solution()))
-				goto fail_alloc_sol;
+		/* Remove u from the vertexes not yet added */
+		m--;
+		out[p] = out[m];
+		key[p] = key[m];
+		parent[p] = parent[m];
 
-			s->edge[0] = selected_v->v;
-			s->edge[1] = selected_u->v;
-			list_add_tail(&s->list, &solution_head);
+		/* u may now be the cheapest way to reach the remaining ones */
+		stein_gather(stein, u, out, m, row);
+		simd_key_update(key, parent, row, u, m);
+	}
 
-			/* Remove the u vertex from the not selected list 
-			 * and add it to the selected vertex list. */
-			u_tmp = &selected_u->list;
-			list_del(u_tmp);
-			list_add_tail(u_tmp, t_head);
+	/* Only a set with Steiner vertexes can have leaves to prune. The
+	 * terminals get a child more, so they are never taken as leaves. */
+	if(n > stein->n_terminals) {
+		for(i = 0; i < n; i++)
+			children[set[i]] = 0u;
+		for(i = 0; i < stein->n_terminals; i++)
+			children[stein->terminals[i]] = 1u;
+		for(i = 0; i < n - 1; i++)
+			children[edge[i][0]]++;
+		for(i = n - 1; i-- > 0;) {
+			if(children[edge[i][1]] == 0) {
+				children[edge[i][0]]--;
+				edge[i][1] = UINT_MAX;
+			}
+		}
+	}
 
-			pr_debug("Selected edge:(%u, %u), w=%u.\n",
-					selected_v->v + 1u, selected_u->v + 1u,
-					min_cost);
+	if(reserve_solution(sol, n - 1, arena) != 0)
+		return NULL;
+	solution_add_v(sol, root);
+	for(i = 0; i < n - 1; i++) {
+		if(edge[i][1] != UINT_MAX)
+			add_solution_edge(sol, edge[i][0], edge[i][1],
+					edge[i][2], arena);
+	}
+	return sol;
+}
 
-			/* Update the solution weight */
-			w_total += min_cost;
-		}
+
+/**
+ * retrieve_mst - Builds a maximum spanning tree with the vertexes in
+ * stein->terminals, returning a pointer to the solution, see
+ * retrieve_dense_mst().
+ *
+ * On sparse graphs the tree also has non-terminal vertexes, see
+ * retrieve_sparse_mst().
+ *
+ * @stein: stein structure with the graph representation.
+ * @sol: solution where the edges are added, cleared first.
+ * @arena: arena the edges are allocated from, usually the one of the
+ * generation the solution belongs to.
+ * */
+struct solution *retrieve_mst(struct stein *stein, struct solution *sol,
+		struct arena *arena)
+{
+	unsigned int *scratch;
+
+	/* Even an empty tree has a vertex set */
+	clear_solution(sol);
+	if(reserve_solution(sol, 0u, arena) != 0)
+		return NULL;
+	if(stein->n_terminals == 0)
+		return sol;
+
+	if(!(scratch = malloc(sizeof(*scratch) * mst_scratch(stein)))) {
+		ERRNO = ENOMEM;
+		return NULL;
 	}
+	if(stein->layout == ADJ_CSR)
+		sol = retrieve_sparse_mst(stein, NULL, sol, scratch, arena);
+	else
+		sol = retrieve_dense_mst(stein, stein->terminals,
+				stein->n_terminals, sol, scratch, arena);
+	free(scratch);
+	return sol;
+}
+
 
-	update_solution_weight(&solution_head, w_total);
+/**
+ * retrieve_mst_set - Builds the MST of the subgraph induced by the vertexes in
+ * set and prunes its non-terminal leaves, returning a pointer to the solution,
+ * or NULL if the terminals are not connected in that subgraph. This decodes
+ * a set of Steiner vertexes into a tree.
+ *
+ * The callers decoding a tree per child give the scratch of their thread, so
+ * that no memory is taken from the system while the generations are bred.
+ *
+ * @stein: stein structure with the graph representation.
+ * @set: vertexes of the tree, with every terminal. The last one must be a
+ * terminal, it is the root.
+ * @n: number of vertexes in set.
+ * @sol: solution where the edges are added, cleared first.
+ * @scratch: mst_scratch() words, or NULL to allocate them for this call.
+ * @arena: arena the edges are allocated from.
+ * */
+struct solution *retrieve_mst_set(struct stein *stein, const unsigned int *set,
+		unsigned int n, struct solution *sol, unsigned int *scratch,
+		struct arena *arena)
+{
+	unsigned int *own = NULL;
+	unsigned char *allowed;
+	unsigned int i;
 
-	free_list_entry(&terminal_head, err_s, list);
-	free_list_entry(&terminal_solution_head, err_s, list);
+	clear_solution(sol);
+	if(reserve_solution(sol, 0u, arena) != 0)
+		return NULL;
+	if(n == 0)
+		return sol;
 
-	return (&solution_head);
-fail_alloc_sol:
-	free_list_entry(&solution_head, err_s, list);
-	ERRNO = ERRNO != 0 ? ERRNO : ENOMEM;
-fail_get_terminals:
-	return NULL;
+	if(!scratch && !(scratch = own = malloc(sizeof(*scratch) *
+					mst_scratch(stein)))) {
+		ERRNO = ENOMEM;
+		return NULL;
+	}
+	if(stein->layout != ADJ_CSR) {
+		sol = retrieve_dense_mst(stein, set, n, sol, scratch, arena);
+	} else {
+		/* The vertexes allowed fit in the last n bytes */
+		allowed = (unsigned char *)(scratch +
+				7 * (size_t)stein->n_nodes);
+		memset(allowed, 0, stein->n_nodes);
+		for(i = 0; i < n; i++)
+			allowed[set[i]] = 1;
+		sol = retrieve_sparse_mst(stein, allowed, sol, scratch, arena);
+	}
+	free(own);
+	return sol;
 }
@@ -0,0 +1,177 @@
+/**
+ * pool.c - Persistent pool of worker threads running parallel loops.
+ *
+ * The workers are created once and sleep between the loops. A loop hands out
+ * its iterations through an atomic counter, so no lock is taken while it runs:
+ * the lock is only held to start a loop and to wait for its end. The calling
+ * thread works on the loop as well, as the thread 0.
+ * */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "include/pool.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/**
+ * run_loop - Run iterations of the current loop until there is none left.
+ * */
+static void run_loop(struct pool *pool, unsigned int thread)
+{
+	unsigned int i;
+
+	while((i = __atomic_fetch_add(&pool->next, 1u, __ATOMIC_RELAXED)) <
+			pool->n)
+		pool->fn(pool->arg, i, thread);
+}
+
+
+/**
+ * worker - Wait for a loop, run it, and signal its end, until the pool stops.
+ * */
+static void *worker(void *data)
+{
+	struct pool_thread *t = data;
+	struct pool *pool = t->pool;
+	unsigned long job = 0ul;
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;) {
+		while(pool->job == job && !pool->stop)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if(pool->stop)
+			break;
+		job = pool->job;
+		pthread_mutex_unlock(&pool->lock);
+
+		run_loop(pool, t->index);
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->running == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+
+/**
+ * pool_init - Start the worker threads. Returns an error number (!= 0) on
+ * failure.
+ *
+ * @pool: pool to initialize.
+ * @n_threads: number of threads, the calling one included, or 0 for one per
+ * online CPU.
+ * */
+int pool_init(struct pool *pool, unsigned int n_threads)
+{
+	unsigned int t;
+
+	if(n_threads == 0) {
+		long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		n_threads = n_cpus > 0 ? n_cpus : 1;
+	}
+
+	pool->n_threads = 1u;
+	pool->job = 0ul;
+	pool->running = 0u;
+	pool->stop = 0;
+	pool->n = 0u;
+	pool->next = 0u;
+	pool->workers = NULL;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	if(n_threads == 1)
+		return 0;
+	if(!(pool->workers = malloc(sizeof(*pool->workers) * (n_threads - 1))))
+		goto fail_alloc;
+
+	for(t = 1; t < n_threads; t++) {
+		struct pool_thread *w = &pool->workers[t - 1];
+
+		w->pool = pool;
+		w->index = t;
+		if(pthread_create(&w->thread, NULL, worker, w) != 0) {
+			pr_error("Could not create the thread %u.\n\n", t);
+			goto fail_alloc;
+		}
+		pool->n_threads++;
+	}
+	pr_debug("Pool of %u threads started.\n", pool->n_threads);
+	return 0;
+
+fail_alloc:
+	pool_free(pool);
+	ERRNO = ENOMEM;
+	return ERRNO;
+}
+
+
+/**
+ * pool_run - Run fn(arg, i, thread) for every i in [0, n) and wait for all of
+ * them. The calling thread runs the whole loop by itself when the pool is
+ * NULL or has a single thread.
+ *
+ * @pool: pool.
+ * @fn: body of the loop.
+ * @arg: argument given to fn.
+ * @n: number of iterations.
+ * */
+void pool_run(struct pool *pool, pool_fn fn, void *arg, unsigned int n)
+{
+	unsigned int i;
+
+	if(pool_threads(pool) == 1 || n <= 1) {
+		for(i = 0; i < n; i++)
+			fn(arg, i, 0u);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->fn = fn;
+	pool->arg = arg;
+	pool->n = n;
+	pool->next = 0u;
+	pool->running = pool->n_threads - 1;
+	pool->job++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	run_loop(pool, 0u);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->running > 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+
+/**
+ * pool_free - Stop the worker threads and free the pool.
+ *
+ * @pool: pool.
+ * */
+void pool_free(struct pool *pool)
+{
+	unsigned int t;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(t = 1; t < pool->n_threads; t++)
+		pthread_join(pool->workers[t - 1].thread, NULL);
+
+	free(pool->workers);
+	pool->workers = NULL;
+	pool->n_threads = 1u;
+	pthread_cond_destroy(&pool->start);
+	pthread_cond_destroy(&pool->done);
+	pthread_mutex_destroy(&pool->lock);
+}
@@ -4,181 +4,358 @@
  * */
 
 
+#include <string.h>
+
 #include "include/print.h"
 #include "include/errno.h"
-#include "include/misc.h"
+#include "include/rng.h"
 #include "include/population.h"
 #include "include/mst.h"
+#include "include/heuristic.h"
+#include "include/simd.h"
+
+
+
+/* Arguments of the parallel loop creating the initial individuals */
+struct seed_task {
+	struct stein *stein;
+	struct generation *g;
+	unsigned int rate;
+
+	/* Seed the stream of each individual derives from */
+	uint64_t seed;
 
+	/* Trees the individuals descend from */
+	const struct solution *seeds;
+	unsigned int n_seeds;
 
-/* The default size for a population */
-#ifndef POP_SIZE
-#define POP_SIZE 10
-#endif
+	/* Scratch of each thread, see population_scratch() */
+	unsigned int *scratch;
 
+	/* Set by an iteration which ran out of memory */
+	int failed;
+};
 
 
 /**
- * get_population_from_mst - Retrieve the MST from terminals and replicate it
- * POP_SIZE times. The population list head is returned.
- *
- * @stein: Stein struct to retrieve the MST.
+ * seed_individual - Copy a seed to the individual i, the seeds taking turns,
+ * and mutate and repair it, but for the first copy of each seed, which is kept
+ * as is. The mutations draw from the stream i of the seed of the population.
  * */
-static struct list_head *get_population_from_mst(struct stein *stein)
+static void seed_individual(void *arg, unsigned int i, unsigned int thread)
 {
-	int i;
-	struct list_head *common_ancestor = NULL, *_pop_head = NULL;
-	struct solution *tmp_s, *err_s;
-
-
-	if(!(common_ancestor = retrieve_mst(stein))) {
-		pr_error("Could not allocate population. common_ancestor=0x%p.\n\n", *common_ancestor);
-		goto fail_mst_create;
+	struct seed_task *task = arg;
+	struct arena *arena = &task->g->arena[thread];
+	unsigned int *scratch = task->scratch +
+		thread * population_scratch(task->stein), n;
+
+	if(copy_solution(&task->g->pop[i], &task->seeds[i % task->n_seeds],
+				arena) != 0) {
+		__atomic_store_n(&task->failed, 1, __ATOMIC_RELAXED);
+		return;
 	}
+	if(i < task->n_seeds)
+		return;
+	rng_split(get_rng(), task->seed, i);
+	n = task->g->pop[i].n_vertexes;
+	if(mutate_solution(&task->g->pop[i], task->stein, task->rate, scratch,
+				arena) > 0 &&
+			repair_solution(&task->g->pop[i], task->stein, n,
+				scratch, arena) != 0)
+		__atomic_store_n(&task->failed, 1, __ATOMIC_RELAXED);
+}
 
 
-	pr_debug("Common ancestor with %d edges was created at 0x%p.\n",
-			list_size(common_ancestor), *common_ancestor);
+/**
+ * cmp_weight - Order the solutions from the lightest to the heaviest.
+ * */
+static int cmp_weight(const void *a, const void *b)
+{
+	const struct solution *x = a, *y = b;
 
-	_pop_head = malloc(sizeof(*_pop_head));
-	INIT_LIST_HEAD(_pop_head);
-	for(i = 0; i < POP_SIZE; i++) {
-		struct population *p = NULL;
+	return (x->w > y->w) - (x->w < y->w);
+}
 
-		if(!(p = alloc_population())) {
-			pr_error("Could not allocate population. p head=0x%p.\n\n", *_pop_head);
-			ERRNO = ERRNO != 0 ? ERRNO : ENOMEM;
-			goto fail_pop_create;
-		}
 
-		INIT_LIST_HEAD(&p->solution);
-		p->list.next = NULL;
-		p->list.prev = NULL;
-		copy_solution(common_ancestor, &p->solution);
+/**
+ * create_initial_population - From a few seeds, create a population of
+ * solutions based on their random mutations. The seeds are the tree of
+ * Mehlhorn's heuristic, see mehlhorn(), the MST of the terminals, see
+ * retrieve_mst(), and, when there is room in the population, the trees of
+ * the shortest path heuristic from up to n_roots roots, see multi_root_sph(),
+ * the lightest first. The first individuals are the seeds themselves, so the
+ * population is never worse than the first of them. The individuals are
+ * owned by the returned generation, see free_generation().
+ *
+ * The individuals are created in parallel by the threads of the pool.
+ *
+ * @stein: Stein structure used to create a common ancestor.
+ * @size: number of individuals.
+ * @rate: every edge mutates with probability 1 / rate.
+ * @n_roots: roots of the shortest path heuristic, up to one per terminal.
+ * @seed: seed of the random draws.
+ * @pool: threads to work with, or NULL.
+ * */
+struct generation *create_initial_population(struct stein *stein,
+		unsigned int size, unsigned int rate, unsigned int n_roots,
+		uint64_t seed, struct pool *pool)
+{
+	struct generation *g;
+	struct solution *seeds;
+	struct seed_task task;
+	unsigned int *scratch;
+	unsigned int n_seeds = 0u;
+
+	/* The two first seeds take the first places of the population */
+	if(size <= 2)
+		n_roots = 0u;
+	if(n_roots > stein->n_terminals)
+		n_roots = stein->n_terminals;
+
+	if(!(g = alloc_generation(size, pool_threads(pool)))) {
+		ERRNO = ENOMEM;
+		pr_error("Could not allocate the generation. ERRNO=%d\n\n", ERRNO);
+		goto fail_create_pop;
+	}
+	if(!(seeds = malloc(sizeof(*seeds) * (2 + n_roots)))) {
+		ERRNO = ENOMEM;
+		pr_error("Could not allocate the seeds. ERRNO=%d\n\n", ERRNO);
+		goto fail_create_gen;
+	}
+	if(!(scratch = malloc(sizeof(*scratch) * pool_threads(pool) *
+					population_scratch(stein)))) {
+		ERRNO = ENOMEM;
+		pr_error("Could not allocate the scratch. ERRNO=%d\n\n", ERRNO);
+		free(seeds);
+		goto fail_create_gen;
+	}
 
-		list_add_tail(&p->list, _pop_head);
-		pr_debug("Solution copied at 0x%p.\n", &(p->solution));
+	/* The seeds are only copied, their edges go back with the arena when
+	 * the generation is reset. */
+	init_solution(&seeds[n_seeds]);
+	if(mehlhorn(stein, &seeds[n_seeds], &g->arena[0])) {
+		pr_debug("Mehlhorn seed with %u edges and weight %u was created.\n",
+				seeds[n_seeds].n_edges, seeds[n_seeds].w);
+		n_seeds++;
+	}
 
+	/* The terminals alone are only connected in dense graphs, which the
+	 * reductions may have made sparse: the common ancestor is then left
+	 * out if there is another seed. */
+	init_solution(&seeds[n_seeds]);
+	if(retrieve_mst(stein, &seeds[n_seeds], &g->arena[0])) {
+		pr_debug("Common ancestor with %u edges and weight %u was created.\n",
+				seeds[n_seeds].n_edges, seeds[n_seeds].w);
+		n_seeds++;
+	} else if(n_seeds == 0) {
+		pr_error("Could not allocate population. common_ancestor=0x%p.\n\n", &seeds[n_seeds]);
+		goto fail_create_seeds;
 	}
 
-	/* Free the memory allocated for the common ancestor */
-	free_list_entry(common_ancestor, tmp_s, list);
+	/* The trees of the threads go to their arenas. There may be more of
+	 * them than room in the population, which takes the lightest ones. */
+	if(n_roots > 0 && multi_root_sph(stein, seeds + n_seeds, n_roots,
+				g->arena, pool) == 0) {
+		pr_debug("%u shortest path heuristic seeds were created.\n",
+				n_roots);
+		qsort(seeds + n_seeds, n_roots, sizeof(*seeds), cmp_weight);
+		n_seeds += n_roots;
+	}
 
-	return _pop_head;
+	task.stein = stein;
+	task.g = g;
+	task.seeds = seeds;
+	task.n_seeds = n_seeds;
+	task.rate = rate;
+	task.seed = seed;
+	task.scratch = scratch;
+	task.failed = 0;
+	pool_run(pool, seed_individual, &task, g->size);
+	if(task.failed) {
+		ERRNO = ENOMEM;
+		pr_error("Initial population creation has failed. g=0x%p\n\n", g);
+		goto fail_create_seeds;
+	}
 
-fail_pop_create:
-	free_list_entry(_pop_head, err_s, list);
-	free(_pop_head);
-fail_mst_create:
+	pr_debug("Population with size %u created at 0x%p.\n", g->size, g->pop);
+
+	free(scratch);
+	free(seeds);
+	return g;
+fail_create_seeds:
+	free(scratch);
+	free(seeds);
+fail_create_gen:
+	free_generation(g);
+fail_create_pop:
 	return NULL;
 }
 
-
 /**
- * create_initial_population - From a common ancestor, create a population of
- * solutions based on this ancestor random mutations.
+ * get_new_v - Select a random vertex that is not yet in the solution, or
+ * UINT_MAX if every vertex is. It takes O(1), as the vertexes out of the tree
+ * are the ones after the first n_vertexes in the solution vertex set.
  *
- * @stein: Stein structure used to create a common ancestor.
+ * @stein: stein struct
+ * @s: solution to check
  * */
-struct list_head *create_initial_population(struct stein *stein)
+static unsigned int get_new_v(struct stein *stein, struct solution *s)
 {
-	struct list_head *p_head;
-	struct solution *s, *n;
-	struct population *p;
-
-	if(!(p_head = get_population_from_mst(stein))) {
-		pr_error("Initial population creation has failed. p_head=0x%p\n\n", *p_head);
-		goto fail_create_pop;
-	}
+	unsigned int n_out = stein->n_nodes - s->n_vertexes;
 
-	pr_debug("Population with size %d created at 0x%p.\n", list_size(p_head)
-			, *p_head);
+	if(n_out == 0)
+		return UINT_MAX;
 
-	list_for_each_entry(p, p_head, list) {
+	return s->vertex[s->n_vertexes + rng_bound(get_rng(), n_out)];
+}
 
-		pr_debug("Current population at 0x%p. p->solution at 0x%p\n",
-				*p, &(p->solution));
-		list_for_each_entry_safe(s, n, &p->solution, list) {
 
-			/**
-			 * TODO: create a way to put the solution weight into
-			 * account.
-			 * */
-			if(range_rand(0, RAND_MAX) % 4 == 0) {
-				pr_debug("Mutating (%u, %u).\n", s->edge[0] + 1u
-						, s->edge[1] + 1u);
-				mutation(s, stein, &p->solution);
-			}
-		}
+/**
+ * get_cheapest_v - Select the vertex not yet in the solution whose insertion
+ * in the edge (a, b) costs the least, i.e., the one minimizing
+ * w(a, v) + w(v, b), if it makes the solution cheaper. Otherwise a random
+ * vertex whose edges to a and b are both lighter than (a, b) is selected: the
+ * insertion is heavier, but (a, b) is the heaviest edge of the triangle, so
+ * the vertex is kept once the tree is decoded again, see repair_solution(),
+ * where a random vertex would mostly be pruned. UINT_MAX is returned if there
+ * is none.
+ *
+ * @stein: stein struct
+ * @s: solution to check
+ * @e: index of the edge where the vertex would be inserted.
+ * @scratch: scratch of the thread, see population_scratch().
+ * */
+static unsigned int get_cheapest_v(struct stein *stein, struct solution *s,
+		unsigned int e, unsigned int *scratch)
+{
+	unsigned int a = s->edge[e][0], b = s->edge[e][1];
+	unsigned int *row_a = scratch, *row_b = scratch + stein->n_nodes;
+	unsigned int i, v, cost, w = stein_w(stein, a, b), k = 0u;
+	struct rng *rng = get_rng();
+
+	stein_row(stein, a, row_a);
+	stein_row(stein, b, row_b);
+
+	/* The vertexes already in the solution can not be inserted */
+	for(i = 0; i < s->n_vertexes; i++)
+		row_a[s->vertex[i]] = W_INF;
+
+	v = simd_pair_argmin(row_a, row_b, stein->n_nodes, &cost);
+	if(cost < w)
+		return v;
+
+	/* Reservoir sampling of the random one */
+	for(i = 0, v = UINT_MAX; i < stein->n_nodes; i++) {
+		if(row_a[i] < w && row_b[i] < w && rng_chance(rng, ++k))
+			v = i;
 	}
+	return v;
+}
 
 
-
-	return p_head;
-fail_create_pop:
-	return NULL;
+/**
+ * sample_out_v - Draw, by reservoir sampling, among the vertexes out of the
+ * tree adjacent to the tree vertex u in a graph in the ADJ_CSR layout. The
+ * ones adjacent to another tree vertex as well are drawn apart, in the tier
+ * 1 of k and near, and the others in the tier 0. near[t] holds the vertex
+ * drawn, u and the weight of the edge between them.
+ * */
+static void sample_out_v(const struct stein *stein, const struct solution *s,
+		unsigned int u, unsigned int k[2], unsigned int near[2][3])
+{
+	const unsigned int *off = csr_off(stein), *adj = csr_adj(stein);
+	const unsigned int *wts = csr_wts(stein);
+	struct rng *rng = get_rng();
+	unsigned int i, j, x, t;
+
+	for(i = off[u]; i < off[u + 1]; i++) {
+		x = adj[i];
+		if(solution_has_v(s, x))
+			continue;
+		for(j = off[x], t = 0u; j < off[x + 1] && t == 0u; j++)
+			t = adj[j] != u && solution_has_v(s, adj[j]);
+		if(rng_chance(rng, ++k[t])) {
+			near[t][0] = x;
+			near[t][1] = u;
+			near[t][2] = wts[i];
+		}
+	}
 }
 
+
 /**
- * get_new_v - Select a vertex that is not yet in the solution.
+ * get_near_v - Select the vertex to add to the tree of a graph in the ADJ_CSR
+ * layout, where the ends of an edge seldom have a common neighbour: a random
+ * vertex out of the tree adjacent to an end of the edge e, or else to any
+ * vertex of the tree, scanned from a random one. The vertexes adjacent to a
+ * second tree vertex are preferred, as only they can change the tree once it
+ * is decoded again, see repair_solution(). Returns the tier of the vertex
+ * drawn in near, see sample_out_v(), or -1 if no vertex out of the tree is
+ * adjacent to it.
  *
  * @stein: stein struct
- * @s_head: solution to check
+ * @s: solution to check
+ * @e: index of the edge the vertex is drawn around.
+ * @near: vertex drawn, tree vertex it is joined to and weight of the edge,
+ * in each tier.
  * */
-static unsigned int get_new_v(struct stein *stein, struct list_head *s_head)
+static int get_near_v(struct stein *stein, struct solution *s, unsigned int e,
+		unsigned int near[2][3])
 {
-	unsigned int v;
-	do {
-		v = range_rand(0, stein->n_nodes - 1);
-	} while (solution_has_v(s_head, v));
+	unsigned int k[2] = {0u, 0u}, i, first;
 
+	sample_out_v(stein, s, s->edge[e][0], k, near);
+	sample_out_v(stein, s, s->edge[e][1], k, near);
 
-	return v;
+	first = rng_bound(get_rng(), s->n_vertexes);
+	for(i = 0; i < s->n_vertexes && k[1] == 0u; i++)
+		sample_out_v(stein, s, s->vertex[(first + i) % s->n_vertexes],
+				k, near);
+
+	return k[1] > 0u ? 1 : k[0] > 0u ? 0 : -1;
 }
 
 
 /**
  * add_new_v - Adds the given vertex in the given solution.
- * The new edges are create using the vertex "v", connecting it to the solution
- * "s" edge vertexes. This, therefore, removes the current edge from solution.
+ * The new edges are create using the vertex "v", connecting it to the vertexes
+ * of the edge e, which is replaced by the first new edge while the second one
+ * is appended to the solution.
  * */
-static void add_new_v(struct stein *stein, struct solution *s, unsigned int v,
-		struct list_head *s_head)
+static void add_new_v(struct stein *stein, struct solution *s, unsigned int e,
+		unsigned int v, struct arena *arena)
 {
-	struct solution *s1, *s2;
+	unsigned int a = s->edge[e][0], b = s->edge[e][1];
 	unsigned int new_w, new_w1, new_w2, old_w;
 
-	if(!(s1 = alloc_solution()) || !(s2 = alloc_solution())) {
-		ERRNO = ENOMEM;
-		pr_error("There is no memory left to allocate. ERRNO=%d\n"
-				, ERRNO);
-		pr_error("Solution edge (%u, %u) not changed.\n\n", s->edge[0] +
-				1u, s->edge[1] + 1u);
-		return;
-	}
-	s1->edge[0] = s->edge[0];
-	s2->edge[1] = s->edge[1];
-
-	s1->edge[1] = v;
-	s2->edge[0] = v;
-
 	/* Calculate the new solution weight */
-	old_w = stein->adj_m[s->edge[0]][s->edge[1]];
-	new_w1 = stein->adj_m[s1->edge[0]][s1->edge[1]];
-	new_w2 = stein->adj_m[s2->edge[0]][s2->edge[1]];
+	old_w = stein_w(stein, a, b);
+	new_w1 = stein_w(stein, a, v);
+	new_w2 = stein_w(stein, v, b);
 	new_w = s->w - old_w + new_w1 + new_w2;
 
-	/* Update the solution list */
-	list_add_tail(&s1->list, s_head);
-	list_add_tail(&s2->list, s_head);
-	list_del(&s->list);
+	/* The vertex must be adjacent to both edge vertexes */
+	if(new_w1 == W_INF || new_w2 == W_INF) {
+		pr_debug("Vertex %u is not adjacent to (%u, %u).\n", v + 1u,
+				a + 1u, b + 1u);
+		return;
+	}
 
-	/* Update the solution weight */
-	update_solution_weight(s_head, new_w);
+	if(reserve_solution(s, s->n_edges + 1u, arena) != 0) {
+		pr_error("There is no memory left to allocate. ERRNO=%d\n"
+				, ERRNO);
+		pr_error("Solution edge (%u, %u) not changed.\n\n", a + 1u,
+				b + 1u);
+		return;
+	}
 
 	pr_debug("Solution updated: weight=%u, old weight=%u, s=%u, w1=%u, w2=%u.\n",
 			new_w, s->w, old_w, new_w1, new_w2);
-	free(s);
+
+	/* Update the solution edges, room for the new one was reserved
+	 * above. The weight follows the two edges by deltas. */
+	solution_set_edge(s, e, a, v, old_w, new_w1);
+	add_solution_edge(s, v, b, new_w2, arena);
 }
 
 /**
@@ -187,31 +364,276 @@ static void add_new_v(struct stein *stein, struct solution *s, unsigned int v,
  * to a direct edge between two terminals. The method, thus, adds two edges to the
  * solution and removes one.
  *
+ * The cheapest insertion point is used when it makes the solution cheaper,
+ * otherwise a random vertex the decoding keeps, see get_cheapest_v(), or any
+ * random vertex if there is none. On sparse graphs, where the ends of
+ * an edge seldom have a common neighbour, the vertex set is mutated instead:
+ * a vertex next to the edge, see get_near_v(), joins the tree as a leaf, and
+ * repair_solution() decides what it is joined to.
+ *
  * @s: Solution which will mutate.
+ * @e: index of the edge to replace.
  * @stein: Stein struct.
- * @s_head: Solution list head.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the solution belongs to.
  * */
-void mutation(struct solution *s, struct stein *stein, struct list_head *s_head)
+void mutation(struct solution *s, unsigned int e, struct stein *stein,
+		unsigned int *scratch, struct arena *arena)
 {
-	int v;
+	unsigned int v, near[2][3];
+	int t;
+
+	pr_debug("Getting new vertex for the edge (%u, %u).\n",
+			s->edge[e][0] + 1u, s->edge[e][1] + 1u);
+
+	if(stein->layout == ADJ_CSR) {
+		if((t = get_near_v(stein, s, e, near)) < 0)
+			return;
+		pr_debug("Selected vertex: %u, joined to %u\n",
+				near[t][0] + 1u, near[t][1] + 1u);
+		if(add_solution_edge(s, near[t][1], near[t][0], near[t][2],
+					arena) != 0)
+			pr_error("There is no memory left to allocate."
+					" ERRNO=%d\n\n", ERRNO);
+		return;
+	}
 
-	pr_debug("Getting new vertex for the edge (%u, %u).\n", s->edge[0] + 1u,
-			s->edge[1] + 1u);
+	if((v = get_cheapest_v(stein, s, e, scratch)) == UINT_MAX)
+		v = get_new_v(stein, s);
+	if(v == UINT_MAX)
+		return;
+	pr_debug("Selected vertex: %u\n", v + 1u);
+
+	add_new_v(stein, s, e, v, arena);
+}
 
-	/* TODO: Check how much the function bellow affects the performance */
-	v = get_new_v(stein, s_head);
-	pr_debug("Selected vertex: %d\n", v);
 
-	add_new_v(stein, s, v, s_head);
+/**
+ * mutate_solution - Mutate every edge of the solution with probability
+ * 1 / rate, see mutation(). Returns the number of mutations. The tree is left
+ * as the insertions made it, see repair_solution().
+ *
+ * @s: Solution which will mutate.
+ * @stein: Stein struct.
+ * @rate: inverse of the mutation probability.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the solution belongs to.
+ * */
+unsigned int mutate_solution(struct solution *s, struct stein *stein,
+		unsigned int rate, unsigned int *scratch, struct arena *arena)
+{
+	struct rng *rng = get_rng();
+	unsigned long j;
+	unsigned int n = 0u;
+
+	/* The draws jump from an edge which mutates to the next one, rather
+	 * than a draw per edge. The edges appended by a mutation may mutate as
+	 * well. */
+	for(j = rng_skip(rng, rate); j < s->n_edges;
+			j += 1ul + rng_skip(rng, rate)) {
+		pr_debug("Mutating (%u, %u).\n", s->edge[j][0] + 1u
+				, s->edge[j][1] + 1u);
+		mutation(s, j, stein, scratch, arena);
+		n++;
+	}
+	check_solution_weight(stein, s);
+	return n;
+}
+
+
+/**
+ * move_slot - Replace the edge from by the edge to among the two edges of the
+ * vertex v, if it has degree 2, see bypass_steiner().
+ * */
+static void move_slot(const unsigned int *deg, unsigned int *slot,
+		unsigned int v, unsigned int from, unsigned int to)
+{
+	if(deg[v] != 2)
+		return;
+	if(slot[2 * v] == from)
+		slot[2 * v] = to;
+	else if(slot[2 * v + 1] == from)
+		slot[2 * v + 1] = to;
+}
+
+
+/**
+ * bypass_steiner - Replace the two edges (a, v) and (v, b) of every Steiner
+ * vertex v of degree 2 by the edge (a, b), when it is no heavier. The degree
+ * of a and b does not change, so a path of such vertexes is bypassed one
+ * vertex after the other. The vertexes marked in keep are left as they are.
+ * */
+static void bypass_steiner(struct stein *stein, struct solution *s,
+		const unsigned char *keep, unsigned int *scratch)
+{
+	unsigned int *deg = scratch, *slot = scratch + stein->n_nodes;
+	unsigned int i, k, e, ea, eb, a, b, v, last, w_a, w_b, w_ab;
+
+	/* The terminals never reach degree 2 this way */
+	for(i = 0; i < s->n_vertexes; i++)
+		deg[s->vertex[i]] = 0u;
+	for(i = 0; i < stein->n_terminals; i++)
+		deg[stein->terminals[i]] = UINT_MAX / 2;
+
+	/* The two edges of each vertex of degree 2 */
+	for(e = 0; e < s->n_edges; e++) {
+		for(k = 0; k < 2; k++) {
+			v = s->edge[e][k];
+			if(deg[v] < 2)
+				slot[2 * v + deg[v]] = e;
+			deg[v]++;
+		}
+	}
+
+	/* Backwards, as the vertex removed takes the place of the last one */
+	for(i = s->n_vertexes; i-- > 0;) {
+		v = s->vertex[i];
+		if(deg[v] != 2 || keep[v])
+			continue;
+		ea = slot[2 * v];
+		eb = slot[2 * v + 1];
+		a = s->edge[ea][0] == v ? s->edge[ea][1] : s->edge[ea][0];
+		b = s->edge[eb][0] == v ? s->edge[eb][1] : s->edge[eb][0];
+		w_a = stein_w(stein, a, v);
+		w_b = stein_w(stein, v, b);
+		w_ab = stein_w(stein, a, b);
+		if(w_ab == W_INF || w_ab > w_a + w_b)
+			continue;
+
+		pr_debug("Bypassing %u between %u and %u.\n", v + 1u, a + 1u,
+				b + 1u);
+		solution_set_edge(s, ea, a, b, w_a, w_ab);
+		move_slot(deg, slot, b, eb, ea);
+
+		/* The last edge moves in the place of eb */
+		last = s->n_edges - 1u;
+		solution_del_edge(s, eb, w_b);
+		if(eb != last) {
+			move_slot(deg, slot, s->edge[eb][0], last, eb);
+			move_slot(deg, slot, s->edge[eb][1], last, eb);
+		}
+		solution_del_v(s, v);
+		deg[v] = 0u;
+	}
+}
+
+
+/**
+ * repair_solution - Decode the vertexes of a mutated solution into a tree
+ * again, see retrieve_mst_set(), which connects each inserted vertex to its
+ * nearest ones and prunes the Steiner leaves, and bypass the Steiner vertexes
+ * of degree 2, see bypass_steiner(). The inserted vertexes are not bypassed:
+ * most insertions which do not make the tree lighter would be undone, and
+ * the child would be its parent again. The tree is never heavier than before.
+ * Returns an error number (!= 0) if there is no memory.
+ *
+ * @s: Solution to repair.
+ * @stein: Stein struct.
+ * @first_new: number of vertexes of the solution before the mutations, which
+ * inserted the ones from this position on.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the solution belongs to.
+ * */
+int repair_solution(struct solution *s, struct stein *stein,
+		unsigned int first_new, unsigned int *scratch,
+		struct arena *arena)
+{
+	unsigned int *set = scratch, n = s->n_vertexes, root, i;
+	unsigned char *keep = (unsigned char *)(scratch + stein->n_nodes +
+			mst_scratch(stein));
+
+	if(stein->n_terminals == 0 || n == 0)
+		return 0;
+
+	memset(keep, 0, stein->n_nodes);
+	for(i = first_new; i < n; i++)
+		keep[s->vertex[i]] = 1;
+
+	/* The root must be a terminal */
+	memcpy(set, s->vertex, sizeof(*set) * n);
+	root = s->pos[stein->terminals[0]];
+	set[root] = set[n - 1];
+	set[n - 1] = stein->terminals[0];
+
+	if(!retrieve_mst_set(stein, set, n, s, scratch + stein->n_nodes,
+				arena)) {
+		ERRNO = ENOMEM;
+		pr_error("Could not repair the solution. ERRNO=%d\n\n", ERRNO);
+		return ERRNO;
+	}
+	bypass_steiner(stein, s, keep, scratch);
+	check_solution_weight(stein, s);
+	return 0;
 }
 
 
 /**
  * Crossover is based on an exchange of partial solutions of a population, i.e.,
  * given two solutions, part of the solution structure - the use or not of an
- * intermediate terminal - is exchanged, forming a new population.
+ * intermediate vertex - is exchanged, forming a new population.
+ *
+ * The child takes the terminals and a set of Steiner vertexes drawn from the
+ * ones of its parents: with CROSSOVER_UNIFORM the ones in both parents and
+ * each one in a single parent with probability 1/2, and with
+ * CROSSOVER_ONE_POINT the ones of the first parent below a random vertex and
+ * the ones of the second parent from it on, whether or not the first parent
+ * has them. The set is decoded into a tree by
+ * retrieve_mst_set(). When the terminals are not connected through that set,
+ * the child is a copy of the first parent.
+ *
+ * Returns an error number (!= 0) if there is no memory.
+ *
+ * @child: solution where the child is written.
+ * @s1: first parent.
+ * @s2: second parent.
+ * @stein: Stein struct.
+ * @scheme: how the Steiner vertexes are drawn.
+ * @scratch: scratch of the thread, see population_scratch().
+ * @arena: arena of the generation the child belongs to.
  * */
-void crossover(struct solution *s1, struct solution *s2)
+int crossover(struct solution *child, const struct solution *s1,
+		const struct solution *s2, struct stein *stein,
+		enum crossover_scheme scheme, unsigned int *scratch,
+		struct arena *arena)
 {
-}
+	struct rng *rng = get_rng();
+	unsigned char *is_t = (unsigned char *)(scratch + stein->n_nodes);
+	unsigned int *set = scratch, i, v, n = 0u;
+	unsigned int cut = rng_bound(rng, stein->n_nodes);
+
+	memset(is_t, 0, stein->n_nodes);
+	for(i = 0; i < stein->n_terminals; i++)
+		is_t[stein->terminals[i]] = 1;
+
+	/* The one-point scheme takes each vertex from the parent of its side
+	 * of the cut. The uniform one decides a vertex of both parents in the
+	 * first loop. */
+	for(i = 0; i < s1->n_vertexes; i++) {
+		v = s1->vertex[i];
+		if(is_t[v])
+			continue;
+		if(scheme == CROSSOVER_ONE_POINT ? v < cut :
+				solution_has_v(s2, v) || rng_chance(rng, 2))
+			set[n++] = v;
+	}
+	for(i = 0; i < s2->n_vertexes; i++) {
+		v = s2->vertex[i];
+		if(is_t[v])
+			continue;
+		if(scheme == CROSSOVER_ONE_POINT ? v >= cut :
+				!solution_has_v(s1, v) && rng_chance(rng, 2))
+			set[n++] = v;
+	}
+
+	/* The terminals go last, so the root is a terminal */
+	memcpy(set + n, stein->terminals, sizeof(*set) * stein->n_terminals);
+	n += stein->n_terminals;
 
+	if(!retrieve_mst_set(stein, set, n, child, scratch + stein->n_nodes,
+				arena)) {
+		pr_debug("Could not decode the child, copying the parent.\n");
+		return copy_solution(child, s1, arena);
+	}
+	check_solution_weight(stein, child);
+	return 0;
+}
@@ -0,0 +1,844 @@
+/**
+ * reduce.c - Reduction tests, which shrink the instance before it is solved
+ * while keeping an optimal tree in it.
+ * */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/reduce.h"
+#include "include/heap.h"
+#include "include/bound.h"
+#include "include/heuristic.h"
+#include "include/localsearch.h"
+#include "include/print.h"
+#include "include/errno.h"
+
+
+/* Flags of the vertexes */
+#define RED_TERMINAL 1
+#define RED_DEAD 2
+#define RED_QUEUED 4
+
+
+/* Graph under reduction. The edges are those of the record, in lists which
+ * keep the removed edges until they are walked, so that an edge is removed
+ * in O(1). */
+struct red_graph {
+	struct reduction *r;
+	unsigned int n;
+	unsigned int n_terminals;
+
+	/* First edge of each vertex, and next edge of each end of an edge */
+	unsigned int *head;
+	unsigned int (*next)[2];
+	unsigned int *deg;
+	unsigned char *flag;
+	unsigned char *alive;
+
+	/* Vertexes the degree tests have to look at */
+	unsigned int *stack;
+	unsigned int n_stack;
+
+	/* Live edges of each vertex by increasing weight, as (weight, other
+	 * end, edge), copied before each round of the distance tests */
+	unsigned int *off;
+	unsigned int (*arc)[3];
+
+	/* Dijkstra of the distance tests, and the vertexes it reached */
+	unsigned int *dist;
+	unsigned int *touched;
+	struct heap heap;
+
+	/* Closest terminals of each vertex, and their distance */
+	unsigned int (*near)[REDUCE_SD_TERMINALS][2];
+	unsigned int *n_near;
+};
+
+
+/**
+ * other_end - Return the end of the edge e which is not x, and set k to the
+ * end x is.
+ * */
+static inline unsigned int other_end(const struct red_graph *g,
+		unsigned int e, unsigned int x, unsigned int *k)
+{
+	*k = g->r->edge[e][0] == x ? 0u : 1u;
+	return g->r->edge[e][1 - *k];
+}
+
+
+/**
+ * push_vertex - Queue the vertex x for the degree tests.
+ * */
+static void push_vertex(struct red_graph *g, unsigned int x)
+{
+	if(g->flag[x] & (RED_QUEUED | RED_DEAD))
+		return;
+	g->flag[x] |= RED_QUEUED;
+	g->stack[g->n_stack++] = x;
+}
+
+
+/**
+ * add_edge - Append the edge (u, v) of weight w to the record and to the
+ * graph, standing for the edges m1 and m2. Returns its index.
+ * */
+static unsigned int add_edge(struct red_graph *g, unsigned int u,
+		unsigned int v, unsigned int w, unsigned int m1, unsigned int m2)
+{
+	struct reduction *r = g->r;
+	unsigned int e = r->n_edges++;
+
+	r->edge[e][0] = u;
+	r->edge[e][1] = v;
+	r->edge[e][2] = w;
+	r->merged[e][0] = m1;
+	r->merged[e][1] = m2;
+	g->next[e][0] = g->head[u];
+	g->head[u] = e;
+	g->next[e][1] = g->head[v];
+	g->head[v] = e;
+	g->alive[e] = 1;
+	g->deg[u]++;
+	g->deg[v]++;
+	return e;
+}
+
+
+/**
+ * del_edge - Remove the edge e from the graph, queueing its ends.
+ * */
+static void del_edge(struct red_graph *g, unsigned int e)
+{
+	unsigned int u = g->r->edge[e][0], v = g->r->edge[e][1];
+
+	g->alive[e] = 0;
+	g->deg[u]--;
+	g->deg[v]--;
+	push_vertex(g, u);
+	push_vertex(g, v);
+}
+
+
+/**
+ * first_edge - Return the first edge of the vertex x still in the graph,
+ * unlinking the removed edges in front of it, or REDUCE_NONE.
+ * */
+static unsigned int first_edge(struct red_graph *g, unsigned int x)
+{
+	unsigned int e, k;
+
+	while((e = g->head[x]) != REDUCE_NONE && !g->alive[e]) {
+		other_end(g, e, x, &k);
+		g->head[x] = g->next[e][k];
+	}
+	return e;
+}
+
+
+/**
+ * next_edge - Return the edge after e in the list of x, still in the graph,
+ * or REDUCE_NONE.
+ * */
+static unsigned int next_edge(const struct red_graph *g, unsigned int e,
+		unsigned int x)
+{
+	unsigned int k;
+
+	do {
+		other_end(g, e, x, &k);
+		e = g->next[e][k];
+	} while(e != REDUCE_NONE && !g->alive[e]);
+	return e;
+}
+
+
+/**
+ * find_edge - Return the edge between a and b, or REDUCE_NONE.
+ * */
+static unsigned int find_edge(struct red_graph *g, unsigned int a,
+		unsigned int b)
+{
+	unsigned int e, k;
+
+	for(e = first_edge(g, a); e != REDUCE_NONE; e = next_edge(g, e, a)) {
+		if(other_end(g, e, a, &k) == b)
+			return e;
+	}
+	return REDUCE_NONE;
+}
+
+
+/**
+ * kill_vertex - Remove the vertex x, left without edges.
+ * */
+static void kill_vertex(struct red_graph *g, unsigned int x)
+{
+	if(g->flag[x] & RED_TERMINAL)
+		g->n_terminals--;
+	g->flag[x] = RED_DEAD;
+}
+
+
+/**
+ * merge_path - Replace the Steiner vertex x of degree 2 by an edge between its
+ * neighbours, unless there is already a lighter one. Returns 0 if the weight
+ * of the edge would not fit.
+ * */
+static int merge_path(struct red_graph *g, unsigned int x)
+{
+	const struct reduction *r = g->r;
+	unsigned int e1 = first_edge(g, x), e2 = next_edge(g, e1, x);
+	unsigned int a, b, k, e;
+	unsigned long w = (unsigned long)r->edge[e1][2] + r->edge[e2][2];
+
+	a = other_end(g, e1, x, &k);
+	b = other_end(g, e2, x, &k);
+	e = find_edge(g, a, b);
+	if(e == REDUCE_NONE && w >= W_INF)
+		return 0;
+
+	del_edge(g, e1);
+	del_edge(g, e2);
+	kill_vertex(g, x);
+	if(e != REDUCE_NONE && r->edge[e][2] <= w)
+		return 1;
+	if(e != REDUCE_NONE)
+		del_edge(g, e);
+	add_edge(g, a, b, w, e1, e2);
+	return 1;
+}
+
+
+/**
+ * degree_tests - Apply the degree tests to the queued vertexes until there is
+ * none left, every change queueing the vertexes whose degree changed.
+ * Returns the number of vertexes removed.
+ * */
+static unsigned int degree_tests(struct red_graph *g)
+{
+	struct reduction *r = g->r;
+	unsigned int x, e, u, k, n_dead = 0u;
+
+	while(g->n_stack > 0) {
+		x = g->stack[--g->n_stack];
+		g->flag[x] &= ~RED_QUEUED;
+		if(g->flag[x] & RED_DEAD)
+			continue;
+
+		if(!(g->flag[x] & RED_TERMINAL)) {
+			if(g->deg[x] == 0) {
+				kill_vertex(g, x);
+			} else if(g->deg[x] == 1) {
+				del_edge(g, first_edge(g, x));
+				kill_vertex(g, x);
+			} else if(g->deg[x] != 2 || !merge_path(g, x)) {
+				continue;
+			}
+			n_dead++;
+			continue;
+		}
+
+		/* The edge of a terminal of degree 1 is in every tree */
+		if(g->deg[x] != 1 || g->n_terminals <= 2)
+			continue;
+		e = first_edge(g, x);
+		u = other_end(g, e, x, &k);
+		r->fixed[r->n_fixed++] = e;
+		r->fixed_w += r->edge[e][2];
+		del_edge(g, e);
+		kill_vertex(g, x);
+		if(!(g->flag[u] & RED_TERMINAL)) {
+			g->flag[u] |= RED_TERMINAL;
+			g->n_terminals++;
+		}
+		n_dead++;
+	}
+	return n_dead;
+}
+
+
+/**
+ * cmp_arc - Order the edges of a vertex by weight, then by index.
+ * */
+static int cmp_arc(const void *a, const void *b)
+{
+	const unsigned int *aa = a, *ab = b;
+
+	if(aa[0] != ab[0])
+		return aa[0] < ab[0] ? -1 : 1;
+	return aa[2] < ab[2] ? -1 : aa[2] > ab[2];
+}
+
+
+/**
+ * load_arcs - Copy the live edges of every vertex into its slice of the arcs,
+ * sorted by weight, so that the Dijkstras of the distance tests walk
+ * contiguous memory and stop at the first edge too heavy.
+ * */
+static void load_arcs(struct red_graph *g)
+{
+	const struct reduction *r = g->r;
+	unsigned int x, e, k, a = 0u;
+
+	for(x = 0; x < g->n; x++) {
+		g->off[x] = a;
+		if(g->flag[x] & RED_DEAD)
+			continue;
+		for(e = first_edge(g, x); e != REDUCE_NONE;
+				e = next_edge(g, e, x)) {
+			g->arc[a][0] = r->edge[e][2];
+			g->arc[a][1] = other_end(g, e, x, &k);
+			g->arc[a++][2] = e;
+		}
+		qsort(g->arc[g->off[x]], a - g->off[x], sizeof(*g->arc),
+				cmp_arc);
+	}
+	g->off[g->n] = a;
+}
+
+
+/**
+ * bounded_dijkstra - Dijkstra from the vertex x, scanning the edges of x and
+ * at most REDUCE_SD_SCANS more, and dropping the paths of bound or more. The
+ * closest terminals settled are written in near. Returns the number of
+ * vertexes reached, left in touched for their distance to be reset.
+ * */
+static unsigned int bounded_dijkstra(struct red_graph *g, unsigned int x,
+		unsigned long bound)
+{
+	unsigned int n_touched = 0u, u, v, a, end;
+	unsigned long d, n_scans = (unsigned long)g->off[x + 1] - g->off[x] +
+		REDUCE_SD_SCANS;
+
+	g->n_near[x] = 0u;
+	g->dist[x] = 0u;
+	g->touched[n_touched++] = x;
+	heap_push(&g->heap, x);
+
+	while(g->heap.size > 0 && n_scans > 0) {
+		u = heap_pop(&g->heap);
+		if((g->flag[u] & RED_TERMINAL) &&
+				g->n_near[x] < REDUCE_SD_TERMINALS) {
+			g->near[x][g->n_near[x]][0] = u;
+			g->near[x][g->n_near[x]++][1] = g->dist[u];
+		}
+		end = g->off[u + 1];
+		if(end - g->off[u] > n_scans)
+			end = g->off[u] + (unsigned int)n_scans;
+		for(a = g->off[u]; a < end; a++) {
+			d = (unsigned long)g->dist[u] + g->arc[a][0];
+			if(d >= bound)
+				break;
+			v = g->arc[a][1];
+			if(d >= g->dist[v])
+				continue;
+			if(g->dist[v] == W_INF)
+				g->touched[n_touched++] = v;
+			g->dist[v] = d;
+			heap_push(&g->heap, v);
+		}
+		n_scans -= a - g->off[u];
+	}
+
+	heap_clear(&g->heap);
+	return n_touched;
+}
+
+
+/**
+ * common_terminal - Test whether a terminal is closer than w to both u and v,
+ * among their closest terminals.
+ * */
+static int common_terminal(const struct red_graph *g, unsigned int u,
+		unsigned int v, unsigned int w)
+{
+	unsigned int i, j;
+
+	for(i = 0; i < g->n_near[u]; i++) {
+		if(g->near[u][i][1] >= w)
+			break;
+		for(j = 0; j < g->n_near[v]; j++) {
+			if(g->near[v][j][0] == g->near[u][i][0] &&
+					g->near[v][j][1] < w)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+
+/**
+ * distance_tests - Apply the long edge and the special distance tests to
+ * every edge. The Dijkstra from each vertex reaches as far as its heaviest
+ * edge: an edge (u, v) is long if v is reached below its weight, and the
+ * closest terminals of u and v give the special distance test. No edge of a
+ * minimum tree fails either test, so the edges are all removed at the end.
+ * Returns the number of edges removed.
+ * */
+static unsigned int distance_tests(struct red_graph *g)
+{
+	const struct reduction *r = g->r;
+	unsigned int x, e, a, end, i, n_touched, n_cut = 0u;
+	unsigned char *cut = NULL;
+
+	if(!(cut = calloc(r->n_edges, 1)))
+		return 0u;
+
+	/* No edge is removed before the end, so the arcs stay valid */
+	load_arcs(g);
+	for(x = 0; x < g->n; x++) {
+		if(g->off[x] == g->off[x + 1])
+			continue;
+
+		/* The heaviest edge is the last one */
+		end = g->off[x + 1];
+		n_touched = bounded_dijkstra(g, x, g->arc[end - 1][0]);
+		for(a = g->off[x]; a < end; a++) {
+			if(g->dist[g->arc[a][1]] < g->arc[a][0])
+				cut[g->arc[a][2]] = 1;
+		}
+		for(i = 0; i < n_touched; i++)
+			g->dist[g->touched[i]] = W_INF;
+	}
+
+	for(e = 0; e < r->n_edges; e++) {
+		if(!g->alive[e])
+			continue;
+		if(cut[e] || common_terminal(g, r->edge[e][0], r->edge[e][1],
+					r->edge[e][2])) {
+			del_edge(g, e);
+			n_cut++;
+		}
+	}
+	free(cut);
+	return n_cut;
+}
+
+
+/**
+ * cmp_index - Order the edges of the reduced graph by their ends.
+ * */
+static int cmp_index(const void *a, const void *b)
+{
+	const unsigned int *ia = a, *ib = b;
+
+	if(ia[0] != ib[0])
+		return ia[0] < ib[0] ? -1 : 1;
+	return ia[1] < ib[1] ? -1 : ia[1] > ib[1];
+}
+
+
+/**
+ * rebuild_stein - Replace the instance by the reduced graph, numbering its
+ * vertexes again in their original order. Returns an error number (!= 0) if
+ * there is no memory.
+ * */
+static int rebuild_stein(struct stein *stein, struct red_graph *g)
+{
+	struct reduction *r = g->r;
+	unsigned int (*edges)[3] = NULL, *id = NULL, x, e, i, n = 0u;
+	unsigned int n_t = 0u, max_w = 0u;
+
+	free(r->orig);
+	free(r->index);
+	r->orig = NULL;
+	r->index = NULL;
+	r->n_index = 0u;
+	if(!(id = malloc(sizeof(*id) * g->n)))
+		goto fail_rebuild;
+	for(x = 0; x < g->n; x++) {
+		if(g->flag[x] & RED_DEAD)
+			continue;
+		id[x] = n++;
+		n_t += !!(g->flag[x] & RED_TERMINAL);
+	}
+	for(e = 0; e < r->n_edges; e++)
+		r->n_index += g->alive[e];
+
+	if(!(r->orig = malloc(sizeof(*r->orig) * n)) ||
+			!(r->index = malloc(sizeof(*r->index) * r->n_index)) ||
+			!(edges = malloc(sizeof(*edges) * r->n_index)))
+		goto fail_rebuild;
+
+	for(x = 0; x < g->n; x++) {
+		if(!(g->flag[x] & RED_DEAD))
+			r->orig[id[x]] = x;
+	}
+	for(e = i = 0; e < r->n_edges; e++) {
+		if(!g->alive[e])
+			continue;
+		edges[i][0] = id[r->edge[e][0]];
+		edges[i][1] = id[r->edge[e][1]];
+		edges[i][2] = r->edge[e][2];
+		if(edges[i][2] > max_w)
+			max_w = edges[i][2];
+		r->index[i][0] = edges[i][0] < edges[i][1] ? edges[i][0] :
+			edges[i][1];
+		r->index[i][1] = edges[i][0] ^ edges[i][1] ^ r->index[i][0];
+		r->index[i++][2] = e;
+	}
+	qsort(r->index, r->n_index, sizeof(*r->index), cmp_index);
+
+	free_stein();
+	stein->n_nodes = n;
+	stein->n_edges = r->n_index;
+	stein->n_terminals = n_t;
+	stein->not_t = n - n_t;
+	stein->terminals = NULL;
+	alloc_adj_m();
+	if(!stein->adj_m)
+		goto fail_rebuild;
+	if(stein->layout == ADJ_CSR) {
+		if(fill_csr((const unsigned int (*)[3])edges) != 0)
+			goto fail_rebuild;
+	} else {
+		for(i = 0; i < r->n_index; i++)
+			stein_set_w(stein, edges[i][0], edges[i][1],
+					edges[i][2]);
+		compact_adj_m(max_w);
+	}
+
+	alloc_terminals();
+	if(!stein->terminals)
+		goto fail_rebuild;
+	for(x = i = 0; x < g->n; x++) {
+		if((g->flag[x] & (RED_DEAD | RED_TERMINAL)) == RED_TERMINAL)
+			stein->terminals[i++] = id[x];
+	}
+
+	free(edges);
+	free(id);
+	return 0;
+
+fail_rebuild:
+	free(edges);
+	free(id);
+	ERRNO = ENOMEM;
+	return ERRNO;
+}
+
+
+/**
+ * bound_tests - Apply the reduced cost test of the dual ascents from up to
+ * REDUCE_DA_ROOTS roots to the rebuilt instance, against the tree of
+ * Mehlhorn's heuristic improved by the local search, and remove the edges
+ * found from the graph under reduction. The best bound is kept in the record.
+ * Returns an error number (!= 0) if there is no memory.
+ * */
+static int bound_tests(struct stein *stein, struct red_graph *g,
+		unsigned int *n_cut)
+{
+	struct reduction *r = g->r;
+	struct generation *ub;
+	struct dual_ascent da;
+	unsigned char *cut = NULL;
+	unsigned int key[2], i, v, a, n_roots = REDUCE_DA_ROOTS;
+	const unsigned int *found;
+	int err = 0;
+
+	*n_cut = 0u;
+	if(n_roots > stein->n_terminals)
+		n_roots = stein->n_terminals;
+	if(!(ub = alloc_generation(1, 1))) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	memset(&da, 0, sizeof(da));
+
+	/* Without a tree, there is nothing to test the edges against */
+	if(!mehlhorn(stein, &ub->pop[0], &ub->arena[0]))
+		goto free_bound;
+	if((err = local_search(stein, &ub->pop[0], LS_FIRST, NULL,
+					&ub->arena[0])) != 0 ||
+			(err = dual_ascent_init(&da, stein)) != 0)
+		goto free_bound;
+	if(!(cut = calloc((size_t)da.off[da.n] + 1, 1))) {
+		ERRNO = ENOMEM;
+		err = ERRNO;
+		goto free_bound;
+	}
+
+	for(i = 0; i < n_roots; i++) {
+		if((err = dual_ascent(&da, stein, stein->terminals[(size_t)i *
+						stein->n_terminals / n_roots],
+						NULL)) != 0)
+			goto free_bound;
+		if(da.lb > r->lb)
+			r->lb = da.lb;
+		*n_cut += dual_ascent_test(&da, stein, ub->pop[0].w, cut);
+	}
+	pr_debug("Reduced cost test: bound %lu, tree %u, %u edges cut.\n",
+			r->lb, ub->pop[0].w, *n_cut);
+
+	/* The vertexes of the instance are the ones of the index */
+	for(v = 0; v < da.n; v++) {
+		for(a = da.off[v]; a < da.off[v + 1]; a++) {
+			if(!cut[a] || (key[0] = da.tail[a]) > v)
+				continue;
+			key[1] = v;
+			if((found = bsearch(key, r->index, r->n_index,
+						sizeof(*r->index), cmp_index)) &&
+					g->alive[found[2]])
+				del_edge(g, found[2]);
+		}
+	}
+
+free_bound:
+	free(cut);
+	dual_ascent_free(&da);
+	free_generation(ub);
+	return err;
+}
+
+
+/**
+ * free_graph - Free the graph under reduction.
+ * */
+static void free_graph(struct red_graph *g)
+{
+	free(g->head);
+	free(g->next);
+	free(g->deg);
+	free(g->flag);
+	free(g->alive);
+	free(g->stack);
+	free(g->off);
+	free(g->arc);
+	free(g->dist);
+	free(g->touched);
+	if(g->heap.v)
+		heap_free(&g->heap);
+	free(g->near);
+	free(g->n_near);
+}
+
+
+/**
+ * load_graph - Copy the instance into the graph under reduction, and queue
+ * every vertex. Returns an error number (!= 0) if there is no memory.
+ * */
+static int load_graph(struct red_graph *g, struct reduction *r,
+		const struct stein *stein)
+{
+	const unsigned int *off = NULL, *adj = NULL, *wts = NULL;
+	unsigned int n = stein->n_nodes, u, v, e, w;
+
+	/* Each degree-2 test adds at most one edge, and removes a vertex */
+	size_t max_edges = (size_t)stein->n_edges + n;
+
+	memset(g, 0, sizeof(*g));
+	g->r = r;
+	g->n = n;
+	g->n_terminals = stein->n_terminals;
+	if(!(r->edge = malloc(sizeof(*r->edge) * max_edges)) ||
+			!(r->merged = malloc(sizeof(*r->merged) * max_edges)) ||
+			!(r->fixed = malloc(sizeof(*r->fixed) * n)) ||
+			!(g->head = malloc(sizeof(*g->head) * n)) ||
+			!(g->next = malloc(sizeof(*g->next) * max_edges)) ||
+			!(g->deg = calloc(n, sizeof(*g->deg))) ||
+			!(g->flag = calloc(n, 1)) ||
+			!(g->alive = malloc(max_edges)) ||
+			!(g->stack = malloc(sizeof(*g->stack) * n)) ||
+			!(g->off = malloc(sizeof(*g->off) * (n + 1))) ||
+			!(g->arc = malloc(sizeof(*g->arc) * 2 * max_edges)) ||
+			!(g->dist = malloc(sizeof(*g->dist) * n)) ||
+			!(g->touched = malloc(sizeof(*g->touched) * n)) ||
+			heap_init(&g->heap, n, g->dist) != 0 ||
+			!(g->near = malloc(sizeof(*g->near) * n)) ||
+			!(g->n_near = calloc(n, sizeof(*g->n_near)))) {
+		ERRNO = ENOMEM;
+		return ERRNO;
+	}
+	memset(g->head, 0xff, sizeof(*g->head) * n);
+	memset(g->dist, 0xff, sizeof(*g->dist) * n);
+	for(u = 0; u < stein->n_terminals; u++)
+		g->flag[stein->terminals[u]] = RED_TERMINAL;
+
+	if(stein->layout == ADJ_CSR) {
+		off = csr_off(stein);
+		adj = csr_adj(stein);
+		wts = csr_wts(stein);
+	}
+	for(u = 0; u < n; u++) {
+		for(e = off ? off[u] : u + 1; e < (off ? off[u + 1] : n); e++) {
+			v = off ? adj[e] : e;
+			w = off ? wts[e] : stein_w(stein, u, v);
+			if(u < v && w != W_INF)
+				add_edge(g, u, v, w, REDUCE_NONE, REDUCE_NONE);
+		}
+	}
+	for(u = n; u > 0; u--)
+		push_vertex(g, u - 1);
+	return 0;
+}
+
+
+/**
+ * reduce_graph - Apply the reduction tests to the instance returned by
+ * get_stein(), which is replaced by the reduced graph. Instances with less
+ * than two terminals are left as they are. Returns an error number (!= 0) if
+ * there is no memory, in which case the instance may be lost.
+ *
+ * @stein: stein structure with the graph representation.
+ * @r: record of the reductions, to expand the trees.
+ * */
+int reduce_graph(struct stein *stein, struct reduction *r)
+{
+	struct red_graph g;
+	unsigned int n_dead, n_cut = 0u, n, i, round;
+	unsigned long fixed_w;
+	int err;
+
+	memset(r, 0, sizeof(*r));
+	r->n_orig = n = stein->n_nodes;
+	if(stein->n_terminals < 2 || stein->n_edges == 0) {
+		/* Nothing is reduced, every vertex stands for itself */
+		if(!(r->orig = malloc(sizeof(*r->orig) * n))) {
+			ERRNO = ENOMEM;
+			goto fail_reduce;
+		}
+		for(i = 0; i < n; i++)
+			r->orig[i] = i;
+		return 0;
+	}
+
+	if((err = load_graph(&g, r, stein)) != 0)
+		goto fail_graph;
+	n_dead = degree_tests(&g);
+	for(round = 0; round < REDUCE_ROUNDS; round++) {
+		if((i = distance_tests(&g)) == 0)
+			break;
+		n_cut += i;
+		n_dead += degree_tests(&g);
+	}
+
+	if((err = rebuild_stein(stein, &g)) != 0)
+		goto fail_graph;
+
+	/* The reduced cost test needs the instance, which is rebuilt again if
+	 * it cut edges. The bound does not hold the edges fixed since. */
+	fixed_w = r->fixed_w;
+	if((err = bound_tests(stein, &g, &i)) != 0)
+		goto fail_graph;
+	if(i > 0) {
+		n_cut += i;
+		n_dead += degree_tests(&g);
+		if((err = rebuild_stein(stein, &g)) != 0)
+			goto fail_graph;
+	}
+	r->lb = r->lb > r->fixed_w - fixed_w ? r->lb - (r->fixed_w - fixed_w) :
+		0ul;
+
+	pr_debug("Reductions: %u vertexes removed, %u edges cut, %u edges fixed"
+			" (weight %lu), %u of %u vertexes and %u edges left.\n",
+			n_dead, n_cut, r->n_fixed, r->fixed_w, stein->n_nodes,
+			n, stein->n_edges);
+	free_graph(&g);
+	return 0;
+
+fail_graph:
+	free_graph(&g);
+fail_reduce:
+	pr_error("Could not reduce the instance. ERRNO=%d\n\n", ERRNO);
+	reduction_free(r);
+	return ERRNO;
+}
+
+
+/**
+ * expand_edge - Append the original edges the edge e stands for to edges.
+ * */
+static void expand_edge(const struct reduction *r, unsigned int e,
+		unsigned int *stack, unsigned int (*edges)[3],
+		unsigned int *n_edges)
+{
+	unsigned int n_stack = 0u;
+
+	stack[n_stack++] = e;
+	while(n_stack > 0) {
+		e = stack[--n_stack];
+		if(r->merged[e][0] == REDUCE_NONE) {
+			memcpy(edges[(*n_edges)++], r->edge[e], sizeof(*edges));
+			continue;
+		}
+		stack[n_stack++] = r->merged[e][0];
+		stack[n_stack++] = r->merged[e][1];
+	}
+}
+
+
+/**
+ * reduction_expand - Write the edges of the original graph the tree of the
+ * reduced graph stands for, the fixed edges included, as (u, v, w). Returns an
+ * error number (!= 0) if there is no memory, or an edge of the tree is not in
+ * the reduced graph.
+ *
+ * @r: record of the reductions.
+ * @s: tree of the reduced graph.
+ * @edges: set to the edges, to be released with free().
+ * @n_edges: set to the number of edges.
+ * */
+int reduction_expand(const struct reduction *r, const struct solution *s,
+		unsigned int (**edges)[3], unsigned int *n_edges)
+{
+	unsigned int key[2], *stack = NULL, (*out)[3] = NULL, i, n = 0u;
+	const unsigned int *found;
+
+	/* The expanded edges make a tree of the original graph, and the
+	 * stack holds at most one edge per contraction, and one more */
+	if(!(out = malloc(sizeof(*out) * (r->n_orig + 1))) ||
+			!(stack = malloc(sizeof(*stack) * (r->n_orig + 1)))) {
+		ERRNO = ENOMEM;
+		goto fail_expand;
+	}
+
+	for(i = 0; i < r->n_fixed; i++)
+		expand_edge(r, r->fixed[i], stack, out, &n);
+	for(i = 0; i < s->n_edges; i++) {
+		if(!r->edge) {
+			/* Nothing was reduced */
+			out[n][0] = s->edge[i][0];
+			out[n][1] = s->edge[i][1];
+			out[n++][2] = stein_w(get_stein(), s->edge[i][0],
+					s->edge[i][1]);
+			continue;
+		}
+		key[0] = s->edge[i][0] < s->edge[i][1] ? s->edge[i][0] :
+			s->edge[i][1];
+		key[1] = s->edge[i][0] ^ s->edge[i][1] ^ key[0];
+		if(!(found = bsearch(key, r->index, r->n_index,
+						sizeof(*r->index), cmp_index))) {
+			ERRNO = EUNEXPECTED_ERROR;
+			goto fail_expand;
+		}
+		expand_edge(r, found[2], stack, out, &n);
+	}
+
+	free(stack);
+	*edges = out;
+	*n_edges = n;
+	return 0;
+
+fail_expand:
+	free(stack);
+	free(out);
+	return ERRNO;
+}
+
+
+/**
+ * reduction_free - Release the memory of the record of the reductions.
+ *
+ * @r: record of the reductions.
+ * */
+void reduction_free(struct reduction *r)
+{
+	free(r->orig);
+	free(r->edge);
+	free(r->merged);
+	free(r->fixed);
+	free(r->index);
+	memset(r, 0, sizeof(*r));
+}
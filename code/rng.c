@@ -0,0 +1,109 @@
+/**
+ * rng.c - Pseudo random number generator used by the genetic operators.
+ *
+ * The generator is xoshiro256**, whose state is seeded by splitmix64. Every
+ * thread has its own state, see get_rng(), so no lock is taken on a draw.
+ * */
+
+#include <math.h>
+
+#include "include/rng.h"
+
+
+/* State of the calling thread. It starts as the state seeded with 0, so a
+ * thread which never seeds it still gets a valid sequence. */
+static __thread struct rng thread_rng = {{
+	0xe220a8397b1dcdafULL, 0x6e789e6aa1b965f4ULL,
+	0x06c45d188009454fULL, 0xf88bb8a8724c81ecULL
+}};
+
+
+/**
+ * get_rng - Return the generator state of the calling thread.
+ * */
+struct rng *get_rng()
+{
+	return &thread_rng;
+}
+
+
+/**
+ * splitmix64 - Return the next number of the splitmix64 sequence, used to
+ * expand a single seed into a full state.
+ * */
+static uint64_t splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+
+/**
+ * rng_seed - Seed the generator. The same seed always gives the same
+ * sequence.
+ *
+ * @r: generator state.
+ * @seed: seed.
+ * */
+void rng_seed(struct rng *r, uint64_t seed)
+{
+	int i;
+
+	for(i = 0; i < 4; i++)
+		r->s[i] = splitmix64(&seed);
+}
+
+
+/**
+ * rng_derive - Return the seed of the stream id of a seed. The streams of a
+ * same seed are independent, and only depend on the seed and their number.
+ *
+ * @seed: seed the stream is derived from.
+ * @id: number of the stream.
+ * */
+uint64_t rng_derive(uint64_t seed, uint64_t id)
+{
+	/* The number goes through splitmix64 twice, so that close numbers
+	 * and close seeds give unrelated streams */
+	uint64_t x = splitmix64(&id) ^ seed;
+
+	return splitmix64(&x);
+}
+
+
+/**
+ * rng_split - Seed the generator with the stream id of a seed, see
+ * rng_derive().
+ *
+ * @r: generator state.
+ * @seed: seed the stream is derived from.
+ * @id: number of the stream.
+ * */
+void rng_split(struct rng *r, uint64_t seed, uint64_t id)
+{
+	rng_seed(r, rng_derive(seed, id));
+}
+
+
+/**
+ * rng_skip - Return the number of failed trials before the first success,
+ * when every trial succeeds with probability 1 / n. The geometric law is
+ * inverted from a single draw, so a caller going through trials of a same
+ * probability jumps to the next success instead of drawing for every trial.
+ *
+ * @r: generator state.
+ * @n: inverse of the probability, not 0.
+ * */
+uint32_t rng_skip(struct rng *r, uint32_t n)
+{
+	double skip;
+
+	if(n == 1)
+		return 0;
+	/* 1 - rng_unit() is in (0, 1], so its logarithm is finite */
+	skip = floor(log(1.0 - rng_unit(r)) / log1p(-1.0 / n));
+	return skip < UINT32_MAX ? (uint32_t)skip : UINT32_MAX;
+}
@@ -0,0 +1,464 @@
+/**
+ * simd.c - Vectorized kernels for the scans over unsigned int weight rows
+ * performed by the MST, the mutation and the metric closure. Each kernel has
+ * an AVX2, a SSE4.1 and a scalar implementation, and the best one supported
+ * by the running CPU is selected when the program starts.
+ *
+ * The vector versions are compiled with the target attribute, so the rest of
+ * the program does not require any -m flag and still runs on older CPUs.
+ * */
+
+#include <limits.h>
+#include <immintrin.h>
+
+#include "include/simd.h"
+#include "include/print.h"
+
+
+struct simd_kernels {
+	const char *name;
+	void (*key_update)(unsigned int *key, unsigned int *parent,
+			const unsigned int *row, unsigned int v,
+			unsigned int n);
+	unsigned int (*argmin)(const unsigned int *a, unsigned int n);
+	unsigned int (*pair_argmin)(const unsigned int *a,
+			const unsigned int *b, unsigned int n,
+			unsigned int *min);
+	void (*relax)(unsigned int *dist, unsigned int *pred,
+			const unsigned int *via, const unsigned int *via_pred,
+			unsigned int d, unsigned int n);
+};
+
+
+/**
+ * sat_add - Add two weights, saturating at UINT_MAX.
+ * */
+static inline unsigned int sat_add(unsigned int a, unsigned int b)
+{
+	unsigned int s = a + b;
+	return s < a ? UINT_MAX : s;
+}
+
+
+/**
+ * lanes_argmin - Reduce the per lane minimums and positions found by a vector
+ * kernel, keeping the first position among the equal minimums.
+ * */
+static inline unsigned int lanes_argmin(const unsigned int *best,
+		const unsigned int *pos, unsigned int lanes, unsigned int *min)
+{
+	unsigned int i, p = pos[0];
+
+	*min = best[0];
+	for(i = 1; i < lanes; i++) {
+		if(best[i] < *min || (best[i] == *min && pos[i] < p)) {
+			*min = best[i];
+			p = pos[i];
+		}
+	}
+	return p;
+}
+
+
+static void scalar_key_update(unsigned int *key, unsigned int *parent,
+		const unsigned int *row, unsigned int v, unsigned int n)
+{
+	unsigned int i;
+
+	for(i = 0; i < n; i++) {
+		if(row[i] < key[i]) {
+			key[i] = row[i];
+			parent[i] = v;
+		}
+	}
+}
+
+static unsigned int scalar_argmin(const unsigned int *a, unsigned int n)
+{
+	unsigned int i, p = 0u;
+
+	for(i = 1; i < n; i++) {
+		if(a[i] < a[p])
+			p = i;
+	}
+	return p;
+}
+
+static unsigned int scalar_pair_argmin(const unsigned int *a,
+		const unsigned int *b, unsigned int n, unsigned int *min)
+{
+	unsigned int i, p = 0u;
+
+	*min = UINT_MAX;
+	for(i = 0; i < n; i++) {
+		unsigned int s = sat_add(a[i], b[i]);
+		if(s < *min) {
+			*min = s;
+			p = i;
+		}
+	}
+	return p;
+}
+
+static void scalar_relax(unsigned int *dist, unsigned int *pred,
+		const unsigned int *via, const unsigned int *via_pred,
+		unsigned int d, unsigned int n)
+{
+	unsigned int i;
+
+	for(i = 0; i < n; i++) {
+		unsigned int s = sat_add(d, via[i]);
+		if(s < dist[i]) {
+			dist[i] = s;
+			pred[i] = via_pred[i];
+		}
+	}
+}
+
+
+/* AVX2 kernels: 8 weights per instruction */
+
+__attribute__((target("avx2")))
+static void avx2_key_update(unsigned int *key, unsigned int *parent,
+		const unsigned int *row, unsigned int v, unsigned int n)
+{
+	unsigned int i = 0u;
+	const __m256i vv = _mm256_set1_epi32((int)v);
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i k = _mm256_loadu_si256((const __m256i *)(key + i));
+		__m256i r = _mm256_loadu_si256((const __m256i *)(row + i));
+		__m256i p = _mm256_loadu_si256((const __m256i *)(parent + i));
+		__m256i m = _mm256_min_epu32(k, r);
+		/* The key changed only where the row is smaller */
+		__m256i keep = _mm256_cmpeq_epi32(m, k);
+
+		_mm256_storeu_si256((__m256i *)(key + i), m);
+		_mm256_storeu_si256((__m256i *)(parent + i),
+				_mm256_blendv_epi8(vv, p, keep));
+	}
+	scalar_key_update(key + i, parent + i, row + i, v, n - i);
+}
+
+__attribute__((target("avx2")))
+static unsigned int avx2_argmin(const unsigned int *a, unsigned int n)
+{
+	unsigned int i = 0u, p, min, best_a[8], pos_a[8];
+	__m256i best = _mm256_set1_epi32(-1);
+	__m256i pos = _mm256_setzero_si256();
+	__m256i cur = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i step = _mm256_set1_epi32(8);
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i m = _mm256_min_epu32(best, x);
+		/* Strictly smaller values move the lane position */
+		__m256i keep = _mm256_cmpeq_epi32(m, best);
+
+		pos = _mm256_blendv_epi8(cur, pos, keep);
+		best = m;
+		cur = _mm256_add_epi32(cur, step);
+	}
+	_mm256_storeu_si256((__m256i *)best_a, best);
+	_mm256_storeu_si256((__m256i *)pos_a, pos);
+	p = lanes_argmin(best_a, pos_a, 8, &min);
+
+	for(; i < n; i++) {
+		if(a[i] < min) {
+			min = a[i];
+			p = i;
+		}
+	}
+	return p;
+}
+
+__attribute__((target("avx2")))
+static unsigned int avx2_pair_argmin(const unsigned int *a,
+		const unsigned int *b, unsigned int n, unsigned int *min)
+{
+	unsigned int i = 0u, p, best_a[8], pos_a[8];
+	const __m256i ones = _mm256_set1_epi32(-1);
+	__m256i best = ones;
+	__m256i pos = _mm256_setzero_si256();
+	__m256i cur = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i step = _mm256_set1_epi32(8);
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i s = _mm256_add_epi32(x, y);
+		/* The sum overflowed where it is smaller than x */
+		__m256i ok = _mm256_cmpeq_epi32(_mm256_max_epu32(x, s), s);
+		__m256i m, keep;
+
+		s = _mm256_or_si256(s, _mm256_xor_si256(ok, ones));
+		m = _mm256_min_epu32(best, s);
+		keep = _mm256_cmpeq_epi32(m, best);
+		pos = _mm256_blendv_epi8(cur, pos, keep);
+		best = m;
+		cur = _mm256_add_epi32(cur, step);
+	}
+	_mm256_storeu_si256((__m256i *)best_a, best);
+	_mm256_storeu_si256((__m256i *)pos_a, pos);
+	p = lanes_argmin(best_a, pos_a, 8, min);
+
+	for(; i < n; i++) {
+		unsigned int s = sat_add(a[i], b[i]);
+		if(s < *min) {
+			*min = s;
+			p = i;
+		}
+	}
+	return p;
+}
+
+__attribute__((target("avx2")))
+static void avx2_relax(unsigned int *dist, unsigned int *pred,
+		const unsigned int *via, const unsigned int *via_pred,
+		unsigned int d, unsigned int n)
+{
+	unsigned int i = 0u;
+	const __m256i ones = _mm256_set1_epi32(-1);
+	const __m256i vd = _mm256_set1_epi32((int)d);
+
+	for(; i + 8 <= n; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(via + i));
+		__m256i k = _mm256_loadu_si256((const __m256i *)(dist + i));
+		__m256i p = _mm256_loadu_si256((const __m256i *)(pred + i));
+		__m256i q = _mm256_loadu_si256((const __m256i *)(via_pred + i));
+		__m256i s = _mm256_add_epi32(x, vd);
+		/* Saturate the sums which wrapped around */
+		__m256i ok = _mm256_cmpeq_epi32(_mm256_max_epu32(x, s), s);
+		__m256i m, keep;
+
+		s = _mm256_or_si256(s, _mm256_xor_si256(ok, ones));
+		m = _mm256_min_epu32(k, s);
+		keep = _mm256_cmpeq_epi32(m, k);
+		_mm256_storeu_si256((__m256i *)(dist + i), m);
+		_mm256_storeu_si256((__m256i *)(pred + i),
+				_mm256_blendv_epi8(q, p, keep));
+	}
+	scalar_relax(dist + i, pred + i, via + i, via_pred + i, d, n - i);
+}
+
+
+/* SSE4.1 kernels: 4 weights per instruction */
+
+__attribute__((target("sse4.1")))
+static void sse41_key_update(unsigned int *key, unsigned int *parent,
+		const unsigned int *row, unsigned int v, unsigned int n)
+{
+	unsigned int i = 0u;
+	const __m128i vv = _mm_set1_epi32((int)v);
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i k = _mm_loadu_si128((const __m128i *)(key + i));
+		__m128i r = _mm_loadu_si128((const __m128i *)(row + i));
+		__m128i p = _mm_loadu_si128((const __m128i *)(parent + i));
+		__m128i m = _mm_min_epu32(k, r);
+		__m128i keep = _mm_cmpeq_epi32(m, k);
+
+		_mm_storeu_si128((__m128i *)(key + i), m);
+		_mm_storeu_si128((__m128i *)(parent + i),
+				_mm_blendv_epi8(vv, p, keep));
+	}
+	scalar_key_update(key + i, parent + i, row + i, v, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static unsigned int sse41_argmin(const unsigned int *a, unsigned int n)
+{
+	unsigned int i = 0u, p, min, best_a[4], pos_a[4];
+	__m128i best = _mm_set1_epi32(-1);
+	__m128i pos = _mm_setzero_si128();
+	__m128i cur = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i step = _mm_set1_epi32(4);
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i m = _mm_min_epu32(best, x);
+		__m128i keep = _mm_cmpeq_epi32(m, best);
+
+		pos = _mm_blendv_epi8(cur, pos, keep);
+		best = m;
+		cur = _mm_add_epi32(cur, step);
+	}
+	_mm_storeu_si128((__m128i *)best_a, best);
+	_mm_storeu_si128((__m128i *)pos_a, pos);
+	p = lanes_argmin(best_a, pos_a, 4, &min);
+
+	for(; i < n; i++) {
+		if(a[i] < min) {
+			min = a[i];
+			p = i;
+		}
+	}
+	return p;
+}
+
+__attribute__((target("sse4.1")))
+static unsigned int sse41_pair_argmin(const unsigned int *a,
+		const unsigned int *b, unsigned int n, unsigned int *min)
+{
+	unsigned int i = 0u, p, best_a[4], pos_a[4];
+	const __m128i ones = _mm_set1_epi32(-1);
+	__m128i best = ones;
+	__m128i pos = _mm_setzero_si128();
+	__m128i cur = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i step = _mm_set1_epi32(4);
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i s = _mm_add_epi32(x, y);
+		__m128i ok = _mm_cmpeq_epi32(_mm_max_epu32(x, s), s);
+		__m128i m, keep;
+
+		s = _mm_or_si128(s, _mm_xor_si128(ok, ones));
+		m = _mm_min_epu32(best, s);
+		keep = _mm_cmpeq_epi32(m, best);
+		pos = _mm_blendv_epi8(cur, pos, keep);
+		best = m;
+		cur = _mm_add_epi32(cur, step);
+	}
+	_mm_storeu_si128((__m128i *)best_a, best);
+	_mm_storeu_si128((__m128i *)pos_a, pos);
+	p = lanes_argmin(best_a, pos_a, 4, min);
+
+	for(; i < n; i++) {
+		unsigned int s = sat_add(a[i], b[i]);
+		if(s < *min) {
+			*min = s;
+			p = i;
+		}
+	}
+	return p;
+}
+
+__attribute__((target("sse4.1")))
+static void sse41_relax(unsigned int *dist, unsigned int *pred,
+		const unsigned int *via, const unsigned int *via_pred,
+		unsigned int d, unsigned int n)
+{
+	unsigned int i = 0u;
+	const __m128i ones = _mm_set1_epi32(-1);
+	const __m128i vd = _mm_set1_epi32((int)d);
+
+	for(; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(via + i));
+		__m128i k = _mm_loadu_si128((const __m128i *)(dist + i));
+		__m128i p = _mm_loadu_si128((const __m128i *)(pred + i));
+		__m128i q = _mm_loadu_si128((const __m128i *)(via_pred + i));
+		__m128i s = _mm_add_epi32(x, vd);
+		__m128i ok = _mm_cmpeq_epi32(_mm_max_epu32(x, s), s);
+		__m128i m, keep;
+
+		s = _mm_or_si128(s, _mm_xor_si128(ok, ones));
+		m = _mm_min_epu32(k, s);
+		keep = _mm_cmpeq_epi32(m, k);
+		_mm_storeu_si128((__m128i *)(dist + i), m);
+		_mm_storeu_si128((__m128i *)(pred + i),
+				_mm_blendv_epi8(q, p, keep));
+	}
+	scalar_relax(dist + i, pred + i, via + i, via_pred + i, d, n - i);
+}
+
+
+static const struct simd_kernels scalar_kernels = {
+	"scalar", scalar_key_update, scalar_argmin, scalar_pair_argmin,
+	scalar_relax
+};
+static const struct simd_kernels sse41_kernels = {
+	"sse4.1", sse41_key_update, sse41_argmin, sse41_pair_argmin,
+	sse41_relax
+};
+static const struct simd_kernels avx2_kernels = {
+	"avx2", avx2_key_update, avx2_argmin, avx2_pair_argmin,
+	avx2_relax
+};
+
+static const struct simd_kernels *kernels = &scalar_kernels;
+
+
+/**
+ * simd_select - Select the kernels according to the CPU features. It runs
+ * before main, thus before any thread may call the kernels.
+ * */
+__attribute__((constructor))
+static void simd_select()
+{
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		kernels = &avx2_kernels;
+	else if(__builtin_cpu_supports("sse4.1"))
+		kernels = &sse41_kernels;
+	pr_debug("Using the %s kernels.\n", kernels->name);
+}
+
+
+/**
+ * simd_key_update - Relax the Prim keys against a new tree vertex: for every
+ * i < n where row[i] < key[i], key[i] is set to row[i] and parent[i] to v.
+ *
+ * @key: cheapest known cost of each vertex.
+ * @parent: tree vertex giving each key.
+ * @row: cost of each vertex from v.
+ * @v: vertex just added to the tree.
+ * @n: size of the arrays.
+ * */
+void simd_key_update(unsigned int *key, unsigned int *parent,
+		const unsigned int *row, unsigned int v, unsigned int n)
+{
+	kernels->key_update(key, parent, row, v, n);
+}
+
+
+/**
+ * simd_argmin - Return the first position of the minimum value in the array,
+ * or 0 if the array is empty.
+ *
+ * @a: array to scan.
+ * @n: size of the array.
+ * */
+unsigned int simd_argmin(const unsigned int *a, unsigned int n)
+{
+	return kernels->argmin(a, n);
+}
+
+
+/**
+ * simd_pair_argmin - Return the first position i minimizing a[i] + b[i]. The
+ * sum saturates at UINT_MAX, so W_INF in either array is never selected
+ * unless there is nothing else.
+ *
+ * @a: first array to scan.
+ * @b: second array to scan.
+ * @n: size of the arrays.
+ * @min: filled with the minimum sum.
+ * */
+unsigned int simd_pair_argmin(const unsigned int *a, const unsigned int *b,
+		unsigned int n, unsigned int *min)
+{
+	return kernels->pair_argmin(a, b, n, min);
+}
+
+
+/**
+ * simd_relax - Relax the shortest paths of a source through the vertex k:
+ * for every i < n where d + via[i] < dist[i], dist[i] is set to the sum and
+ * pred[i] to via_pred[i]. The sum saturates at UINT_MAX, so W_INF is never
+ * shortened.
+ *
+ * @dist: distance of each vertex from the source.
+ * @pred: predecessor of each vertex on its path from the source.
+ * @via: distance of each vertex from k.
+ * @via_pred: predecessor of each vertex on its path from k.
+ * @d: distance of k from the source.
+ * @n: size of the arrays.
+ * */
+void simd_relax(unsigned int *dist, unsigned int *pred,
+		const unsigned int *via, const unsigned int *via_pred,
+		unsigned int d, unsigned int n)
+{
+	kernels->relax(dist, pred, via, via_pred, d, n);
+}
@@ -6,6 +6,9 @@
  * */
 
 #include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "include/types.h"
 #include "include/list.h"
@@ -24,34 +27,238 @@ struct stein __current
 #define THIS_STEIN (&__current)
 #endif
 
+/* See include/errno.h */
+__thread int ERRNO = 0;
+
 
 /**
  * alloc_adj_m - Allocate memory for the adjacency matrix acording to the values
- * of n_nodes and n_edges.
+ * of n_nodes and n_edges. All the cells start as W_INF. Complete graphs with
+ * at least TRIANGLE_MIN_NODES nodes get the ADJ_TRIANGLE layout, and sparse
+ * graphs (see CSR_DENSITY_RATIO) the ADJ_CSR layout.
+ *
+ * The matrix is mapped as a single anonymous block, so it is page (and
+ * therefore cache line) aligned and its unused tail can be given back to the
+ * system by compact_adj_m().
  * */
 void alloc_adj_m()
 {
-	int i;
+	size_t size;
+	void *adj_m;
+
+	THIS_STEIN->adj_m = NULL;
+	THIS_STEIN->adj_map = NULL;
+	THIS_STEIN->adj_size = 0;
 
 	if(THIS_STEIN->n_nodes > 0 && THIS_STEIN->n_edges > 0) {
+		size_t n = THIS_STEIN->n_nodes;
+
+		/* Every edge of a complete graph is in the file, thus there is
+		 * no point in storing the weights twice. */
+		THIS_STEIN->layout = ADJ_FULL;
+		if(n >= TRIANGLE_MIN_NODES && THIS_STEIN->n_edges == n * (n - 1) / 2)
+			THIS_STEIN->layout = ADJ_TRIANGLE;
+
+		/* A dense matrix takes O(V^2) memory, however few the edges */
+		if(THIS_STEIN->n_edges < n * (n - 1) / 2 / CSR_DENSITY_RATIO)
+			THIS_STEIN->layout = ADJ_CSR;
+
+		size = adj_cells(THIS_STEIN) * sizeof(unsigned int);
+
+		adj_m = mmap(NULL, size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(adj_m == MAP_FAILED) {
+			ERRNO = ENOMEM;
+			pr_error("Could not map %zu bytes for the matrix.\n\n",
+					size);
+			return;
+		}
+
+		/* The edges not present in the file are missing, and so are the
+		 * ones starting and ending in the same vertex. */
+		memset(adj_m, 0xff, size);
+
+		THIS_STEIN->adj_m = adj_m;
+		THIS_STEIN->adj_map = adj_m;
+		THIS_STEIN->adj_size = size;
+		THIS_STEIN->w_size = sizeof(unsigned int);
+	}
+}
+
+
+/**
+ * compact_adj_m - Narrow the adjacency matrix cells to uint16_t when every
+ * weight fits, releasing the memory left unused at the end of the matrix.
+ * It is a no-op when the program is compiled with -DNO_COMPACT_WEIGHTS.
+ *
+ * @max_w: greatest edge weight set in the matrix.
+ * */
+void compact_adj_m(unsigned int max_w)
+{
+#ifndef NO_COMPACT_WEIGHTS
+	size_t i, cells, size, page;
+	unsigned char *m = THIS_STEIN->adj_m;
+	unsigned int wide;
+	uint16_t narrow;
+
+	/* UINT16_MAX is reserved for the missing edges */
+	if(m == NULL || m != THIS_STEIN->adj_map ||
+			THIS_STEIN->layout == ADJ_CSR ||
+			THIS_STEIN->w_size != sizeof(unsigned int) ||
+			max_w >= UINT16_MAX)
+		return;
+
+	/* Narrowing in place is safe: the cell i is written at byte 2i, which
+	 * was already read, since it is not after the byte 4i. The cells go
+	 * through memcpy(), as reading the same memory as unsigned int and
+	 * writing it as uint16_t would break the strict aliasing rule, which
+	 * lets the compiler reorder the accesses. */
+	cells = adj_cells(THIS_STEIN);
+	for(i = 0; i < cells; i++) {
+		memcpy(&wide, m + i * sizeof(wide), sizeof(wide));
+		narrow = wide == W_INF ? UINT16_MAX : (uint16_t)wide;
+		memcpy(m + i * sizeof(narrow), &narrow, sizeof(narrow));
+	}
+	THIS_STEIN->w_size = sizeof(uint16_t);
+
+	page = (size_t)sysconf(_SC_PAGESIZE);
+	size = (cells * sizeof(uint16_t) + page - 1) / page * page;
+	if(size < THIS_STEIN->adj_size) {
+		munmap((char *)THIS_STEIN->adj_m + size,
+				THIS_STEIN->adj_size - size);
+		THIS_STEIN->adj_size = size;
+	}
+	pr_debug("Adjacency matrix compacted to %zu bytes.\n", size);
+#endif
+}
+
+
+/**
+ * fill_csr - Fill the arrays of the ADJ_CSR layout from the list of edges.
+ *
+ * The arcs are first bucketed by their head and then moved to the row of their
+ * tail, walking the heads in increasing order, so every row ends up sorted
+ * with two linear passes.
+ *
+ * @edges: n_edges triples (u, v, w), where u and v are vertexes of the edge
+ * and w its weight.
+ * */
+int fill_csr(const unsigned int (*edges)[3])
+{
+	unsigned int n = THIS_STEIN->n_nodes;
+	size_t e, m = THIS_STEIN->n_edges;
+	unsigned int *off = csr_off(THIS_STEIN);
+	unsigned int *adj = csr_adj(THIS_STEIN);
+	unsigned int *wts = csr_wts(THIS_STEIN);
+	unsigned int *tail, *tail_w, *next, v;
+
+	if(!(tail = malloc(sizeof(*tail) * (4 * m + n))))
+		return ENOMEM;
+	tail_w = tail + 2 * m;
+	next = tail_w + 2 * m;
+
+	/* The degrees give the row offsets, and the same offsets are used
+	 * for the buckets, since the graph is undirected. */
+	memset(off, 0, sizeof(*off) * (n + 1));
+	for(e = 0; e < m; e++) {
+		off[edges[e][0] + 1]++;
+		off[edges[e][1] + 1]++;
+	}
+	for(v = 0; v < n; v++)
+		off[v + 1] += off[v];
+
+	memcpy(next, off, sizeof(*next) * n);
+	for(e = 0; e < m; e++) {
+		unsigned int a = edges[e][0], b = edges[e][1];
 
-		/* Allocate memory for the lines */
-		THIS_STEIN->adj_m = malloc(sizeof(*(THIS_STEIN->adj_m)) *
-				THIS_STEIN->n_nodes);
-
-		/* Allocate memory for the columns */
-		for(i = 0; i < THIS_STEIN->n_nodes; i++) {
-			THIS_STEIN->adj_m[i] =
-				malloc(sizeof(**(THIS_STEIN->adj_m)) *
-						THIS_STEIN->n_nodes);
-
-			/* Initialize the [i][i] values with a high value,
-			 * since there is no edge starting and ending in the
-			 * same vertex.
-			 * */
-			THIS_STEIN->adj_m[i][i] = UINT_MAX;
+		tail[next[b]] = a;
+		tail_w[next[b]++] = edges[e][2];
+		tail[next[a]] = b;
+		tail_w[next[a]++] = edges[e][2];
+	}
+
+	memcpy(next, off, sizeof(*next) * n);
+	for(v = 0; v < n; v++) {
+		unsigned int i;
+
+		for(i = off[v]; i < off[v + 1]; i++) {
+			adj[next[tail[i]]] = v;
+			wts[next[tail[i]]++] = tail_w[i];
 		}
 	}
+
+	free(tail);
+	return 0;
+}
+
+
+/**
+ * stein_gather - Fill row[i] with the weight of the edge (u, idx[i]), for
+ * every i < n. The layout and cell width are checked once, outside the loop.
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: vertex common to every edge.
+ * @idx: vertexes at the other end of the edges.
+ * @n: number of edges.
+ * @row: filled with the weights.
+ * */
+void stein_gather(const struct stein *stein, unsigned int u,
+		const unsigned int *idx, unsigned int n, unsigned int *row)
+{
+	unsigned int i;
+
+	if(stein->layout == ADJ_FULL && stein->w_size == sizeof(unsigned int)) {
+		const unsigned int *adj_row = (const unsigned int *)stein->adj_m +
+			(size_t)u * stein->n_nodes;
+		for(i = 0; i < n; i++)
+			row[i] = adj_row[idx[i]];
+	} else if(stein->layout == ADJ_FULL) {
+		const uint16_t *adj_row = (const uint16_t *)stein->adj_m +
+			(size_t)u * stein->n_nodes;
+		for(i = 0; i < n; i++)
+			row[i] = adj_row[idx[i]] == UINT16_MAX ?
+				W_INF : adj_row[idx[i]];
+	} else {
+		for(i = 0; i < n; i++)
+			row[i] = stein_w(stein, u, idx[i]);
+	}
+}
+
+
+/**
+ * stein_row - Fill row[v] with the weight of the edge (u, v), for every vertex
+ * v of the graph.
+ *
+ * @stein: stein structure with the graph representation.
+ * @u: vertex common to every edge.
+ * @row: filled with the n_nodes weights.
+ * */
+void stein_row(const struct stein *stein, unsigned int u, unsigned int *row)
+{
+	unsigned int v;
+
+	if(stein->layout == ADJ_FULL && stein->w_size == sizeof(unsigned int)) {
+		memcpy(row, (const unsigned int *)stein->adj_m +
+				(size_t)u * stein->n_nodes,
+				sizeof(*row) * stein->n_nodes);
+	} else if(stein->layout == ADJ_FULL) {
+		const uint16_t *adj_row = (const uint16_t *)stein->adj_m +
+			(size_t)u * stein->n_nodes;
+		for(v = 0; v < stein->n_nodes; v++)
+			row[v] = adj_row[v] == UINT16_MAX ? W_INF : adj_row[v];
+	} else if(stein->layout == ADJ_CSR) {
+		const unsigned int *off = csr_off(stein), *adj = csr_adj(stein);
+		const unsigned int *wts = csr_wts(stein);
+		unsigned int i;
+
+		for(v = 0; v < stein->n_nodes; v++)
+			row[v] = W_INF;
+		for(i = off[u]; i < off[u + 1]; i++)
+			row[adj[i]] = wts[i];
+	} else {
+		for(v = 0; v < stein->n_nodes; v++)
+			row[v] = stein_w(stein, u, v);
+	}
 }
 
 
@@ -83,13 +290,8 @@ struct stein *get_stein()
  * free_stein - Free the current stein struct allocatted memory.
  * */
 void free_stein() {
-	int i = THIS_STEIN->n_nodes - 1;
-	if(THIS_STEIN->adj_m != NULL) {
-		for(; i >= 0; i--) {
-			free((THIS_STEIN->adj_m)[i]);
-		}
-		free(THIS_STEIN->adj_m);
-	}
+	if(THIS_STEIN->adj_map != NULL)
+		munmap(THIS_STEIN->adj_map, THIS_STEIN->adj_size);
 
 	if(THIS_STEIN->terminals != NULL)
 		free(THIS_STEIN->terminals);
@@ -98,111 +300,215 @@ void free_stein() {
 
 
 /**
- * alloc_solution - Allocate memory for the solution_t and its edge.
+ * init_solution - Initialize an empty solution, which holds no memory until
+ * reserve_solution() is called.
+ *
+ * @s: solution to initialize.
  * */
-struct solution *alloc_solution()
+void init_solution(struct solution *s)
 {
-	struct solution *s;
-	s = malloc(sizeof(*s));
-	return s;
+	s->w = 0u;
+	s->n_edges = 0u;
+	s->n_vertexes = 0u;
+	s->max_edges = 0u;
+	s->edge = NULL;
+	s->vertex = NULL;
+	s->pos = NULL;
 }
 
 
 /**
- * alloc_population - Allocate memory for a population.
+ * reserve_solution - Make room in the solution for n_edges edges, allocating
+ * its vertex set on the first call. The edges already in the solution are
+ * kept. Returns an error number (!= 0) if there is no memory.
+ *
+ * The edge array at least doubles when it grows, the old one is left in the
+ * arena until the generation is reset.
+ *
+ * @s: solution.
+ * @n_edges: number of edges.
+ * @arena: arena of the generation the solution belongs to.
  * */
-struct population *alloc_population()
+int reserve_solution(struct solution *s, unsigned int n_edges,
+		struct arena *arena)
 {
-	struct population *p = NULL;
-	p = malloc(sizeof(*p));
-	return p;
+	unsigned int (*edge)[2], i, n = THIS_STEIN->n_nodes;
+
+	if(!s->vertex) {
+		if(!(s->vertex = arena_alloc(arena, sizeof(*s->vertex) * 2 *
+						(size_t)n)))
+			goto fail_alloc;
+		s->pos = s->vertex + n;
+		for(i = 0; i < n; i++) {
+			s->vertex[i] = i;
+			s->pos[i] = i;
+		}
+		s->n_vertexes = 0u;
+	}
+
+	if(n_edges <= s->max_edges)
+		return 0;
+
+	if(n_edges < 2 * s->max_edges)
+		n_edges = 2 * s->max_edges;
+	if(!(edge = arena_alloc(arena, sizeof(*edge) * n_edges)))
+		goto fail_alloc;
+	if(s->n_edges > 0)
+		memcpy(edge, s->edge, sizeof(*edge) * s->n_edges);
+	s->edge = edge;
+	s->max_edges = n_edges;
+	return 0;
+
+fail_alloc:
+	ERRNO = ENOMEM;
+	return ERRNO;
 }
 
 
 /**
- * free_population - iterates over the population list and free its solution and
- * the population struct itself.
+ * add_solution_edge - Append the edge (u, v) of weight w to the solution.
+ * Returns an error number (!= 0) if there is no memory.
  *
- * @head: population list head.
+ * @s: solution.
+ * @u: first vertex of the edge.
+ * @v: second vertex of the edge.
+ * @w: weight of the edge.
+ * @arena: arena of the generation the solution belongs to.
  * */
-void free_population_list(struct list_head *head)
+int add_solution_edge(struct solution *s, unsigned int u, unsigned int v,
+		unsigned int w, struct arena *arena)
 {
-	struct list_head *p_list, *tmp;
-	struct solution *s;
-
-	list_for_each_safe(p_list, tmp, head) {
-		struct population *p;
-		p = list_entry(p_list, struct population, list);
-		free_list_entry(&p->solution, s, list);
-		free(p);
-	}
-
+	if(reserve_solution(s, s->n_edges + 1u, arena) != 0)
+		return ERRNO;
+
+	s->edge[s->n_edges][0] = u;
+	s->edge[s->n_edges][1] = v;
+	s->n_edges++;
+	s->w += w;
+	solution_add_v(s, u);
+	solution_add_v(s, v);
+	return 0;
 }
 
+
+#ifdef FITNESS_CHECK
 /**
- * copy_solution - Use this function to create a copy of an entire solution
- * list. It will walk down the solution list allocating a new memory chunk for
- * every solution.
+ * __check_solution_weight - Sum the weights of the edges of the solution and
+ * abort if the cached weight differs. Use check_solution_weight().
  *
- * @source: Solution to be copied.
- * @s_head: Solution list head for the new solution.
+ * @stein: Stein structure with the graph representation.
+ * @s: solution.
+ * @caller: function which changed the solution.
  * */
-void copy_solution(struct list_head *source, struct list_head *s_head)
+void __check_solution_weight(const struct stein *stein,
+		const struct solution *s, const char *caller)
 {
-	struct solution *tmp = NULL, *err_p = NULL;
-
-	list_for_each_entry(tmp, source, list) {
-		struct solution *new_s = NULL;
-
-		if(!(new_s = alloc_solution()))
-			goto free_list;
-
-		new_s->edge[0] = tmp->edge[0];
-		new_s->edge[1] = tmp->edge[1];
-		new_s->w = tmp->w;
-		new_s->list.prev = NULL;
-		new_s->list.next = NULL;
-		list_add_tail(&(new_s->list), s_head);
-		pr_debug("Copying edge (%u,%u) at %p.\n", new_s->edge[0] + 1u,
-				new_s->edge[1] + 1u, *new_s);
+	unsigned long w = 0ul;
+	unsigned int i;
+
+	for(i = 0; i < s->n_edges; i++)
+		w += stein_w(stein, s->edge[i][0], s->edge[i][1]);
+	if(w != s->w) {
+		pr_error("%s: cached weight %u, but the edges weigh %lu.\n\n",
+				caller, s->w, w);
+		abort();
 	}
-	return;
-free_list:
-	pr_error("Solution was not copied. Head at %p.\n\n", *s_head);
-	free_list_entry(s_head, err_p, list);
-	free(s_head);
-	ERRNO = ENOMEM;
-	return;
 }
+#endif
 
 
 /**
- * solution_has_v - Search for the vertex v in the solution.
+ * copy_solution - Copy the source solution into dst, reusing the memory of dst
+ * when it is large enough. Returns an error number (!= 0) if there is no
+ * memory.
  *
- * @h: solution list head.
- * @v: vertex to search.
+ * @dst: solution to overwrite.
+ * @source: solution to be copied.
+ * @arena: arena of the generation dst belongs to.
  * */
-int solution_has_v(struct list_head *h, unsigned int v)
+int copy_solution(struct solution *dst, const struct solution *source,
+		struct arena *arena)
 {
-	struct solution *s;
-	list_for_each_entry(s, h, list) {
-		if(s->edge[0] == v || s->edge[1] == v)
-			return 1;
+	/* Drop the edges of dst first, so they are not copied if the edge
+	 * array grows. */
+	dst->n_edges = 0u;
+	if(reserve_solution(dst, source->max_edges, arena) != 0) {
+		pr_error("Solution was not copied. ERRNO=%d\n\n", ERRNO);
+		return ERRNO;
 	}
+
+	if(source->n_edges > 0)
+		memcpy(dst->edge, source->edge, sizeof(*dst->edge) *
+				source->n_edges);
+	memcpy(dst->vertex, source->vertex, sizeof(*dst->vertex) * 2 *
+			(size_t)THIS_STEIN->n_nodes);
+	dst->w = source->w;
+	dst->n_edges = source->n_edges;
+	dst->n_vertexes = source->n_vertexes;
 	return 0;
 }
 
 
 /**
- * update_solution_weight - Update the given solution list weight.
+ * alloc_generation - Allocate a generation of size empty individuals.
  *
- * @s_head: solution list head pointer.
- * @w: new weight.
+ * @size: number of individuals.
+ * @n_arenas: number of threads working on the generation, at least 1.
  * */
-void update_solution_weight(struct list_head *s_head, unsigned int w)
+struct generation *alloc_generation(unsigned int size, unsigned int n_arenas)
 {
-	struct solution *s;
-	list_for_each_entry(s, s_head, list) {
-		s->w = w;
+	struct generation *g;
+	unsigned int t;
+
+	if(!(g = malloc(sizeof(*g))))
+		return NULL;
+	if(!(g->pop = malloc(sizeof(*g->pop) * (size ? size : 1u)))) {
+		free(g);
+		return NULL;
 	}
+	if(!(g->arena = malloc(sizeof(*g->arena) * n_arenas))) {
+		free(g->pop);
+		free(g);
+		return NULL;
+	}
+	g->size = size;
+	g->n_arenas = n_arenas;
+	for(t = 0; t < n_arenas; t++)
+		arena_init(&g->arena[t], 0);
+	reset_generation(g);
+	return g;
+}
+
+
+/**
+ * reset_generation - Release every individual of the generation at once,
+ * keeping the memory for the next one.
+ *
+ * @g: generation to reset.
+ * */
+void reset_generation(struct generation *g)
+{
+	unsigned int i;
+
+	for(i = 0; i < g->n_arenas; i++)
+		arena_reset(&g->arena[i]);
+	for(i = 0; i < g->size; i++)
+		init_solution(&g->pop[i]);
+}
+
+
+/**
+ * free_generation - Free the generation along with its individuals.
+ *
+ * @g: generation to free.
+ * */
+void free_generation(struct generation *g)
+{
+	unsigned int t;
+
+	for(t = 0; t < g->n_arenas; t++)
+		arena_destroy(&g->arena[t]);
+	free(g->arena);
+	free(g->pop);
+	free(g);
 }